@@ -0,0 +1,348 @@
+/**
+ *  @file   bench_kernels.cpp
+ *  @brief  Measures every CRC kernel and combine function, results are printed as CSV
+ ***********************************************/
+
+// One row per measurement:
+// cpu,family,kernel,size,offset,cache,iterations,ns_per_call,cycles_per_call,gb_per_s,bytes_per_cycle
+// - offset is the distance from a 64 byte aligned address, non-zero offsets test misaligned input
+// - cache "warm" repeats on the same buffer, "cold" flushes the input from all cache levels before every call
+// - cycles are time stamp counter ticks (constant rate on current x86 CPUs), empty on other platforms
+// - combine rows time crc32_combine & co, size is lengthB and the throughput columns are empty
+// - multi16 rows hash the buffer as 16 independent pieces of size/16 bytes with crc*_multi,
+//   compare them with the single buffer kernels at size/16
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include <crc/Crc32.h>
+#include <crc/Crc32c.h>
+#include <crc/Crc64.h>
+#include <utils/CpuFeatures.h>
+#include <utils/SimpleArguments.h>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SFV_BENCH_TSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SFV_BENCH_TSC
+#endif
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    struct BenchKernel {
+        std::string family; // crc32, crc32c or crc64
+        std::string name;
+        Crc32Function crc32 = nullptr; // crc32 and crc32c kernels
+        uint64_t (*crc64)(const void* data, size_t length, uint64_t previous_crc) = nullptr;
+        size_t prefetch_ahead = 0; // crc32_16bytes_prefetch only
+        void (*multi32)(const void* const* data, const size_t* lengths, uint32_t* crcs, size_t count) = nullptr;
+        void (*multi64)(const void* const* data, const size_t* lengths, uint64_t* crcs, size_t count) = nullptr;
+    };
+
+    /**
+     * \brief Splits the buffer into 16 pieces for the multi-buffer kernels
+     */
+    uint64_t runMulti(const BenchKernel& kernel, const void* data, const size_t length, const uint64_t previous) {
+        constexpr size_t pieces = 16;
+        const void* starts[pieces];
+        size_t lengths[pieces];
+        for (size_t i = 0; i < pieces; ++i) {
+            starts[i] = static_cast<const char*>(data) + i * (length / pieces);
+            lengths[i] = i + 1 < pieces ? length / pieces : length - (pieces - 1) * (length / pieces);
+        }
+        uint64_t result = 0;
+        if (kernel.multi32 != nullptr) {
+            uint32_t crcs[pieces];
+            for (auto& crc : crcs) crc = static_cast<uint32_t>(previous);
+            kernel.multi32(starts, lengths, crcs, pieces);
+            for (const auto crc : crcs) result ^= crc;
+        } else {
+            uint64_t crcs[pieces];
+            for (auto& crc : crcs) crc = previous;
+            kernel.multi64(starts, lengths, crcs, pieces);
+            for (const auto crc : crcs) result ^= crc;
+        }
+        return result;
+    }
+
+    struct Options {
+        size_t min_size = 16;
+        size_t max_size = size_t(1) << 30;
+        std::vector<size_t> offsets{0, 1, 3};
+        std::vector<size_t> prefetch{64, 128, 256, 512, 1024, 2048};
+        double min_seconds = 0.05;
+        std::string filter; // Substring of family/kernel
+        bool cold = true;
+    };
+
+    inline uint64_t run(const BenchKernel& kernel, const void* data, const size_t length, const uint64_t previous) {
+        if (kernel.multi32 != nullptr || kernel.multi64 != nullptr)
+            return runMulti(kernel, data, length, previous);
+        if (kernel.prefetch_ahead != 0)
+            return crc32_16bytes_prefetch(data, length, static_cast<uint32_t>(previous), kernel.prefetch_ahead);
+        if (kernel.crc32 != nullptr)
+            return kernel.crc32(data, length, static_cast<uint32_t>(previous));
+        return kernel.crc64(data, length, previous);
+    }
+
+    inline uint64_t ticks() {
+#ifdef SFV_BENCH_TSC
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+    /**
+     * \brief Removes a range from every cache level
+     */
+    void evict(const char* data, const size_t length, std::vector<char>& scratch) {
+#ifdef SFV_BENCH_TSC
+        (void)scratch;
+        for (size_t i = 0; i < length; i += 64) _mm_clflush(data + i);
+        _mm_clflush(data + length - 1);
+        _mm_mfence();
+#else
+        // No portable flush, overwrite a buffer that should be larger than the last level cache
+        (void)data; (void)length;
+        for (size_t i = 0; i < scratch.size(); i += 64) scratch[i]++;
+#endif
+    }
+
+    std::vector<BenchKernel> collectKernels(const Options& options) {
+        std::vector<BenchKernel> kernels;
+        size_t count;
+        const Crc32Kernel* crc32 = crc32_kernels(&count);
+        for (size_t i = 0; i < count; ++i) {
+            if (crc32[i].supported != nullptr && !crc32[i].supported()) continue;
+            if (std::string(crc32[i].name) == "16bytes_prefetch") {
+                for (const size_t ahead : options.prefetch)
+                    kernels.push_back({"crc32", "16bytes_prefetch/" + std::to_string(ahead), nullptr, nullptr, ahead});
+                continue;
+            }
+            kernels.push_back({"crc32", crc32[i].name, crc32[i].function});
+        }
+        kernels.push_back({"crc32", "multi16", nullptr, nullptr, 0, crc32_multi});
+
+        kernels.push_back({"crc32c", "bitwise", crc32c_bitwise});
+        kernels.push_back({"crc32c", "8bytes", crc32c_8bytes});
+#ifdef CRC32C_USE_SSE42
+        if (crc32c_sse42_supported()) kernels.push_back({"crc32c", "sse42", crc32c_sse42});
+#endif
+        kernels.push_back({"crc32c", "multi16", nullptr, nullptr, 0, crc32c_multi});
+        kernels.push_back({"crc64", "bitwise", nullptr, crc64_bitwise});
+        kernels.push_back({"crc64", "8bytes", nullptr, crc64_8bytes});
+#ifdef CRC64_USE_PCLMUL
+        if (crc64_pclmul_supported()) kernels.push_back({"crc64", "pclmul", nullptr, crc64_pclmul});
+#endif
+        kernels.push_back({"crc64", "multi16", nullptr, nullptr, 0, nullptr, crc64_multi});
+
+        if (!options.filter.empty()) {
+            std::erase_if(kernels, [&](const BenchKernel& kernel) {
+                return (kernel.family + "/" + kernel.name).find(options.filter) == std::string::npos;
+            });
+        }
+        return kernels;
+    }
+
+    void printRow(const BenchKernel& kernel, const size_t size, const size_t offset, const char* cache,
+                  const unsigned long long iterations, const double seconds, const uint64_t cycles, const bool throughput = true) {
+        const double calls = static_cast<double>(iterations);
+        const double bytes = static_cast<double>(size) * calls;
+        std::cout << '"' << CpuFeatures::get().brand() << "\"," << kernel.family << ',' << kernel.name << ','
+                  << size << ',' << offset << ',' << cache << ',' << iterations << ','
+                  << std::fixed << std::setprecision(1) << seconds * 1e9 / calls << ',';
+        if (cycles != 0) std::cout << static_cast<double>(cycles) / calls;
+        std::cout << ',';
+        if (throughput) std::cout << std::setprecision(3) << bytes / seconds / 1e9;
+        std::cout << ',';
+        if (throughput && cycles != 0) std::cout << bytes / static_cast<double>(cycles);
+        std::cout << "\n";
+    }
+
+    /**
+     * \brief Compares every kernel with the bitwise one of its family, a wrong kernel would make its numbers worthless
+     */
+    bool validate(const std::vector<BenchKernel>& kernels, const char* data) {
+        bool valid = true;
+        for (const auto& kernel : kernels) {
+            for (const size_t length : {size_t(0), size_t(1), size_t(63), size_t(4097)}) {
+                const auto bitwise = [&](const char* piece, const size_t piece_length) -> uint64_t {
+                    if (kernel.family == "crc32") return crc32_bitwise(piece, piece_length);
+                    if (kernel.family == "crc32c") return crc32c_bitwise(piece, piece_length);
+                    return crc64_bitwise(piece, piece_length);
+                };
+                uint64_t expected = 0;
+                if (kernel.multi32 != nullptr || kernel.multi64 != nullptr) {
+                    // runMulti xors the CRCs of its 16 pieces
+                    for (size_t i = 0; i < 16; ++i)
+                        expected ^= bitwise(data + 1 + i * (length / 16), i + 1 < 16 ? length / 16 : length - 15 * (length / 16));
+                } else {
+                    expected = bitwise(data + 1, length);
+                }
+                if (run(kernel, data + 1, length, 0) != expected) {
+                    std::cerr << "[Error] " << kernel.family << "/" << kernel.name << " is wrong for " << length << " bytes\n";
+                    valid = false;
+                }
+            }
+        }
+        return valid;
+    }
+
+    void benchKernel(const BenchKernel& kernel, const Options& options, const char* buffer, const std::vector<size_t>& sizes, std::vector<char>& scratch) {
+        volatile uint64_t sink = 0;
+        for (const size_t size : sizes) {
+            for (const size_t offset : options.offsets) {
+                const char* data = buffer + offset;
+
+                // warm: run once to fault in pages and fill the caches, then repeat for at least min_seconds
+                uint64_t crc = run(kernel, data, size, 0);
+                unsigned long long iterations = 0;
+                const auto start = Clock::now();
+                const uint64_t start_ticks = ticks();
+                double seconds;
+                do {
+                    for (unsigned long long batch = 0; batch < std::max<size_t>(1, 4096 / size); ++batch, ++iterations)
+                        crc = run(kernel, data, size, crc);
+                    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                } while (seconds < options.min_seconds);
+                printRow(kernel, size, offset, "warm", iterations, seconds, ticks() - start_ticks);
+
+                if (options.cold) {
+                    // cold: only the calls are timed, flushing may take much longer than hashing
+                    iterations = 0;
+                    seconds = 0;
+                    uint64_t cycles = 0;
+                    const auto cold_start = Clock::now();
+                    do {
+                        evict(data, size, scratch);
+                        const auto call_start = Clock::now();
+                        const uint64_t call_ticks = ticks();
+                        crc = run(kernel, data, size, crc);
+                        cycles += ticks() - call_ticks;
+                        seconds += std::chrono::duration<double>(Clock::now() - call_start).count();
+                        ++iterations;
+                    } while (seconds < options.min_seconds && iterations < 1000 &&
+                             std::chrono::duration<double>(Clock::now() - cold_start).count() < 10 * options.min_seconds);
+                    printRow(kernel, size, offset, "cold", iterations, seconds, cycles);
+                }
+                sink = sink + crc;
+            }
+        }
+    }
+
+    void benchCombine(const Options& options, const std::vector<size_t>& sizes) {
+        volatile uint64_t sink = 0;
+        const BenchKernel combine[] = {
+            {"crc32", "combine"}, {"crc32", "combine_op"}, {"crc32c", "combine"}, {"crc64", "combine"}};
+        for (const auto& function : combine) {
+            if (!options.filter.empty() && (function.family + "/" + function.name).find(options.filter) == std::string::npos) continue;
+            for (const size_t size : sizes) {
+                const uint32_t op = crc32_combine_gen(size);
+                uint64_t crc = 0x12345678;
+                unsigned long long iterations = 0;
+                const auto start = Clock::now();
+                const uint64_t start_ticks = ticks();
+                double seconds;
+                do {
+                    for (int batch = 0; batch < 1024; ++batch, ++iterations) {
+                        // each call depends on the previous one, so this is the latency of a merge
+                        if (function.family == "crc32c") crc = crc32c_combine(static_cast<uint32_t>(crc), 0x9E3779B9, size);
+                        else if (function.family == "crc64") crc = crc64_combine(crc, 0x9E3779B97F4A7C15, size);
+                        else if (function.name == "combine_op") crc = crc32_combine_op(static_cast<uint32_t>(crc), 0x9E3779B9, op);
+                        else crc = crc32_combine(static_cast<uint32_t>(crc), 0x9E3779B9, size);
+                    }
+                    seconds = std::chrono::duration<double>(Clock::now() - start).count();
+                } while (seconds < options.min_seconds);
+                printRow(function, size, 0, "warm", iterations, seconds, ticks() - start_ticks, false);
+                sink = sink + crc;
+            }
+        }
+    }
+
+    std::vector<size_t> parseList(const std::string& list) {
+        std::vector<size_t> values;
+        size_t start = 0;
+        while (start < list.size()) {
+            size_t end = list.find(',', start);
+            if (end == std::string::npos) end = list.size();
+            values.push_back(std::stoull(list.substr(start, end - start)));
+            start = end + 1;
+        }
+        return values;
+    }
+
+    void printHelp() {
+        std::cout << "sfv_bench_kernels, prints CSV to stdout" << "\n";
+        std::cout << "--min-size <bytes> smallest buffer (default 16)" << "\n";
+        std::cout << "--max-size <bytes> largest buffer, sizes grow by 4x (default 1073741824)" << "\n";
+        std::cout << "--offsets <a,b,..> start offsets from a 64 byte boundary (default 0,1,3)" << "\n";
+        std::cout << "--prefetch <a,b,..> prefetchAhead values of 16bytes_prefetch (default 64,128,256,512,1024,2048)" << "\n";
+        std::cout << "--min-time <ms> minimum time per measurement (default 50)" << "\n";
+        std::cout << "--kernel <text> only kernels whose family/name contains text (e.g crc32/pclmul)" << "\n";
+        std::cout << "--warm-only skip the cold cache measurements" << "\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    SimpleArguments simple_args(argc, argv);
+    if (simple_args.find("--help") || simple_args.find("-h")) {
+        printHelp();
+        return 0;
+    }
+
+    Options options;
+    try {
+        if (simple_args.find("--min-size")) options.min_size = std::max<size_t>(1, std::stoull(simple_args.findAfter("--min-size")));
+        if (simple_args.find("--max-size")) options.max_size = std::stoull(simple_args.findAfter("--max-size"));
+        if (simple_args.find("--offsets")) options.offsets = parseList(simple_args.findAfter("--offsets"));
+        if (simple_args.find("--prefetch")) options.prefetch = parseList(simple_args.findAfter("--prefetch"));
+        if (simple_args.find("--min-time")) options.min_seconds = std::stod(simple_args.findAfter("--min-time")) / 1000;
+        if (simple_args.find("--kernel")) options.filter = simple_args.findAfter("--kernel");
+    } catch (const std::exception&) {
+        std::cout << "[Critical Error] Invalid argument" << "\n";
+        printHelp();
+        return 1;
+    }
+    options.cold = !simple_args.find("--warm-only");
+
+    std::vector<size_t> sizes;
+    for (size_t size = options.min_size; size <= options.max_size; size *= 4) sizes.push_back(size);
+    const size_t max_offset = options.offsets.empty() ? 0 : *std::max_element(options.offsets.begin(), options.offsets.end());
+    if (sizes.empty() || options.offsets.empty()) {
+        printHelp();
+        return 1;
+    }
+
+    // 64 byte aligned random data, pages are touched up front so page faults aren't measured
+    const size_t buffer_size = std::max<size_t>(sizes.back() + max_offset, 4097 + 1);
+    const std::unique_ptr<char[]> storage(new char[buffer_size + 64]);
+    char* buffer = storage.get() + (64 - reinterpret_cast<uintptr_t>(storage.get()) % 64) % 64;
+    std::mt19937_64 random(42);
+    for (size_t i = 0; i < buffer_size; i += 8) {
+        const uint64_t value = random();
+        std::memcpy(buffer + i, &value, std::min<size_t>(8, buffer_size - i));
+    }
+    std::vector<char> scratch;
+#ifndef SFV_BENCH_TSC
+    if (options.cold) scratch.resize(size_t(256) << 20);
+#endif
+
+    const std::vector<BenchKernel> kernels = collectKernels(options);
+    if (!validate(kernels, buffer)) return 1;
+
+    std::cout << "cpu,family,kernel,size,offset,cache,iterations,ns_per_call,cycles_per_call,gb_per_s,bytes_per_cycle" << "\n";
+    for (const auto& kernel : kernels)
+        benchKernel(kernel, options, buffer, sizes, scratch);
+    benchCombine(options, sizes);
+    return 0;
+}
@@ -19,6 +19,11 @@
 
 #include "Crc32.h"
 
+// std::atomic
+#include <atomic>
+// strcmp
+#include <cstring>
+
 #ifndef __LITTLE_ENDIAN
   #define __LITTLE_ENDIAN 1234
 #endif
@@ -55,6 +60,11 @@
   #endif
 #endif
 
+// carry-less multiplication needs per-function target attributes on GCC/Clang (no global -mpclmul)
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+  #include <utils/CpuFeatures.h>
+#endif
+
 // abort if byte order is undefined
 #if !defined(__BYTE_ORDER)
 #error undefined byte order, compile with -D__BYTE_ORDER=1234 (if little endian) or -D__BYTE_ORDER=4321 (big endian)
@@ -382,6 +392,76 @@ uint32_t crc32_4x8bytes(const void* data, size_t length, uint32_t previousCrc32)
 
   return ~crc; // same as crc ^ 0xFFFFFFFF
 }
+
+
+namespace
+{
+  /// one Slicing-by-8 step, crc is not inverted
+  inline uint32_t slice8(uint32_t crc, const uint32_t*& current)
+  {
+#if __BYTE_ORDER == __BIG_ENDIAN
+    uint32_t one = *current++ ^ swap(crc);
+    uint32_t two = *current++;
+    return Crc32Lookup[0][ two      & 0xFF] ^
+           Crc32Lookup[1][(two>> 8) & 0xFF] ^
+           Crc32Lookup[2][(two>>16) & 0xFF] ^
+           Crc32Lookup[3][(two>>24) & 0xFF] ^
+           Crc32Lookup[4][ one      & 0xFF] ^
+           Crc32Lookup[5][(one>> 8) & 0xFF] ^
+           Crc32Lookup[6][(one>>16) & 0xFF] ^
+           Crc32Lookup[7][(one>>24) & 0xFF];
+#else
+    uint32_t one = *current++ ^ crc;
+    uint32_t two = *current++;
+    return Crc32Lookup[0][(two>>24) & 0xFF] ^
+           Crc32Lookup[1][(two>>16) & 0xFF] ^
+           Crc32Lookup[2][(two>> 8) & 0xFF] ^
+           Crc32Lookup[3][ two      & 0xFF] ^
+           Crc32Lookup[4][(one>>24) & 0xFF] ^
+           Crc32Lookup[5][(one>>16) & 0xFF] ^
+           Crc32Lookup[6][(one>> 8) & 0xFF] ^
+           Crc32Lookup[7][ one      & 0xFF];
+#endif
+  }
+} // anonymous namespace
+
+
+/// compute CRC32 (Slicing-by-8 algorithm), three independent streams interleaved
+uint32_t crc32_8bytes_3streams(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // each step of a single stream has to wait for the previous crc,
+  // three streams over separate thirds of the buffer have no dependency on each other
+  // so their table lookups can overlap, crc32_combine merges them at the end
+  const size_t Streams = 3;
+  const size_t BytesAtOnce = 8;
+
+  // not worth the two crc32_combine calls
+  if (length < 1024)
+    return crc32_8bytes(data, length, previousCrc32);
+
+  const size_t streamLength = (length / (Streams * BytesAtOnce)) * BytesAtOnce;
+  const uint8_t* start = (const uint8_t*) data;
+  const uint32_t* current0 = (const uint32_t*) (start);
+  const uint32_t* current1 = (const uint32_t*) (start +     streamLength);
+  const uint32_t* current2 = (const uint32_t*) (start + 2 * streamLength);
+
+  uint32_t crc0 = ~previousCrc32; // same as previousCrc32 ^ 0xFFFFFFFF
+  uint32_t crc1 = 0xFFFFFFFF;     // same as crc32(nothing, 0) ^ 0xFFFFFFFF
+  uint32_t crc2 = 0xFFFFFFFF;
+
+  for (size_t processed = 0; processed < streamLength; processed += BytesAtOnce)
+  {
+    crc0 = slice8(crc0, current0);
+    crc1 = slice8(crc1, current1);
+    crc2 = slice8(crc2, current2);
+  }
+
+  uint32_t crc = crc32_combine(~crc0, ~crc1, streamLength);
+  crc = crc32_combine(crc, ~crc2, streamLength);
+
+  // remaining 0 to 23 bytes
+  return crc32_8bytes(start + Streams * streamLength, length - Streams * streamLength, crc);
+}
 #endif // CRC32_USE_LOOKUP_TABLE_SLICING_BY_8
 
 
@@ -534,29 +614,506 @@ uint32_t crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previo
 #endif
 
 
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+namespace
+{
+  // folding constants for the reflected polynomial, see Intel's white paper
+  // "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction"
+  // each pair is (x^(D+32) mod P, x^(D-32) mod P), bit-reflected and shifted left by one,
+  // to fold a 128 bit value across a distance of D bits
+  alignas(16) const uint64_t Fold2048[2] = { 0x011542778a, 0x01322d1430 }; // 4x512 bits
+  alignas(16) const uint64_t Fold512[2] = { 0x0154442bd4, 0x01c6e41596 }; // 4x128 bits
+  alignas(16) const uint64_t Fold384[2] = { 0x003db1ecdc, 0x0174359406 }; // 3x128 bits
+  alignas(16) const uint64_t Fold256[2] = { 0x00f1da05aa, 0x015a546366 }; // 2x128 bits
+  alignas(16) const uint64_t Fold128[2] = { 0x01751997d0, 0x00ccaa009e }; // 1x128 bits
+  alignas(16) const uint64_t Fold64 [2] = { 0x0163cd6124, 0x0000000000 }; // 64 => 32 bits
+  alignas(16) const uint64_t Barrett[2] = { 0x01db710641, 0x01f7011641 }; // P' and mu
+
+  /// fold one 128 bit lane across "constants" and add the next 16 bytes
+  SFV_TARGET("pclmul,sse4.1")
+  inline __m128i fold128(__m128i value, __m128i constants, __m128i next)
+  {
+    __m128i low  = _mm_clmulepi64_si128(value, constants, 0x00);
+    __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), next);
+  }
+
+  /// fold the remaining 16 byte blocks into "value", then reduce it to the 32 bit CRC
+  SFV_TARGET("pclmul,sse4.1")
+  uint32_t pclmulFinish(__m128i value, const uint8_t* current, size_t length)
+  {
+    const __m128i fold128Constants = _mm_load_si128((const __m128i*) Fold128);
+    for (; length >= 16; length -= 16, current += 16)
+      value = fold128(value, fold128Constants, _mm_loadu_si128((const __m128i*) current));
+
+    // 128 => 64 bits
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    __m128i x = _mm_xor_si128(_mm_srli_si128(value, 8), _mm_clmulepi64_si128(value, fold128Constants, 0x10));
+    // 64 => 32 bits
+    __m128i upper = _mm_srli_si128(x, 4);
+    x = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), _mm_loadl_epi64((const __m128i*) Fold64), 0x00);
+    x = _mm_xor_si128(x, upper);
+
+    // Barrett reduction
+    const __m128i barrett = _mm_load_si128((const __m128i*) Barrett);
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), barrett, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), barrett, 0x00);
+    return (uint32_t) _mm_extract_epi32(_mm_xor_si128(x, t), 1);
+  }
+
+  /// process a multiple of 16 bytes (at least 64 bytes), crc is not inverted
+  SFV_TARGET("pclmul,sse4.1")
+  uint32_t pclmulFold(uint32_t crc, const uint8_t* current, size_t length)
+  {
+    // four independent 128 bit accumulators hide the latency of PCLMULQDQ
+    __m128i x1 = _mm_loadu_si128((const __m128i*) (current +  0));
+    __m128i x2 = _mm_loadu_si128((const __m128i*) (current + 16));
+    __m128i x3 = _mm_loadu_si128((const __m128i*) (current + 32));
+    __m128i x4 = _mm_loadu_si128((const __m128i*) (current + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int) crc));
+    current += 64;
+    length  -= 64;
+
+    const __m128i fold512Constants = _mm_load_si128((const __m128i*) Fold512);
+    for (; length >= 64; length -= 64, current += 64)
+    {
+      x1 = fold128(x1, fold512Constants, _mm_loadu_si128((const __m128i*) (current +  0)));
+      x2 = fold128(x2, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 16)));
+      x3 = fold128(x3, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 32)));
+      x4 = fold128(x4, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 48)));
+    }
+
+    // merge the accumulators
+    const __m128i fold128Constants = _mm_load_si128((const __m128i*) Fold128);
+    x2 = fold128(x1, fold128Constants, x2);
+    x3 = fold128(x2, fold128Constants, x3);
+    x4 = fold128(x3, fold128Constants, x4);
+
+    return pclmulFinish(x4, current, length);
+  }
+
+  /// fold four 128 bit lanes at once across "constants" and add the next 64 bytes
+  SFV_TARGET("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")
+  inline __m512i fold512(__m512i value, __m512i constants, __m512i next)
+  {
+    __m512i low  = _mm512_clmulepi64_epi128(value, constants, 0x00);
+    __m512i high = _mm512_clmulepi64_epi128(value, constants, 0x11);
+    return _mm512_ternarylogic_epi64(low, high, next, 0x96); // low ^ high ^ next
+  }
+
+  /// process a multiple of 16 bytes (at least 256 bytes), crc is not inverted
+  SFV_TARGET("avx512f,avx512vl,vpclmulqdq,pclmul,sse4.1")
+  uint32_t vpclmulFold(uint32_t crc, const uint8_t* current, size_t length)
+  {
+    // four 512 bit accumulators = sixteen 128 bit lanes in flight
+    __m512i x1 = _mm512_loadu_si512((const void*) (current +   0));
+    __m512i x2 = _mm512_loadu_si512((const void*) (current +  64));
+    __m512i x3 = _mm512_loadu_si512((const void*) (current + 128));
+    __m512i x4 = _mm512_loadu_si512((const void*) (current + 192));
+    x1 = _mm512_xor_si512(x1, _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128((int) crc), 0));
+    current += 256;
+    length  -= 256;
+
+    const __m512i fold2048Constants = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*) Fold2048));
+    for (; length >= 256; length -= 256, current += 256)
+    {
+      x1 = fold512(x1, fold2048Constants, _mm512_loadu_si512((const void*) (current +   0)));
+      x2 = fold512(x2, fold2048Constants, _mm512_loadu_si512((const void*) (current +  64)));
+      x3 = fold512(x3, fold2048Constants, _mm512_loadu_si512((const void*) (current + 128)));
+      x4 = fold512(x4, fold2048Constants, _mm512_loadu_si512((const void*) (current + 192)));
+    }
+
+    // merge the accumulators, then keep folding 64 bytes at a time
+    const __m512i fold512Constants = _mm512_broadcast_i32x4(_mm_load_si128((const __m128i*) Fold512));
+    x2 = fold512(x1, fold512Constants, x2);
+    x3 = fold512(x2, fold512Constants, x3);
+    x4 = fold512(x3, fold512Constants, x4);
+    for (; length >= 64; length -= 64, current += 64)
+      x4 = fold512(x4, fold512Constants, _mm512_loadu_si512((const void*) current));
+
+    // fold lanes 0, 1 and 2 onto lane 3 (which is multiplied by zero)
+    const __m512i laneConstants = _mm512_setr_epi64((long long) Fold384[0], (long long) Fold384[1],
+                                                    (long long) Fold256[0], (long long) Fold256[1],
+                                                    (long long) Fold128[0], (long long) Fold128[1], 0, 0);
+    __m512i lanes = _mm512_xor_si512(_mm512_clmulepi64_epi128(x4, laneConstants, 0x00),
+                                     _mm512_clmulepi64_epi128(x4, laneConstants, 0x11));
+    __m128i x = _mm512_extracti32x4_epi32(x4, 3);
+    x = _mm_ternarylogic_epi64(x, _mm512_extracti32x4_epi32(lanes, 0), _mm512_extracti32x4_epi32(lanes, 1), 0x96);
+    x = _mm_xor_si128(x, _mm512_extracti32x4_epi32(lanes, 2));
+
+    // pclmulFinish is legacy SSE code, entering it with dirty upper ZMM state costs a state transition per call
+    _mm256_zeroupper();
+    return pclmulFinish(x, current, length);
+  }
+} // anonymous namespace
+
+
+/// true if the running CPU can execute crc32_pclmul
+bool crc32_pclmul_supported()
+{
+  const CpuFeatures& cpu = CpuFeatures::get();
+  return cpu.pclmul() && cpu.sse41();
+}
+
+
+/// compute CRC32 (carry-less multiplication folding, requires PCLMULQDQ and SSE4.1)
+uint32_t crc32_pclmul(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // too short to fold: the final reduction costs more than a few table lookups
+  if (length < 64)
+    return crc32_1byte(data, length, previousCrc32);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const size_t folded = length & ~(size_t) 15;
+  uint32_t crc = ~pclmulFold(~previousCrc32, current, folded);
+
+  // remaining 0 to 15 bytes (standard algorithm)
+  return crc32_1byte(current + folded, length - folded, crc);
+}
+
+
+namespace
+{
+  /// the first "common" bytes (a multiple of 16, at least 16) of four independent buffers in lockstep,
+  /// one 128 bit accumulator each, crcs are not inverted
+  SFV_TARGET("pclmul,sse4.1")
+  void pclmulMulti4(const uint8_t* const* data, size_t common, uint32_t* crcs)
+  {
+    const uint8_t* current0 = data[0];
+    const uint8_t* current1 = data[1];
+    const uint8_t* current2 = data[2];
+    const uint8_t* current3 = data[3];
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current0), _mm_cvtsi32_si128((int) crcs[0]));
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current1), _mm_cvtsi32_si128((int) crcs[1]));
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current2), _mm_cvtsi32_si128((int) crcs[2]));
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current3), _mm_cvtsi32_si128((int) crcs[3]));
+
+    // the four dependency chains are independent, so their PCLMULQDQ latencies overlap
+    const __m128i fold128Constants = _mm_load_si128((const __m128i*) Fold128);
+    for (size_t offset = 16; offset < common; offset += 16)
+    {
+      x0 = fold128(x0, fold128Constants, _mm_loadu_si128((const __m128i*) (current0 + offset)));
+      x1 = fold128(x1, fold128Constants, _mm_loadu_si128((const __m128i*) (current1 + offset)));
+      x2 = fold128(x2, fold128Constants, _mm_loadu_si128((const __m128i*) (current2 + offset)));
+      x3 = fold128(x3, fold128Constants, _mm_loadu_si128((const __m128i*) (current3 + offset)));
+    }
+
+    crcs[0] = pclmulFinish(x0, current0, 0);
+    crcs[1] = pclmulFinish(x1, current1, 0);
+    crcs[2] = pclmulFinish(x2, current2, 0);
+    crcs[3] = pclmulFinish(x3, current3, 0);
+  }
+} // anonymous namespace
+
+
+/// true if the running CPU can execute crc32_vpclmul (and the OS saves ZMM registers)
+bool crc32_vpclmul_supported()
+{
+  return crc32_pclmul_supported() && CpuFeatures::get().vpclmulqdq();
+}
+
+
+/// compute CRC32 (512 bit carry-less multiplication folding, requires AVX-512 and VPCLMULQDQ)
+uint32_t crc32_vpclmul(const void* data, size_t length, uint32_t previousCrc32)
+{
+  // the 128 bit kernel is faster until all four ZMM accumulators are filled
+  if (length < 256)
+    return crc32_pclmul(data, length, previousCrc32);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const size_t folded = length & ~(size_t) 15;
+  uint32_t crc = ~vpclmulFold(~previousCrc32, current, folded);
+
+  // remaining 0 to 15 bytes (standard algorithm)
+  return crc32_1byte(current + folded, length - folded, crc);
+}
+#endif
+
+
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+namespace
+{
+  /// true if crc32_fast runs one of the PCLMULQDQ kernels, defined next to the dispatch table
+  bool pclmulKernelActive();
+}
+#endif
+
+
+/// compute the CRC32 of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+void crc32_multi(const void* const* data, const size_t* lengths, uint32_t* crcs, size_t count)
+{
+  size_t done = 0;
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+  // the lanes are PCLMULQDQ code too, any other kernel chosen by crc32_select_kernel hashes one buffer at a time
+  if (pclmulKernelActive())
+  {
+    const size_t Lanes = 4;
+    for (; done + Lanes <= count; done += Lanes)
+    {
+      const uint8_t* current[Lanes];
+      size_t shortest = lengths[done];
+      size_t longest  = lengths[done];
+      for (size_t lane = 0; lane < Lanes; lane++)
+      {
+        current[lane] = (const uint8_t*) data[done + lane];
+        shortest = lengths[done + lane] < shortest ? lengths[done + lane] : shortest;
+        longest  = lengths[done + lane] > longest  ? lengths[done + lane] : longest;
+      }
+      // lanes only pay off once there is something to fold, and single buffers of 256+ bytes
+      // already keep four accumulators (or four ZMM registers with crc32_vpclmul) busy
+      if (shortest < 32 || longest >= 256)
+      {
+        for (size_t lane = 0; lane < Lanes; lane++)
+          crcs[done + lane] = crc32_fast(current[lane], lengths[done + lane], crcs[done + lane]);
+        continue;
+      }
+
+      uint32_t crc[Lanes];
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crc[lane] = ~crcs[done + lane];
+      const size_t common = shortest & ~(size_t) 15;
+      pclmulMulti4(current, common, crc);
+
+      // whatever the shortest buffer didn't cover (at least the last 0 to 15 bytes)
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crcs[done + lane] = crc32_fast(current[lane] + common, lengths[done + lane] - common, ~crc[lane]);
+    }
+  }
+#endif
+  for (; done < count; done++)
+    crcs[done] = crc32_fast(data[done], lengths[done], crcs[done]);
+}
+
+
+namespace
+{
+  /// look-ahead of the "16bytes_prefetch" kernel, see crc32_set_prefetch_ahead
+  std::atomic<size_t> PrefetchAhead{ 256 };
+
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+  /// crc32_16bytes_prefetch with the configured look-ahead, fits the Crc32Function signature
+  uint32_t crc32_16bytes_prefetchConfigured(const void* data, size_t length, uint32_t previousCrc32)
+  {
+    return crc32_16bytes_prefetch(data, length, previousCrc32, PrefetchAhead.load(std::memory_order_relaxed));
+  }
+#endif
+
+  /// all kernels, ordered from slowest to fastest
+  const Crc32Kernel Kernels[] =
+  {
+    { "bitwise",          crc32_bitwise,          nullptr },
+    { "halfbyte",         crc32_halfbyte,         nullptr },
+    { "1byte_tableless",  crc32_1byte_tableless,  nullptr },
+    { "1byte_tableless2", crc32_1byte_tableless2, nullptr },
+#ifdef CRC32_USE_LOOKUP_TABLE_BYTE
+    { "1byte",            crc32_1byte,            nullptr },
+#endif
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_4
+    { "4bytes",           crc32_4bytes,           nullptr },
+#endif
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_8
+    { "8bytes",           crc32_8bytes,           nullptr },
+    { "4x8bytes",         crc32_4x8bytes,         nullptr },
+    { "8bytes_3streams",  crc32_8bytes_3streams,  nullptr },
+#endif
+#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+    { "16bytes",          crc32_16bytes,          nullptr },
+    { "16bytes_prefetch", crc32_16bytes_prefetchConfigured, nullptr },
+#endif
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+    { "pclmul",           crc32_pclmul,           crc32_pclmul_supported },
+    { "vpclmul",          crc32_vpclmul,          crc32_vpclmul_supported },
+#endif
+  };
+  const size_t NumKernels = sizeof(Kernels) / sizeof(Kernels[0]);
+
+  /// fastest kernel the running CPU supports
+  const Crc32Kernel* bestKernel()
+  {
+    for (size_t i = NumKernels; i-- > 0; )
+      if (Kernels[i].supported == nullptr || Kernels[i].supported())
+        return &Kernels[i];
+    return &Kernels[0];
+  }
+
+  uint32_t crc32_resolve(const void* data, size_t length, uint32_t previousCrc32);
+
+  /// kernel behind crc32_fast, starts with a trampoline that resolves it on first use
+  std::atomic<const Crc32Kernel*> ActiveKernel{ nullptr };
+  std::atomic<Crc32Function>      ActiveFunction{ crc32_resolve };
+
+  /// first call of crc32_fast: query cpuid, then jump straight to the chosen kernel from now on
+  uint32_t crc32_resolve(const void* data, size_t length, uint32_t previousCrc32)
+  {
+    const Crc32Kernel* kernel = nullptr;
+    if (ActiveKernel.compare_exchange_strong(kernel, bestKernel()))
+      ActiveFunction.store(ActiveKernel.load()->function, std::memory_order_relaxed);
+    return ActiveKernel.load()->function(data, length, previousCrc32);
+  }
+
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+  bool pclmulKernelActive()
+  {
+    const Crc32Kernel* kernel = nullptr;
+    ActiveKernel.compare_exchange_strong(kernel, bestKernel());
+    const Crc32Function function = ActiveKernel.load()->function;
+    return function == crc32_pclmul || function == crc32_vpclmul;
+  }
+#endif
+} // anonymous namespace
+
+
+/// all kernels compiled into this binary, ordered from slowest to fastest
+const Crc32Kernel* crc32_kernels(size_t* count)
+{
+  *count = NumKernels;
+  return Kernels;
+}
+
+
+/// choose the kernel used by crc32_fast, returns false if the name is unknown or the CPU doesn't support it
+bool crc32_select_kernel(const char* name)
+{
+  for (size_t i = 0; i < NumKernels; i++)
+  {
+    if (strcmp(Kernels[i].name, name) != 0)
+      continue;
+    if (Kernels[i].supported != nullptr && !Kernels[i].supported())
+      return false;
+
+    ActiveKernel.store(&Kernels[i]);
+    ActiveFunction.store(Kernels[i].function, std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
+
+
+/// name of the kernel currently used by crc32_fast
+const char* crc32_selected_kernel()
+{
+  const Crc32Kernel* kernel = nullptr;
+  ActiveKernel.compare_exchange_strong(kernel, bestKernel());
+  return ActiveKernel.load()->name;
+}
+
+
+/// prefetchAhead used when crc32_fast runs the "16bytes_prefetch" kernel (default 256)
+void crc32_set_prefetch_ahead(size_t prefetchAhead)
+{
+  PrefetchAhead.store(prefetchAhead, std::memory_order_relaxed);
+}
+
+
+/// prefetchAhead used when crc32_fast runs the "16bytes_prefetch" kernel
+size_t crc32_prefetch_ahead()
+{
+  return PrefetchAhead.load(std::memory_order_relaxed);
+}
+
+
 /// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
 uint32_t crc32_fast(const void* data, size_t length, uint32_t previousCrc32)
 {
-#ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
-  return crc32_16bytes (data, length, previousCrc32);
-#elif defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_8)
-  return crc32_8bytes  (data, length, previousCrc32);
-#elif defined(CRC32_USE_LOOKUP_TABLE_SLICING_BY_4)
-  return crc32_4bytes  (data, length, previousCrc32);
-#elif defined(CRC32_USE_LOOKUP_TABLE_BYTE)
-  return crc32_1byte   (data, length, previousCrc32);
-#else
-  return crc32_halfbyte(data, length, previousCrc32);
+  // defaults to the fastest supported kernel, see crc32_select_kernel
+  return ActiveFunction.load(std::memory_order_relaxed)(data, length, previousCrc32);
+}
+
+
+namespace
+{
+  // polynomials below are bit-reflected like the crc itself: bit 31 is x^0, bit 0 is x^31
+  const uint32_t One = 1u << 31; // x^0
+
+  /// multiply two polynomials modulo the CRC32 polynomial
+  constexpr uint32_t multiplyModP(uint32_t a, uint32_t b)
+  {
+    uint32_t product = 0;
+    for (uint32_t mask = One; mask != 0; mask >>= 1)
+    {
+      if (a & mask)
+        product ^= b;
+      b = (b & 1) ? (b >> 1) ^ Polynomial : b >> 1; // b *= x
+    }
+    return product;
+  }
+
+  /// ZeroBytes[i][j] = x^(8 * j * 16^i) mod P, one row per hex digit of a 64 bit byte count
+  struct ZeroBytesTable
+  {
+    uint32_t power[16][16];
+  };
+
+  constexpr ZeroBytesTable makeZeroBytesTable()
+  {
+    ZeroBytesTable table{};
+    uint32_t base = One >> 8; // x^8, appending one zero byte
+    for (int digit = 0; digit < 16; digit++)
+    {
+      table.power[digit][0] = One;
+      for (int j = 1; j < 16; j++)
+        table.power[digit][j] = multiplyModP(table.power[digit][j - 1], base);
+      base = multiplyModP(table.power[digit][15], base); // x^(8 * 16^(digit+1))
+    }
+    return table;
+  }
+
+  /// built by the compiler, 1 KB
+  constexpr ZeroBytesTable ZeroBytes = makeZeroBytesTable();
+
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+  /// same as multiplyModP, carry-less multiplication followed by a Barrett reduction
+  SFV_TARGET("pclmul,sse4.1")
+  uint32_t multiplyModPclmul(uint32_t a, uint32_t b)
+  {
+    // the 63 bit product is shifted by one to line up with the 64 bit reflected input of the reduction
+    __m128i x = _mm_clmulepi64_si128(_mm_cvtsi32_si128((int) a), _mm_cvtsi32_si128((int) b), 0x00);
+    x = _mm_slli_epi64(x, 1);
+
+    const __m128i mask32  = _mm_setr_epi32(~0, 0, ~0, 0);
+    const __m128i barrett = _mm_load_si128((const __m128i*) Barrett);
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x, mask32), barrett, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, mask32), barrett, 0x00);
+    return (uint32_t) _mm_extract_epi32(_mm_xor_si128(x, t), 1);
+  }
 #endif
+
+  /// multiplyModP, in hardware if possible
+  inline uint32_t multiply(uint32_t a, uint32_t b)
+  {
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+    static const bool hasPclmul = crc32_pclmul_supported();
+    if (hasPclmul)
+      return multiplyModPclmul(a, b);
+#endif
+    return multiplyModP(a, b);
+  }
+} // anonymous namespace
+
+
+/// precompute the operator for crc32_combine_op, i.e. x^(8 * lengthB) mod P
+uint32_t crc32_combine_gen(size_t lengthB)
+{
+  // at most one multiplication per non-zero hex digit of lengthB
+  uint32_t op = One;
+  for (int digit = 0; lengthB != 0; digit++, lengthB >>= 4)
+    if (lengthB & 15)
+      op = (op == One) ? ZeroBytes.power[digit][lengthB & 15]
+                       : multiply(op, ZeroBytes.power[digit][lengthB & 15]);
+  return op;
+}
+
+
+/// merge two CRC32 with an operator returned by crc32_combine_gen(lengthB)
+uint32_t crc32_combine_op(uint32_t crcA, uint32_t crcB, uint32_t op)
+{
+  return multiply(op, crcA) ^ crcB;
 }
 
 
 /// merge two CRC32 such that result = crc32(dataB, lengthB, crc32(dataA, lengthA))
 uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
 {
-  // based on Mark Adler's crc_combine from
-  // https://github.com/madler/pigz/blob/master/pigz.c
-
   // main idea:
   // - if you have two equally-sized blocks A and B,
   //   then you can create a block C = A ^ B
@@ -564,92 +1121,45 @@ uint32_t crc32_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
   // - if you append length(B) zeros to A and call it A' (think of it as AAAA000)
   //   and   prepend length(A) zeros to B and call it B' (think of it as 0000BBB)
   //   then exists a C' = A' ^ B'
-  // - remember: if you XOR someting with zero, it remains unchanged: X ^ 0 = X
   // - that means C' = A concat B so that crc(A concat B) = crc(C') = crc(A') ^ crc(B')
-  // - the trick is to compute crc(A') based on crc(A)
-  //                       and crc(B') based on crc(B)
   // - since B' starts with many zeros, the crc of those initial zeros is still zero
   // - that means crc(B') = crc(B)
-  // - unfortunately the trailing zeros of A' change the crc, so usually crc(A') != crc(A)
-  // - the following code is a fast algorithm to compute crc(A')
-  // - starting with crc(A) and appending length(B) zeros, needing just log2(length(B)) iterations
-  // - the details are explained by the original author at
-  //   https://stackoverflow.com/questions/23122312/crc-calculation-of-a-mostly-static-data-stream/23126768
+  // - appending n zero bytes to A multiplies crc(A) by x^(8n) modulo the polynomial
   //
   // notes:
-  // - I squeezed everything into one function to keep global namespace clean (original code two helper functions)
-  // - most original comments are still in place, I added comments where these helper functions where made inline code
-  // - performance-wise there isn't any differenze to the original zlib/pigz code
+  // - zlib and the original version of this function squared 32x32 GF(2) matrices, log2(length(B)) times per call
+  // - instead x^(8n) is assembled from a compile-time table, one entry per hex digit of n,
+  //   see Mark Adler's multmodp/x2nmodp in zlib 1.2.12
+  // - the multiplication uses PCLMULQDQ if available
 
   // degenerated case
   if (lengthB == 0)
     return crcA;
 
-  /// CRC32 => 32 bits
-  const uint32_t CrcBits = 32;
-
-  uint32_t odd [CrcBits]; // odd-power-of-two  zeros operator
-  uint32_t even[CrcBits]; // even-power-of-two zeros operator
-
-  // put operator for one zero bit in odd
-  odd[0] = Polynomial;    // CRC-32 polynomial
-  for (int i = 1; i < (int)CrcBits; i++)
-    odd[i] = 1 << (i - 1);
+  return crc32_combine_op(crcA, crcB, crc32_combine_gen(lengthB));
+}
 
-  // put operator for two zero bits in even
-  // same as gf2_matrix_square(even, odd);
-  for (int i = 0; i < (int)CrcBits; i++)
-  {
-    uint32_t vec = odd[i];
-    even[i] = 0;
-    for (int j = 0; vec != 0; j++, vec >>= 1)
-      if (vec & 1)
-        even[i] ^= odd[j];
-  }
-  // put operator for four zero bits in odd
-  // same as gf2_matrix_square(odd, even);
-  for (int i = 0; i < (int)CrcBits; i++)
-  {
-    uint32_t vec = even[i];
-    odd[i] = 0;
-    for (int j = 0; vec != 0; j++, vec >>= 1)
-      if (vec & 1)
-        odd[i] ^= even[j];
-  }
 
-  // the following loop becomes much shorter if I keep swapping even and odd
-  uint32_t* a = even;
-  uint32_t* b = odd;
-  // apply secondLength zeros to firstCrc32
-  for (; lengthB > 0; lengthB >>= 1)
+/// merge consecutive blocks: result = crc32 of all blocks concatenated, crcs[i] covers lengths[i] bytes
+uint32_t crc32_combine_batch(const uint32_t* crcs, const size_t* lengths, size_t count)
+{
+  if (count == 0)
+    return 0;
+
+  // equally-sized blocks (the usual case) share one operator
+  uint32_t crc = crcs[0];
+  size_t opLength = 0;
+  uint32_t op = One;
+  for (size_t i = 1; i < count; i++)
   {
-    // same as gf2_matrix_square(a, b);
-    for (int i = 0; i < (int)CrcBits; i++)
-    {
-      uint32_t vec = b[i];
-      a[i] = 0;
-      for (int j = 0; vec != 0; j++, vec >>= 1)
-        if (vec & 1)
-          a[i] ^= b[j];
-    }
-
-    // apply zeros operator for this bit
-    if (lengthB & 1)
+    if (lengths[i] != opLength)
     {
-      // same as firstCrc32 = gf2_matrix_times(a, firstCrc32);
-      uint32_t sum = 0;
-      for (int i = 0; crcA != 0; i++, crcA >>= 1)
-        if (crcA & 1)
-          sum ^= a[i];
-      crcA = sum;
+      opLength = lengths[i];
+      op = crc32_combine_gen(opLength);
     }
-
-    // switch even and odd
-    uint32_t* t = a; a = b; b = t;
+    crc = crc32_combine_op(crc, crcs[i], op);
   }
-
-  // return combined crc
-  return crcA ^ crcB;
+  return crc;
 }
 
 
@@ -12,6 +12,10 @@
 #define CRC32_USE_LOOKUP_TABLE_SLICING_BY_4
 #define CRC32_USE_LOOKUP_TABLE_SLICING_BY_8
 #define CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
+// x64 only: carry-less multiplication kernels, picked at runtime if the CPU supports them
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32_USE_PCLMUL
+#endif
 // - crc32_bitwise  doesn't need it at all
 // - crc32_halfbyte has its own small lookup table
 // - crc32_1byte_tableless and crc32_1byte_tableless2 don't need it at all
@@ -19,7 +23,10 @@
 // - crc32_4bytes   needs only Crc32Lookup[0..3]
 // - crc32_8bytes   needs only Crc32Lookup[0..7]
 // - crc32_4x8bytes needs only Crc32Lookup[0..7]
+// - crc32_8bytes_3streams needs only Crc32Lookup[0..7]
 // - crc32_16bytes  needs all of Crc32Lookup
+// - crc32_pclmul   needs only Crc32Lookup[0] (for the last 0..15 bytes)
+// - crc32_vpclmul  needs only Crc32Lookup[0] (for the last 0..15 bytes)
 // using the aforementioned #defines the table is automatically fitted to your needs
 
 // uint8_t, uint32_t, int32_t
@@ -27,12 +34,47 @@
 // size_t
 #include <cstddef>
 
-// crc32_fast selects the fastest algorithm depending on flags (CRC32_USE_LOOKUP_...)
+// crc32_fast selects the fastest algorithm depending on flags (CRC32_USE_LOOKUP_...) and cpuid,
+// the choice is made once on first use and can be overridden with crc32_select_kernel
 /// compute CRC32 using the fastest algorithm for large datasets on modern CPUs
 uint32_t crc32_fast    (const void* data, size_t length, uint32_t previousCrc32 = 0);
 
+/// signature shared by all CRC32 kernels
+typedef uint32_t (*Crc32Function)(const void* data, size_t length, uint32_t previousCrc32);
+
+/// entry of the runtime dispatch table behind crc32_fast
+struct Crc32Kernel
+{
+  /// short name, e.g. "16bytes" or "pclmul"
+  const char*   name;
+  Crc32Function function;
+  /// nullptr if the kernel runs on every CPU
+  bool        (*supported)();
+};
+
+/// all kernels compiled into this binary, ordered from slowest to fastest
+const Crc32Kernel* crc32_kernels(size_t* count);
+/// choose the kernel used by crc32_fast, returns false if the name is unknown or the CPU doesn't support it
+bool crc32_select_kernel(const char* name);
+/// name of the kernel currently used by crc32_fast
+const char* crc32_selected_kernel();
+/// prefetchAhead used when crc32_fast runs the "16bytes_prefetch" kernel (default 256)
+void   crc32_set_prefetch_ahead(size_t prefetchAhead);
+size_t crc32_prefetch_ahead();
+
+/// compute the CRC32 of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+/// (lockstep PCLMULQDQ lanes while crc32_fast runs a PCLMULQDQ kernel, best for many buffers of similar, small sizes,
+/// otherwise one buffer after the other with the kernel chosen by crc32_select_kernel)
+void     crc32_multi   (const void* const* data, const size_t* lengths, uint32_t* crcs, size_t count);
+
 /// merge two CRC32 such that result = crc32(dataB, lengthB, crc32(dataA, lengthA))
 uint32_t crc32_combine (uint32_t crcA, uint32_t crcB, size_t lengthB);
+/// precompute the operator for crc32_combine_op, useful if many blocks share the same length
+uint32_t crc32_combine_gen(size_t lengthB);
+/// merge two CRC32 with an operator returned by crc32_combine_gen(lengthB), same result as crc32_combine
+uint32_t crc32_combine_op(uint32_t crcA, uint32_t crcB, uint32_t op);
+/// merge consecutive blocks: result = crc32 of all blocks concatenated, crcs[i] covers lengths[i] bytes
+uint32_t crc32_combine_batch(const uint32_t* crcs, const size_t* lengths, size_t count);
 
 /// compute CRC32 (bitwise algorithm)
 uint32_t crc32_bitwise (const void* data, size_t length, uint32_t previousCrc32 = 0);
@@ -59,6 +101,8 @@ uint32_t crc32_4bytes  (const void* data, size_t length, uint32_t previousCrc32
 uint32_t crc32_8bytes  (const void* data, size_t length, uint32_t previousCrc32 = 0);
 /// compute CRC32 (Slicing-by-8 algorithm), unroll inner loop 4 times
 uint32_t crc32_4x8bytes(const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// compute CRC32 (Slicing-by-8 algorithm), three independent streams interleaved and merged with crc32_combine
+uint32_t crc32_8bytes_3streams(const void* data, size_t length, uint32_t previousCrc32 = 0);
 #endif
 
 #ifdef CRC32_USE_LOOKUP_TABLE_SLICING_BY_16
@@ -67,3 +111,14 @@ uint32_t crc32_16bytes (const void* data, size_t length, uint32_t previousCrc32
 /// compute CRC32 (Slicing-by-16 algorithm, prefetch upcoming data blocks)
 uint32_t crc32_16bytes_prefetch(const void* data, size_t length, uint32_t previousCrc32 = 0, size_t prefetchAhead = 256);
 #endif
+
+#if defined(CRC32_USE_PCLMUL) && defined(CRC32_USE_LOOKUP_TABLE_BYTE)
+/// compute CRC32 (carry-less multiplication folding, requires PCLMULQDQ and SSE4.1, see crc32_pclmul_supported)
+uint32_t crc32_pclmul  (const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// true if the running CPU can execute crc32_pclmul
+bool crc32_pclmul_supported();
+/// compute CRC32 (512 bit carry-less multiplication folding, requires AVX-512 and VPCLMULQDQ, see crc32_vpclmul_supported)
+uint32_t crc32_vpclmul (const void* data, size_t length, uint32_t previousCrc32 = 0);
+/// true if the running CPU can execute crc32_vpclmul and the OS has enabled the ZMM register state
+bool crc32_vpclmul_supported();
+#endif
@@ -0,0 +1,218 @@
+// //////////////////////////////////////////////////////////
+// Crc32c.cpp
+// CRC-32C (Castagnoli, polynomial 0x82F63B78), same interface as Crc32.cpp
+// the portable code and all lookup tables come from CrcEngine.h
+//
+
+#include "Crc32c.h"
+#include "CrcEngine.h"
+
+// memcpy
+#include <cstring>
+
+#ifdef CRC32C_USE_SSE42
+  #include <utils/CpuFeatures.h>
+#endif
+
+
+#ifdef CRC32C_USE_SSE42
+namespace
+{
+  /// read eight bytes in little endian order
+  inline uint64_t load64(const uint8_t* current)
+  {
+    uint64_t value;
+    memcpy(&value, current, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+  }
+
+  /// bytes per stream of the interleaved SSE4.2 loops
+  const size_t LongBlock  = 8192;
+  const size_t ShortBlock = 256;
+
+  /// multiplying a crc by a fixed x^(8n) is linear, so it splits into four byte-wise table lookups
+  struct ShiftTable
+  {
+    uint32_t table[4][256];
+  };
+
+  constexpr ShiftTable makeShiftTable(size_t length)
+  {
+    ShiftTable shift{};
+    const uint32_t op = Crc32cEngine::zeroBytesOperator(length);
+    for (int byte = 0; byte < 4; byte++)
+      for (uint32_t i = 0; i < 256; i++)
+        shift.table[byte][i] = Crc32cEngine::multiply(op, i << (8 * byte));
+    return shift;
+  }
+
+  constexpr ShiftTable ShiftLong  = makeShiftTable(LongBlock);
+  constexpr ShiftTable ShiftShort = makeShiftTable(ShortBlock);
+
+  /// append the table's number of zero bytes to a (not inverted) crc
+  inline uint64_t shift(const ShiftTable& shift, uint64_t crc)
+  {
+    return shift.table[0][ crc        & 0xFF] ^
+           shift.table[1][(crc >>  8) & 0xFF] ^
+           shift.table[2][(crc >> 16) & 0xFF] ^
+           shift.table[3][(crc >> 24) & 0xFF];
+  }
+
+  /// three streams of blockSize bytes each, the crc instruction has a latency of 3 cycles but a throughput of 1
+  SFV_TARGET("sse4.2")
+  inline uint64_t crc3Way(uint64_t crc, const uint8_t*& current, size_t& length, size_t blockSize, const ShiftTable& shiftTable)
+  {
+    while (length >= 3 * blockSize)
+    {
+      uint64_t crc1 = 0;
+      uint64_t crc2 = 0;
+      const uint8_t* end = current + blockSize;
+      do
+      {
+        crc  = _mm_crc32_u64(crc,  load64(current));
+        crc1 = _mm_crc32_u64(crc1, load64(current + blockSize));
+        crc2 = _mm_crc32_u64(crc2, load64(current + 2 * blockSize));
+        current += 8;
+      } while (current < end);
+
+      crc = shift(shiftTable, crc) ^ crc1;
+      crc = shift(shiftTable, crc) ^ crc2;
+      current += 2 * blockSize;
+      length  -= 3 * blockSize;
+    }
+    return crc;
+  }
+
+  /// the first "common" bytes (a multiple of 8) of four independent buffers in lockstep, crcs are not inverted
+  SFV_TARGET("sse4.2")
+  void sse42Multi4(const uint8_t* const* data, size_t common, uint64_t* crcs)
+  {
+    const uint8_t* current0 = data[0];
+    const uint8_t* current1 = data[1];
+    const uint8_t* current2 = data[2];
+    const uint8_t* current3 = data[3];
+    uint64_t crc0 = crcs[0];
+    uint64_t crc1 = crcs[1];
+    uint64_t crc2 = crcs[2];
+    uint64_t crc3 = crcs[3];
+    for (size_t offset = 0; offset < common; offset += 8)
+    {
+      crc0 = _mm_crc32_u64(crc0, load64(current0 + offset));
+      crc1 = _mm_crc32_u64(crc1, load64(current1 + offset));
+      crc2 = _mm_crc32_u64(crc2, load64(current2 + offset));
+      crc3 = _mm_crc32_u64(crc3, load64(current3 + offset));
+    }
+    crcs[0] = crc0;
+    crcs[1] = crc1;
+    crcs[2] = crc2;
+    crcs[3] = crc3;
+  }
+} // anonymous namespace
+#endif
+
+
+/// compute CRC32C (bitwise algorithm)
+uint32_t crc32c_bitwise(const void* data, size_t length, uint32_t previousCrc32c)
+{
+  return Crc32cEngine::bitwise(data, length, previousCrc32c);
+}
+
+
+/// compute CRC32C (Slicing-by-8 algorithm)
+uint32_t crc32c_8bytes(const void* data, size_t length, uint32_t previousCrc32c)
+{
+  return Crc32cEngine::update(data, length, previousCrc32c);
+}
+
+
+#ifdef CRC32C_USE_SSE42
+/// true if the running CPU can execute crc32c_sse42
+bool crc32c_sse42_supported()
+{
+  return CpuFeatures::get().sse42();
+}
+
+
+/// compute CRC32C (SSE4.2 crc32 instruction, three interleaved streams)
+SFV_TARGET("sse4.2")
+uint32_t crc32c_sse42(const void* data, size_t length, uint32_t previousCrc32c)
+{
+  uint64_t crc = ~previousCrc32c; // same as previousCrc32c ^ 0xFFFFFFFF
+  const uint8_t* current = (const uint8_t*) data;
+
+  // align to 8 bytes
+  for (; length != 0 && ((uintptr_t) current & 7) != 0; length--)
+    crc = _mm_crc32_u8((uint32_t) crc, *current++);
+
+  crc = crc3Way(crc, current, length, LongBlock,  ShiftLong);
+  crc = crc3Way(crc, current, length, ShortBlock, ShiftShort);
+
+  // single stream for the remaining 0 to 767 bytes
+  for (; length >= 8; length -= 8, current += 8)
+    crc = _mm_crc32_u64(crc, load64(current));
+  for (; length != 0; length--)
+    crc = _mm_crc32_u8((uint32_t) crc, *current++);
+
+  return ~(uint32_t) crc; // same as crc ^ 0xFFFFFFFF
+}
+#endif
+
+
+/// compute the CRC32C of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+void crc32c_multi(const void* const* data, const size_t* lengths, uint32_t* crcs, size_t count)
+{
+  size_t done = 0;
+#ifdef CRC32C_USE_SSE42
+  // cpuid is only queried once
+  static const bool hasSse42 = crc32c_sse42_supported();
+  if (hasSse42)
+  {
+    // short buffers never reach crc3Way, interleaving separate buffers fills the crc32 pipeline instead
+    const size_t Lanes = 4;
+    for (; done + Lanes <= count; done += Lanes)
+    {
+      const uint8_t* current[Lanes];
+      size_t common = lengths[done];
+      for (size_t lane = 0; lane < Lanes; lane++)
+      {
+        current[lane] = (const uint8_t*) data[done + lane];
+        common = lengths[done + lane] < common ? lengths[done + lane] : common;
+      }
+      common &= ~(size_t) 7;
+
+      uint64_t crc[Lanes];
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crc[lane] = ~crcs[done + lane];
+      sse42Multi4(current, common, crc);
+
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crcs[done + lane] = crc32c_sse42(current[lane] + common, lengths[done + lane] - common, ~(uint32_t) crc[lane]);
+    }
+  }
+#endif
+  for (; done < count; done++)
+    crcs[done] = crc32c_fast(data[done], lengths[done], crcs[done]);
+}
+
+
+/// compute CRC32C using the fastest algorithm the CPU supports (SSE4.2 or Slicing-by-8)
+uint32_t crc32c_fast(const void* data, size_t length, uint32_t previousCrc32c)
+{
+#ifdef CRC32C_USE_SSE42
+  // cpuid is only queried once
+  static const bool hasSse42 = crc32c_sse42_supported();
+  if (hasSse42)
+    return crc32c_sse42(data, length, previousCrc32c);
+#endif
+  return crc32c_8bytes(data, length, previousCrc32c);
+}
+
+
+/// merge two CRC32C such that result = crc32c(dataB, lengthB, crc32c(dataA, lengthA))
+uint32_t crc32c_combine(uint32_t crcA, uint32_t crcB, size_t lengthB)
+{
+  return Crc32cEngine::combine(crcA, crcB, lengthB);
+}
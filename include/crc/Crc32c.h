@@ -0,0 +1,38 @@
+// //////////////////////////////////////////////////////////
+// Crc32c.h
+// CRC-32C (Castagnoli, polynomial 0x82F63B78), same interface as Crc32.h
+// used by iSCSI, ext4, Btrfs and most newer storage stacks
+//
+
+#pragma once
+
+// uint8_t, uint32_t, int32_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: SSE4.2 crc32 instruction, picked at runtime if the CPU supports it
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC32C_USE_SSE42
+#endif
+
+/// compute CRC32C using the fastest algorithm the CPU supports (SSE4.2 or Slicing-by-8)
+uint32_t crc32c_fast   (const void* data, size_t length, uint32_t previousCrc32c = 0);
+
+/// merge two CRC32C such that result = crc32c(dataB, lengthB, crc32c(dataA, lengthA))
+uint32_t crc32c_combine(uint32_t crcA, uint32_t crcB, size_t lengthB);
+
+/// compute the CRC32C of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+void     crc32c_multi  (const void* const* data, const size_t* lengths, uint32_t* crcs, size_t count);
+
+/// compute CRC32C (bitwise algorithm)
+uint32_t crc32c_bitwise(const void* data, size_t length, uint32_t previousCrc32c = 0);
+/// compute CRC32C (Slicing-by-8 algorithm)
+uint32_t crc32c_8bytes (const void* data, size_t length, uint32_t previousCrc32c = 0);
+
+#ifdef CRC32C_USE_SSE42
+/// compute CRC32C (SSE4.2 crc32 instruction, three interleaved streams), see crc32c_sse42_supported
+uint32_t crc32c_sse42  (const void* data, size_t length, uint32_t previousCrc32c = 0);
+/// true if the running CPU can execute crc32c_sse42
+bool crc32c_sse42_supported();
+#endif
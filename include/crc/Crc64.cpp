@@ -0,0 +1,206 @@
+// //////////////////////////////////////////////////////////
+// Crc64.cpp
+// CRC-64/XZ (ECMA-182 polynomial 0x42F0E1EBA9EA3693, reflected), same interface as Crc32.cpp
+// the portable code and all lookup tables come from CrcEngine.h
+//
+
+#include "Crc64.h"
+#include "CrcEngine.h"
+
+#ifdef CRC64_USE_PCLMUL
+  #include <utils/CpuFeatures.h>
+
+namespace
+{
+  // folding constants, each pair is (x^(D+63) mod P, x^(D-1) mod P) bit-reflected,
+  // to fold a 128 bit value across a distance of D bits (same scheme as crc32_pclmul, but the
+  // remainders have 64 bits so no extra shift is needed to line up the 127 bit products)
+  alignas(16) const uint64_t Fold512[2] = { 0x6ae3efbb9dd441f3, 0x081f6054a7842df4 }; // 4x128 bits
+  alignas(16) const uint64_t Fold128[2] = { 0xe05dd497ca393ae4, 0xdabe95afc7875f40 }; // 1x128 bits
+
+  /// fold one 128 bit lane across "constants" and add the next 16 bytes
+  SFV_TARGET("pclmul")
+  inline __m128i fold128(__m128i value, __m128i constants, __m128i next)
+  {
+    __m128i low  = _mm_clmulepi64_si128(value, constants, 0x00);
+    __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), next);
+  }
+
+  /// what is left is congruent to a 16 byte message starting from a zero register,
+  /// two Slicing-by-8 steps reduce it (a crc of previousCrc64 = ~0 starts with a zero register)
+  SFV_TARGET("pclmul")
+  inline uint64_t pclmulReduce(__m128i value)
+  {
+    alignas(16) uint8_t rest[16];
+    _mm_store_si128((__m128i*) rest, value);
+    return ~Crc64XzEngine::update(rest, sizeof(rest), ~(uint64_t) 0);
+  }
+
+  /// process a multiple of 16 bytes (at least 64 bytes), crc is not inverted
+  SFV_TARGET("pclmul")
+  uint64_t pclmulFold(uint64_t crc, const uint8_t* current, size_t length)
+  {
+    // four independent 128 bit accumulators hide the latency of PCLMULQDQ
+    __m128i x1 = _mm_loadu_si128((const __m128i*) (current +  0));
+    __m128i x2 = _mm_loadu_si128((const __m128i*) (current + 16));
+    __m128i x3 = _mm_loadu_si128((const __m128i*) (current + 32));
+    __m128i x4 = _mm_loadu_si128((const __m128i*) (current + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi64_si128((long long) crc));
+    current += 64;
+    length  -= 64;
+
+    const __m128i fold512Constants = _mm_load_si128((const __m128i*) Fold512);
+    for (; length >= 64; length -= 64, current += 64)
+    {
+      x1 = fold128(x1, fold512Constants, _mm_loadu_si128((const __m128i*) (current +  0)));
+      x2 = fold128(x2, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 16)));
+      x3 = fold128(x3, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 32)));
+      x4 = fold128(x4, fold512Constants, _mm_loadu_si128((const __m128i*) (current + 48)));
+    }
+
+    // merge the accumulators, then fold the remaining 16 byte blocks
+    const __m128i fold128Constants = _mm_load_si128((const __m128i*) Fold128);
+    x2 = fold128(x1, fold128Constants, x2);
+    x3 = fold128(x2, fold128Constants, x3);
+    x4 = fold128(x3, fold128Constants, x4);
+    for (; length >= 16; length -= 16, current += 16)
+      x4 = fold128(x4, fold128Constants, _mm_loadu_si128((const __m128i*) current));
+
+    return pclmulReduce(x4);
+  }
+
+  /// the first "common" bytes (a multiple of 16, at least 16) of four independent buffers in lockstep,
+  /// one 128 bit accumulator each, crcs are not inverted
+  SFV_TARGET("pclmul")
+  void pclmulMulti4(const uint8_t* const* data, size_t common, uint64_t* crcs)
+  {
+    const uint8_t* current0 = data[0];
+    const uint8_t* current1 = data[1];
+    const uint8_t* current2 = data[2];
+    const uint8_t* current3 = data[3];
+    __m128i x0 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current0), _mm_cvtsi64_si128((long long) crcs[0]));
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current1), _mm_cvtsi64_si128((long long) crcs[1]));
+    __m128i x2 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current2), _mm_cvtsi64_si128((long long) crcs[2]));
+    __m128i x3 = _mm_xor_si128(_mm_loadu_si128((const __m128i*) current3), _mm_cvtsi64_si128((long long) crcs[3]));
+
+    // the four dependency chains are independent, so their PCLMULQDQ latencies overlap
+    const __m128i fold128Constants = _mm_load_si128((const __m128i*) Fold128);
+    for (size_t offset = 16; offset < common; offset += 16)
+    {
+      x0 = fold128(x0, fold128Constants, _mm_loadu_si128((const __m128i*) (current0 + offset)));
+      x1 = fold128(x1, fold128Constants, _mm_loadu_si128((const __m128i*) (current1 + offset)));
+      x2 = fold128(x2, fold128Constants, _mm_loadu_si128((const __m128i*) (current2 + offset)));
+      x3 = fold128(x3, fold128Constants, _mm_loadu_si128((const __m128i*) (current3 + offset)));
+    }
+
+    crcs[0] = pclmulReduce(x0);
+    crcs[1] = pclmulReduce(x1);
+    crcs[2] = pclmulReduce(x2);
+    crcs[3] = pclmulReduce(x3);
+  }
+} // anonymous namespace
+#endif
+
+
+/// compute CRC64 (bitwise algorithm)
+uint64_t crc64_bitwise(const void* data, size_t length, uint64_t previousCrc64)
+{
+  return Crc64XzEngine::bitwise(data, length, previousCrc64);
+}
+
+
+/// compute CRC64 (Slicing-by-8 algorithm)
+uint64_t crc64_8bytes(const void* data, size_t length, uint64_t previousCrc64)
+{
+  return Crc64XzEngine::update(data, length, previousCrc64);
+}
+
+
+#ifdef CRC64_USE_PCLMUL
+/// true if the running CPU can execute crc64_pclmul
+bool crc64_pclmul_supported()
+{
+  return CpuFeatures::get().pclmul();
+}
+
+
+/// compute CRC64 (carry-less multiplication folding, requires PCLMULQDQ)
+uint64_t crc64_pclmul(const void* data, size_t length, uint64_t previousCrc64)
+{
+  // too short to fold
+  if (length < 64)
+    return crc64_8bytes(data, length, previousCrc64);
+
+  const uint8_t* current = (const uint8_t*) data;
+  const size_t folded = length & ~(size_t) 15;
+  uint64_t crc = ~pclmulFold(~previousCrc64, current, folded);
+
+  // remaining 0 to 15 bytes (standard algorithm)
+  return crc64_8bytes(current + folded, length - folded, crc);
+}
+#endif
+
+
+/// compute the CRC64 of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+void crc64_multi(const void* const* data, const size_t* lengths, uint64_t* crcs, size_t count)
+{
+  size_t done = 0;
+#ifdef CRC64_USE_PCLMUL
+  // cpuid is only queried once
+  static const bool hasPclmul = crc64_pclmul_supported();
+  if (hasPclmul)
+  {
+    const size_t Lanes = 4;
+    for (; done + Lanes <= count; done += Lanes)
+    {
+      const uint8_t* current[Lanes];
+      size_t shortest = lengths[done];
+      for (size_t lane = 0; lane < Lanes; lane++)
+      {
+        current[lane] = (const uint8_t*) data[done + lane];
+        shortest = lengths[done + lane] < shortest ? lengths[done + lane] : shortest;
+      }
+      // lanes only pay off once there is something to fold
+      if (shortest < 32)
+      {
+        for (size_t lane = 0; lane < Lanes; lane++)
+          crcs[done + lane] = crc64_fast(current[lane], lengths[done + lane], crcs[done + lane]);
+        continue;
+      }
+
+      uint64_t crc[Lanes];
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crc[lane] = ~crcs[done + lane];
+      const size_t common = shortest & ~(size_t) 15;
+      pclmulMulti4(current, common, crc);
+
+      // whatever the shortest buffer didn't cover (at least the last 0 to 15 bytes)
+      for (size_t lane = 0; lane < Lanes; lane++)
+        crcs[done + lane] = crc64_fast(current[lane] + common, lengths[done + lane] - common, ~crc[lane]);
+    }
+  }
+#endif
+  for (; done < count; done++)
+    crcs[done] = crc64_fast(data[done], lengths[done], crcs[done]);
+}
+
+
+/// compute CRC64 using the fastest algorithm the CPU supports (PCLMULQDQ or Slicing-by-8)
+uint64_t crc64_fast(const void* data, size_t length, uint64_t previousCrc64)
+{
+#ifdef CRC64_USE_PCLMUL
+  // cpuid is only queried once
+  static const bool hasPclmul = crc64_pclmul_supported();
+  if (hasPclmul)
+    return crc64_pclmul(data, length, previousCrc64);
+#endif
+  return crc64_8bytes(data, length, previousCrc64);
+}
+
+
+/// merge two CRC64 such that result = crc64(dataB, lengthB, crc64(dataA, lengthA))
+uint64_t crc64_combine(uint64_t crcA, uint64_t crcB, size_t lengthB)
+{
+  return Crc64XzEngine::combine(crcA, crcB, lengthB);
+}
@@ -0,0 +1,38 @@
+// //////////////////////////////////////////////////////////
+// Crc64.h
+// CRC-64/XZ (ECMA-182 polynomial 0x42F0E1EBA9EA3693, reflected), same interface as Crc32.h
+// used by xz and 7-Zip, check value crc64("123456789") = 0x995DC9BBDF1939FA
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: carry-less multiplication kernel, picked at runtime if the CPU supports it
+#if defined(__x86_64__) || defined(_M_X64)
+#define CRC64_USE_PCLMUL
+#endif
+
+/// compute CRC64 using the fastest algorithm the CPU supports (PCLMULQDQ or Slicing-by-8)
+uint64_t crc64_fast   (const void* data, size_t length, uint64_t previousCrc64 = 0);
+
+/// merge two CRC64 such that result = crc64(dataB, lengthB, crc64(dataA, lengthA))
+uint64_t crc64_combine(uint64_t crcA, uint64_t crcB, size_t lengthB);
+
+/// compute the CRC64 of several independent buffers at once, crcs[i] holds the previous CRC of data[i] and receives the new one
+void     crc64_multi  (const void* const* data, const size_t* lengths, uint64_t* crcs, size_t count);
+
+/// compute CRC64 (bitwise algorithm)
+uint64_t crc64_bitwise(const void* data, size_t length, uint64_t previousCrc64 = 0);
+/// compute CRC64 (Slicing-by-8 algorithm)
+uint64_t crc64_8bytes (const void* data, size_t length, uint64_t previousCrc64 = 0);
+
+#ifdef CRC64_USE_PCLMUL
+/// compute CRC64 (carry-less multiplication folding, requires PCLMULQDQ, see crc64_pclmul_supported)
+uint64_t crc64_pclmul (const void* data, size_t length, uint64_t previousCrc64 = 0);
+/// true if the running CPU can execute crc64_pclmul
+bool crc64_pclmul_supported();
+#endif
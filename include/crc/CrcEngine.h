@@ -0,0 +1,282 @@
+// //////////////////////////////////////////////////////////
+// CrcEngine.h
+// table driven CRC for any polynomial of 8 to 64 bits, all tables are generated by the compiler
+//
+// each instantiation is a separate type with its own tables, there is no runtime branching on the polynomial:
+//   using Crc64Xz = CrcEngine<uint64_t, 64, 0x42F0E1EBA9EA3693, true, 0xFFFFFFFFFFFFFFFF>;
+//   uint64_t crc = Crc64Xz::update(data, length);
+//
+// parameters follow the usual CRC catalogue notation (poly, refin = refout, init = xorout):
+// - Polynomial is given in normal (non-reflected) form without the leading x^Width term
+// - Reflected processes bytes LSB-first (zlib, CRC-32C, CRC-64/XZ) or MSB-first (bzip2, CRC-16/GENIBUS)
+// - XorOut is applied to the initial and the final value, so update() can continue from a previous crc
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+// memcpy
+#include <cstring>
+// std::index_sequence
+#include <utility>
+
+template <typename Crc, unsigned Width, Crc Polynomial, bool Reflected, Crc XorOut = Crc(~Crc(0)), size_t Slices = 8>
+class CrcEngine
+{
+  static_assert(Width >= 8 && Width <= 8 * sizeof(Crc) && sizeof(Crc) <= 8, "CrcEngine supports 8 to 64 bit CRCs");
+  static_assert(Slices == 1 || Slices % 8 == 0, "CrcEngine processes 1 or a multiple of 8 bytes per step");
+
+public:
+  typedef Crc value_type;
+
+  /// bits of the CRC register
+  static constexpr unsigned Bits = 8 * sizeof(Crc);
+  /// all bits of a Width-bit crc
+  static constexpr Crc Mask = Crc(Crc(~Crc(0)) >> (Bits - Width));
+
+  /// compute the CRC (Slicing-by-N algorithm)
+  static Crc update(const void* data, size_t length, Crc previousCrc = 0)
+  {
+    Crc crc = toRegister(Crc(previousCrc ^ XorOut));
+    const uint8_t* current = (const uint8_t*) data;
+
+    if constexpr (Slices > 1)
+    {
+      const size_t Words = Slices / 8;
+      while (length >= Slices)
+      {
+        uint64_t words[Words];
+        for (size_t w = 0; w < Words; w++)
+          words[w] = load64(current + 8 * w);
+        // the first Bits/8 bytes absorb the current crc
+        if constexpr (Reflected)
+          words[0] ^= (uint64_t) crc;
+        else
+          words[0] ^= (uint64_t) crc << (64 - Bits);
+
+        crc = slice(words, std::make_index_sequence<Slices>());
+
+        current += Slices;
+        length  -= Slices;
+      }
+    }
+
+    // remaining bytes (standard algorithm)
+    while (length-- != 0)
+      crc = step(crc, *current++);
+
+    return Crc(fromRegister(crc) ^ XorOut);
+  }
+
+  /// compute the CRC (bitwise algorithm), reference implementation
+  static Crc bitwise(const void* data, size_t length, Crc previousCrc = 0)
+  {
+    Crc crc = toRegister(Crc(previousCrc ^ XorOut));
+    const uint8_t* current = (const uint8_t*) data;
+
+    while (length-- != 0)
+      crc = shiftByte(Reflected ? Crc(crc ^ *current++) : Crc(crc ^ (Crc(*current++) << (Bits - 8))));
+
+    return Crc(fromRegister(crc) ^ XorOut);
+  }
+
+  /// merge two CRCs such that result = update(dataB, lengthB, update(dataA, lengthA))
+  static Crc combine(Crc crcA, Crc crcB, size_t lengthB)
+  {
+    return Crc(multiply(zeroBytesOperator(lengthB), crcA) ^ crcB);
+  }
+
+  /// x^0 in the bit order of the crc
+  static constexpr Crc One = Reflected ? Crc(Crc(1) << (Width - 1)) : Crc(1);
+
+  /// multiply two polynomials modulo the CRC polynomial, both in the bit order of the crc
+  static constexpr Crc multiply(Crc a, Crc b)
+  {
+    Crc product = 0;
+    if constexpr (Reflected)
+    {
+      // bit Width-1 is x^0
+      for (Crc mask = One; mask != 0; mask >>= 1)
+      {
+        if (a & mask)
+          product ^= b;
+        b = timesX(b);
+      }
+    }
+    else
+    {
+      // Horner's method, highest power of a first
+      for (unsigned i = Width; i-- > 0; )
+      {
+        product = timesX(product);
+        if ((a >> i) & 1)
+          product ^= b;
+      }
+    }
+    return product;
+  }
+
+  /// x^(8 * length) mod P: multiplying a crc with it appends length zero bytes
+  static constexpr Crc zeroBytesOperator(size_t length)
+  {
+    // at most one multiplication per non-zero hex digit of length
+    Crc op = One;
+    for (int digit = 0; length != 0; digit++, length >>= 4)
+      if (length & 15)
+        op = (op == One) ? ZeroBytes.power[digit][length & 15]
+                         : multiply(op, ZeroBytes.power[digit][length & 15]);
+    return op;
+  }
+
+private:
+  /// polynomial in the bit order used by the CRC register
+  static constexpr Crc reflect(Crc value)
+  {
+    Crc result = 0;
+    for (unsigned i = 0; i < Width; i++)
+      if ((value >> i) & 1)
+        result |= Crc(1) << (Width - 1 - i);
+    return result;
+  }
+
+  /// reflected crcs sit in the low Width bits, normal ones are left-aligned in the register
+  static constexpr Crc RegisterPolynomial = Reflected ? reflect(Polynomial) : Crc(Crc(Polynomial) << (Bits - Width));
+
+  static constexpr Crc toRegister  (Crc crc) { return Reflected ? crc : Crc(crc << (Bits - Width)); }
+  static constexpr Crc fromRegister(Crc crc) { return Reflected ? crc : Crc(crc >> (Bits - Width)); }
+
+  /// eight zero bits through the register
+  static constexpr Crc shiftByte(Crc crc)
+  {
+    for (int bit = 0; bit < 8; bit++)
+    {
+      if constexpr (Reflected)
+        crc = Crc((crc >> 1) ^ ((crc & 1) ? RegisterPolynomial : 0));
+      else
+        crc = Crc((crc << 1) ^ (((crc >> (Bits - 1)) & 1) ? RegisterPolynomial : 0));
+    }
+    return crc;
+  }
+
+  /// multiply by x modulo P, in the bit order of the crc
+  static constexpr Crc timesX(Crc value)
+  {
+    if constexpr (Reflected)
+      return Crc((value >> 1) ^ ((value & 1) ? RegisterPolynomial : 0));
+    else
+      return Crc(((value << 1) & Mask) ^ (((value >> (Width - 1)) & 1) ? Polynomial : 0));
+  }
+
+  /// read eight bytes, LSB-first CRCs want little endian and MSB-first CRCs big endian words
+  static inline uint64_t load64(const uint8_t* current)
+  {
+    uint64_t value;
+    memcpy(&value, current, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    const bool swap = Reflected;
+#else
+    const bool swap = !Reflected;
+#endif
+    if (swap)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+      value = __builtin_bswap64(value);
+#else
+      value = ((value & 0x00000000000000FFull) << 56) | ((value & 0x000000000000FF00ull) << 40) |
+              ((value & 0x0000000000FF0000ull) << 24) | ((value & 0x00000000FF000000ull) <<  8) |
+              ((value & 0x000000FF00000000ull) >>  8) | ((value & 0x0000FF0000000000ull) >> 24) |
+              ((value & 0x00FF000000000000ull) >> 40) | ((value & 0xFF00000000000000ull) >> 56);
+#endif
+    }
+    return value;
+  }
+
+  /// n-th byte of a word in processing order
+  static inline uint8_t byteOf(uint64_t word, size_t n)
+  {
+    return Reflected ? uint8_t(word >> (8 * n)) : uint8_t(word >> (56 - 8 * n));
+  }
+
+  /// one table lookup per byte, unrolled at compile time
+  template <size_t... Byte>
+  static inline Crc slice(const uint64_t* words, std::index_sequence<Byte...>)
+  {
+    return Crc((Lookup.table[Slices - 1 - Byte][byteOf(words[Byte / 8], Byte % 8)] ^ ...));
+  }
+
+  /// one byte (standard algorithm)
+  static inline Crc step(Crc crc, uint8_t byte)
+  {
+    if constexpr (Reflected)
+      return Crc((Bits > 8 ? crc >> 8 : 0) ^ Lookup.table[0][(crc ^ byte) & 0xFF]);
+    else
+      return Crc((Bits > 8 ? crc << 8 : 0) ^ Lookup.table[0][((crc >> (Bits - 8)) ^ byte) & 0xFF]);
+  }
+
+  static constexpr size_t Tables = Slices > 1 ? Slices : 1;
+
+  /// table[0] is the standard bytewise table, table[n] is table[0] delayed by n zero bytes
+  struct SlicingTable
+  {
+    Crc table[Tables][256];
+  };
+
+  static constexpr SlicingTable makeSlicingTable()
+  {
+    SlicingTable lookup{};
+    for (unsigned i = 0; i < 256; i++)
+      lookup.table[0][i] = shiftByte(Reflected ? Crc(i) : Crc(Crc(i) << (Bits - 8)));
+    for (size_t slice = 1; slice < Tables; slice++)
+      for (unsigned i = 0; i < 256; i++)
+        lookup.table[slice][i] = step(lookup.table[slice - 1][i], 0, lookup.table[0]);
+    return lookup;
+  }
+
+  /// same as step() but usable while the table is being built
+  static constexpr Crc step(Crc crc, uint8_t byte, const Crc (&table0)[256])
+  {
+    if constexpr (Reflected)
+      return Crc((Bits > 8 ? crc >> 8 : 0) ^ table0[(crc ^ byte) & 0xFF]);
+    else
+      return Crc((Bits > 8 ? crc << 8 : 0) ^ table0[((crc >> (Bits - 8)) ^ byte) & 0xFF]);
+  }
+
+  static constexpr SlicingTable Lookup = makeSlicingTable();
+
+  /// ZeroBytes.power[i][j] = x^(8 * j * 16^i) mod P, one row per hex digit of a 64 bit byte count
+  struct ZeroBytesTable
+  {
+    Crc power[16][16];
+  };
+
+  static constexpr ZeroBytesTable makeZeroBytesTable()
+  {
+    ZeroBytesTable table{};
+    Crc base = One;
+    for (int bit = 0; bit < 8; bit++)
+      base = timesX(base); // x^8
+    for (int digit = 0; digit < 16; digit++)
+    {
+      table.power[digit][0] = One;
+      for (int j = 1; j < 16; j++)
+        table.power[digit][j] = multiply(table.power[digit][j - 1], base);
+      base = multiply(table.power[digit][15], base); // x^(8 * 16^(digit+1))
+    }
+    return table;
+  }
+
+  static constexpr ZeroBytesTable ZeroBytes = makeZeroBytesTable();
+};
+
+// common CRCs, see https://reveng.sourceforge.io/crc-catalogue/
+/// CRC-32 (zlib, SFV), same results as crc32_fast
+typedef CrcEngine<uint32_t, 32, 0x04C11DB7,         true, 0xFFFFFFFF, 16> Crc32Engine;
+/// CRC-32C (Castagnoli), same results as crc32c_fast
+typedef CrcEngine<uint32_t, 32, 0x1EDC6F41,         true, 0xFFFFFFFF,  8> Crc32cEngine;
+/// CRC-64/XZ (ECMA-182 polynomial, reflected), used by xz and 7-Zip
+typedef CrcEngine<uint64_t, 64, 0x42F0E1EBA9EA3693, true, 0xFFFFFFFFFFFFFFFF, 8> Crc64XzEngine;
+/// CRC-64/NVME (Rocksoft polynomial), used by NVMe end-to-end data protection
+typedef CrcEngine<uint64_t, 64, 0xAD93D23594C93659, true, 0xFFFFFFFFFFFFFFFF, 8> Crc64NvmeEngine;
@@ -0,0 +1,566 @@
+// //////////////////////////////////////////////////////////
+// Blake3.cpp
+// BLAKE3, see Blake3.h
+// the 7 rounds of a compression are listed once in BLAKE3_ROUNDS and expanded by the scalar and by each SIMD kernel,
+// the kernels give every lane a different chunk or parent of a subtree, partial chunks and the nodes above a subtree use the scalar code
+//
+
+#include "Blake3.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifdef BLAKE3_USE_SIMD
+  #include <utils/CpuFeatures.h>
+#endif
+
+// G(a, b, c, d, x, y) mixes state words a, b, c, d with message words x and y,
+// four column G then four diagonal G per round, the message words are permuted from round to round
+#define BLAKE3_ROUNDS(G) \
+  G(0, 4,  8, 12,  0,  1) G(1, 5,  9, 13,  2,  3) G(2, 6, 10, 14,  4,  5) G(3, 7, 11, 15,  6,  7) \
+  G(0, 5, 10, 15,  8,  9) G(1, 6, 11, 12, 10, 11) G(2, 7,  8, 13, 12, 13) G(3, 4,  9, 14, 14, 15) \
+  G(0, 4,  8, 12,  2,  6) G(1, 5,  9, 13,  3, 10) G(2, 6, 10, 14,  7,  0) G(3, 7, 11, 15,  4, 13) \
+  G(0, 5, 10, 15,  1, 11) G(1, 6, 11, 12, 12,  5) G(2, 7,  8, 13,  9, 14) G(3, 4,  9, 14, 15,  8) \
+  G(0, 4,  8, 12,  3,  4) G(1, 5,  9, 13, 10, 12) G(2, 6, 10, 14, 13,  2) G(3, 7, 11, 15,  7, 14) \
+  G(0, 5, 10, 15,  6,  5) G(1, 6, 11, 12,  9,  0) G(2, 7,  8, 13, 11, 15) G(3, 4,  9, 14,  8,  1) \
+  G(0, 4,  8, 12, 10,  7) G(1, 5,  9, 13, 12,  9) G(2, 6, 10, 14, 14,  3) G(3, 7, 11, 15, 13, 15) \
+  G(0, 5, 10, 15,  4,  0) G(1, 6, 11, 12, 11,  2) G(2, 7,  8, 13,  5,  8) G(3, 4,  9, 14,  1,  6) \
+  G(0, 4,  8, 12, 12, 13) G(1, 5,  9, 13,  9, 11) G(2, 6, 10, 14, 15, 10) G(3, 7, 11, 15, 14,  8) \
+  G(0, 5, 10, 15,  7,  2) G(1, 6, 11, 12,  5,  3) G(2, 7,  8, 13,  0,  1) G(3, 4,  9, 14,  6,  4) \
+  G(0, 4,  8, 12,  9, 14) G(1, 5,  9, 13, 11,  5) G(2, 6, 10, 14,  8, 12) G(3, 7, 11, 15, 15,  1) \
+  G(0, 5, 10, 15, 13,  3) G(1, 6, 11, 12,  0, 10) G(2, 7,  8, 13,  2,  6) G(3, 4,  9, 14,  4,  7) \
+  G(0, 4,  8, 12, 11, 15) G(1, 5,  9, 13,  5,  0) G(2, 6, 10, 14,  1,  9) G(3, 7, 11, 15,  8,  6) \
+  G(0, 5, 10, 15, 14, 10) G(1, 6, 11, 12,  2, 12) G(2, 7,  8, 13,  3,  4) G(3, 4,  9, 14,  7, 13)
+
+namespace
+{
+  /// same as SHA-256's initial hash
+  const uint32_t IV[8] = { 0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19 };
+
+  /// domain flags, the last word of the compression input
+  enum : uint8_t { ChunkStart = 1, ChunkEnd = 2, Parent = 4, Root = 8 };
+
+  /// 64 byte block to little endian words, compilers turn this into plain loads on x86
+  inline void loadBlock(const uint8_t* block, uint32_t words[16])
+  {
+    for (int i = 0; i < 16; ++i)
+      words[i] = (uint32_t) block[4*i] | (uint32_t) block[4*i + 1] << 8 | (uint32_t) block[4*i + 2] << 16 | (uint32_t) block[4*i + 3] << 24;
+  }
+
+  inline uint32_t rotr(uint32_t x, int bits) { return (x >> bits) | (x << (32 - bits)); }
+
+  /// one compression, "out" receives the new chaining value (may be the same array as "cv")
+  void compress(const uint32_t cv[8], const uint32_t m[16], uint32_t blockLength, uint64_t counter, uint32_t flags, uint32_t out[8])
+  {
+    uint32_t v[16] = { cv[0], cv[1], cv[2], cv[3], cv[4], cv[5], cv[6], cv[7],
+                       IV[0], IV[1], IV[2], IV[3], (uint32_t) counter, (uint32_t) (counter >> 32), blockLength, flags };
+    #define G(a, b, c, d, x, y) \
+      v[a] += v[b] + m[x]; v[d] = rotr(v[d] ^ v[a], 16); v[c] += v[d]; v[b] = rotr(v[b] ^ v[c], 12); \
+      v[a] += v[b] + m[y]; v[d] = rotr(v[d] ^ v[a],  8); v[c] += v[d]; v[b] = rotr(v[b] ^ v[c],  7);
+    BLAKE3_ROUNDS(G)
+    #undef G
+    for (int i = 0; i < 8; ++i)
+      out[i] = v[i] ^ v[i + 8];
+  }
+
+  /// chaining value of a parent node
+  void parentCv(const uint32_t left[8], const uint32_t right[8], uint32_t flags, uint32_t out[8])
+  {
+    uint32_t m[16];
+    std::memcpy(m,     left,  32);
+    std::memcpy(m + 8, right, 32);
+    compress(IV, m, 64, 0, Parent | flags, out);
+  }
+
+  /// compress "blocks" consecutive blocks of every input, starting from IV, cvs[i] receives the chaining value of input i.
+  /// Input i has the counter "counter + i" for chunks (incrementCounter) or "counter" for parents,
+  /// its first block gets flags | flagsStart and its last flags | flagsEnd
+  typedef void (*LaneFunction)(const uint8_t* const* inputs, size_t blocks, uint64_t counter, bool incrementCounter,
+                               uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8]);
+
+  /// one input
+  void portableLanes(const uint8_t* const* inputs, size_t blocks, uint64_t counter, bool, uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8])
+  {
+    std::memcpy(cvs[0], IV, 32);
+    for (size_t block = 0; block < blocks; ++block)
+    {
+      uint32_t m[16];
+      loadBlock(inputs[0] + 64 * block, m);
+      compress(cvs[0], m, 64, counter, flags | (block == 0 ? flagsStart : 0) | (block == blocks - 1 ? flagsEnd : 0), cvs[0]);
+    }
+  }
+
+#ifdef BLAKE3_USE_SIMD
+  /// 16 bytes of four lanes, r0..r3 hold lane 0..3, afterwards word i of every lane
+  #define BLAKE3_TRANSPOSE(unpacklo32, unpackhi32, unpacklo64, unpackhi64, w, r0, r1, r2, r3) \
+  { \
+    const auto t0 = unpacklo32(r0, r1), t1 = unpacklo32(r2, r3); \
+    const auto t2 = unpackhi32(r0, r1), t3 = unpackhi32(r2, r3); \
+    (w)[0] = unpacklo64(t0, t1); (w)[1] = unpackhi64(t0, t1); \
+    (w)[2] = unpacklo64(t2, t3); (w)[3] = unpackhi64(t2, t3); \
+  }
+
+  /// low and high counter words of every lane
+  inline void laneCounters(uint64_t counter, bool incrementCounter, int lanes, uint32_t* low, uint32_t* high)
+  {
+    for (int lane = 0; lane < lanes; ++lane)
+    {
+      const uint64_t value = incrementCounter ? counter + lane : counter;
+      low [lane] = (uint32_t) value;
+      high[lane] = (uint32_t) (value >> 32);
+    }
+  }
+
+  // ---------- SSE4.1, 4 lanes: 16 and 8 bit rotations are byte shuffles ----------
+
+  SFV_TARGET("sse4.1")
+  void sseLanes(const uint8_t* const* inputs, size_t blocks, uint64_t counter, bool incrementCounter,
+                uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8])
+  {
+    const __m128i rot16 = _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m128i rot8  = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    alignas(16) uint32_t low[4], high[4];
+    laneCounters(counter, incrementCounter, 4, low, high);
+
+    __m128i h[8];
+    for (int i = 0; i < 8; ++i)
+      h[i] = _mm_set1_epi32((int) IV[i]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m128i m[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m128i r0 = _mm_loadu_si128((const __m128i*) (inputs[0] + offset + 4*i));
+        const __m128i r1 = _mm_loadu_si128((const __m128i*) (inputs[1] + offset + 4*i));
+        const __m128i r2 = _mm_loadu_si128((const __m128i*) (inputs[2] + offset + 4*i));
+        const __m128i r3 = _mm_loadu_si128((const __m128i*) (inputs[3] + offset + 4*i));
+        BLAKE3_TRANSPOSE(_mm_unpacklo_epi32, _mm_unpackhi_epi32, _mm_unpacklo_epi64, _mm_unpackhi_epi64, m + i, r0, r1, r2, r3)
+      }
+
+      const uint32_t blockFlags = flags | (offset == 0 ? flagsStart : 0) | (offset == blocks * 64 - 64 ? flagsEnd : 0);
+      __m128i v[16] = { h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                        _mm_set1_epi32((int) IV[0]), _mm_set1_epi32((int) IV[1]), _mm_set1_epi32((int) IV[2]), _mm_set1_epi32((int) IV[3]),
+                        _mm_load_si128((const __m128i*) low), _mm_load_si128((const __m128i*) high), _mm_set1_epi32(64), _mm_set1_epi32((int) blockFlags) };
+      #define G(a, b, c, d, x, y) \
+        v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), m[x]); v[d] = _mm_shuffle_epi8(_mm_xor_si128(v[d], v[a]), rot16); \
+        v[c] = _mm_add_epi32(v[c], v[d]); v[b] = _mm_xor_si128(v[b], v[c]); v[b] = _mm_or_si128(_mm_srli_epi32(v[b], 12), _mm_slli_epi32(v[b], 20)); \
+        v[a] = _mm_add_epi32(_mm_add_epi32(v[a], v[b]), m[y]); v[d] = _mm_shuffle_epi8(_mm_xor_si128(v[d], v[a]), rot8); \
+        v[c] = _mm_add_epi32(v[c], v[d]); v[b] = _mm_xor_si128(v[b], v[c]); v[b] = _mm_or_si128(_mm_srli_epi32(v[b],  7), _mm_slli_epi32(v[b], 25));
+      BLAKE3_ROUNDS(G)
+      #undef G
+      for (int i = 0; i < 8; ++i)
+        h[i] = _mm_xor_si128(v[i], v[i + 8]);
+    }
+
+    alignas(16) uint32_t lanes[8][4];
+    for (int i = 0; i < 8; ++i)
+      _mm_store_si128((__m128i*) lanes[i], h[i]);
+    for (int lane = 0; lane < 4; ++lane)
+      for (int i = 0; i < 8; ++i)
+        cvs[lane][i] = lanes[i][lane];
+  }
+
+  // ---------- AVX2, 8 lanes: the low 128 bits hold lanes 0..3, the high 128 bits lanes 4..7 ----------
+
+  SFV_TARGET("avx2") inline __m256i avx2Load(const uint8_t* low, const uint8_t* high)
+  {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) low)), _mm_loadu_si128((const __m128i*) high), 1);
+  }
+
+  SFV_TARGET("avx2")
+  void avx2Lanes(const uint8_t* const* inputs, size_t blocks, uint64_t counter, bool incrementCounter,
+                 uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8])
+  {
+    const __m256i rot16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13, 2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i rot8  = _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12, 1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+    alignas(32) uint32_t low[8], high[8];
+    laneCounters(counter, incrementCounter, 8, low, high);
+
+    __m256i h[8];
+    for (int i = 0; i < 8; ++i)
+      h[i] = _mm256_set1_epi32((int) IV[i]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m256i m[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m256i r0 = avx2Load(inputs[0] + offset + 4*i, inputs[4] + offset + 4*i);
+        const __m256i r1 = avx2Load(inputs[1] + offset + 4*i, inputs[5] + offset + 4*i);
+        const __m256i r2 = avx2Load(inputs[2] + offset + 4*i, inputs[6] + offset + 4*i);
+        const __m256i r3 = avx2Load(inputs[3] + offset + 4*i, inputs[7] + offset + 4*i);
+        BLAKE3_TRANSPOSE(_mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64, m + i, r0, r1, r2, r3)
+      }
+
+      const uint32_t blockFlags = flags | (offset == 0 ? flagsStart : 0) | (offset == blocks * 64 - 64 ? flagsEnd : 0);
+      __m256i v[16] = { h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                        _mm256_set1_epi32((int) IV[0]), _mm256_set1_epi32((int) IV[1]), _mm256_set1_epi32((int) IV[2]), _mm256_set1_epi32((int) IV[3]),
+                        _mm256_load_si256((const __m256i*) low), _mm256_load_si256((const __m256i*) high), _mm256_set1_epi32(64), _mm256_set1_epi32((int) blockFlags) };
+      #define G(a, b, c, d, x, y) \
+        v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), m[x]); v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), rot16); \
+        v[c] = _mm256_add_epi32(v[c], v[d]); v[b] = _mm256_xor_si256(v[b], v[c]); v[b] = _mm256_or_si256(_mm256_srli_epi32(v[b], 12), _mm256_slli_epi32(v[b], 20)); \
+        v[a] = _mm256_add_epi32(_mm256_add_epi32(v[a], v[b]), m[y]); v[d] = _mm256_shuffle_epi8(_mm256_xor_si256(v[d], v[a]), rot8); \
+        v[c] = _mm256_add_epi32(v[c], v[d]); v[b] = _mm256_xor_si256(v[b], v[c]); v[b] = _mm256_or_si256(_mm256_srli_epi32(v[b],  7), _mm256_slli_epi32(v[b], 25));
+      BLAKE3_ROUNDS(G)
+      #undef G
+      for (int i = 0; i < 8; ++i)
+        h[i] = _mm256_xor_si256(v[i], v[i + 8]);
+    }
+
+    alignas(32) uint32_t lanes[8][8];
+    for (int i = 0; i < 8; ++i)
+      _mm256_store_si256((__m256i*) lanes[i], h[i]);
+    for (int lane = 0; lane < 8; ++lane)
+      for (int i = 0; i < 8; ++i)
+        cvs[lane][i] = lanes[i][lane];
+  }
+
+  // ---------- AVX-512, 16 lanes: 128 bit part j holds lanes 4j..4j+3, rotations are single instructions ----------
+
+  SFV_TARGET("avx512f") inline __m512i avx512Load(const uint8_t* const* inputs, size_t lane, size_t offset)
+  {
+    __m512i value = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*) (inputs[lane] + offset)));
+    value = _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (inputs[lane +  4] + offset)), 1);
+    value = _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (inputs[lane +  8] + offset)), 2);
+    return  _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (inputs[lane + 12] + offset)), 3);
+  }
+
+  SFV_TARGET("avx512f")
+  void avx512Lanes(const uint8_t* const* inputs, size_t blocks, uint64_t counter, bool incrementCounter,
+                   uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8])
+  {
+    alignas(64) uint32_t low[16], high[16];
+    laneCounters(counter, incrementCounter, 16, low, high);
+
+    __m512i h[8];
+    for (int i = 0; i < 8; ++i)
+      h[i] = _mm512_set1_epi32((int) IV[i]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m512i m[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m512i r0 = avx512Load(inputs, 0, offset + 4*i);
+        const __m512i r1 = avx512Load(inputs, 1, offset + 4*i);
+        const __m512i r2 = avx512Load(inputs, 2, offset + 4*i);
+        const __m512i r3 = avx512Load(inputs, 3, offset + 4*i);
+        BLAKE3_TRANSPOSE(_mm512_unpacklo_epi32, _mm512_unpackhi_epi32, _mm512_unpacklo_epi64, _mm512_unpackhi_epi64, m + i, r0, r1, r2, r3)
+      }
+
+      const uint32_t blockFlags = flags | (offset == 0 ? flagsStart : 0) | (offset == blocks * 64 - 64 ? flagsEnd : 0);
+      __m512i v[16] = { h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7],
+                        _mm512_set1_epi32((int) IV[0]), _mm512_set1_epi32((int) IV[1]), _mm512_set1_epi32((int) IV[2]), _mm512_set1_epi32((int) IV[3]),
+                        _mm512_load_si512(low), _mm512_load_si512(high), _mm512_set1_epi32(64), _mm512_set1_epi32((int) blockFlags) };
+      #define G(a, b, c, d, x, y) \
+        v[a] = _mm512_add_epi32(_mm512_add_epi32(v[a], v[b]), m[x]); v[d] = _mm512_ror_epi32(_mm512_xor_si512(v[d], v[a]), 16); \
+        v[c] = _mm512_add_epi32(v[c], v[d]); v[b] = _mm512_ror_epi32(_mm512_xor_si512(v[b], v[c]), 12); \
+        v[a] = _mm512_add_epi32(_mm512_add_epi32(v[a], v[b]), m[y]); v[d] = _mm512_ror_epi32(_mm512_xor_si512(v[d], v[a]),  8); \
+        v[c] = _mm512_add_epi32(v[c], v[d]); v[b] = _mm512_ror_epi32(_mm512_xor_si512(v[b], v[c]),  7);
+      BLAKE3_ROUNDS(G)
+      #undef G
+      for (int i = 0; i < 8; ++i)
+        h[i] = _mm512_xor_si512(v[i], v[i + 8]);
+    }
+
+    alignas(64) uint32_t lanes[8][16];
+    for (int i = 0; i < 8; ++i)
+      _mm512_store_si512(lanes[i], h[i]);
+    for (int lane = 0; lane < 16; ++lane)
+      for (int i = 0; i < 8; ++i)
+        cvs[lane][i] = lanes[i][lane];
+  }
+  #undef BLAKE3_TRANSPOSE
+#endif
+
+  struct LaneKernel
+  {
+    size_t       lanes; // inputs per call, at most 16
+    LaneFunction function;
+  };
+
+  /// widest kernel blake3_update may use, see blake3_select_lanes
+  std::atomic<size_t> MaxLanes{ 16 };
+
+  /// lane kernels supported by the running CPU, narrowest first, the portable one is always there
+  size_t supportedKernels(const LaneKernel** kernels)
+  {
+    static LaneKernel supported[4];
+    static const size_t count = []
+    {
+      size_t found = 0;
+      supported[found++] = { 1, portableLanes };
+#ifdef BLAKE3_USE_SIMD
+      if (CpuFeatures::get().sse41())
+        supported[found++] = { 4, sseLanes };
+      if (CpuFeatures::get().avx2())
+        supported[found++] = { 8, avx2Lanes };
+      if (CpuFeatures::get().avx512())
+        supported[found++] = { 16, avx512Lanes };
+#endif
+      return found;
+    }();
+    *kernels = supported;
+    return count;
+  }
+
+  /// the supported lane kernels blake3_select_lanes allows, narrowest first
+  size_t laneKernels(const LaneKernel** kernels)
+  {
+    size_t count = supportedKernels(kernels);
+    while (count > 1 && (*kernels)[count - 1].lanes > MaxLanes.load(std::memory_order_relaxed))
+      --count;
+    return count;
+  }
+
+  /// run a LaneFunction over any number of inputs, the widest kernel that fits takes the next ones
+  void hashMany(const uint8_t* const* inputs, size_t count, size_t blocks, uint64_t counter, bool incrementCounter,
+                uint32_t flags, uint32_t flagsStart, uint32_t flagsEnd, uint32_t (*cvs)[8])
+  {
+    const LaneKernel* kernels;
+    size_t kernel = laneKernels(&kernels) - 1;
+    while (count > 0)
+    {
+      while (kernels[kernel].lanes > count)
+        --kernel;
+      const size_t lanes = kernels[kernel].lanes;
+      kernels[kernel].function(inputs, blocks, counter, incrementCounter, flags, flagsStart, flagsEnd, cvs);
+      inputs  += lanes;
+      cvs     += lanes;
+      count   -= lanes;
+      if (incrementCounter)
+        counter += lanes;
+    }
+  }
+
+  /// largest subtree hashed at once by blake3_update, 2^MaxSubtreeLevel chunks
+  const uint8_t MaxSubtreeLevel = 6;
+
+  /// chaining value of 2^level whole chunks starting at chunk "counter", a multiple of 2^level.
+  /// Every level of the subtree goes through the lanes, chunks first, then the parents pair by pair
+  void hashSubtree(const uint8_t* data, uint64_t counter, uint8_t level, uint32_t cv[8])
+  {
+    const uint8_t* inputs[1 << MaxSubtreeLevel];
+    uint32_t       cvs   [1 << MaxSubtreeLevel][8];
+    size_t count = (size_t) 1 << level;
+    for (size_t i = 0; i < count; ++i)
+      inputs[i] = data + i * Blake3ChunkSize;
+    hashMany(inputs, count, Blake3ChunkSize / 64, counter, true, 0, ChunkStart, ChunkEnd, cvs);
+
+    // parent i reads cvs[2i] and cvs[2i + 1] as its block and overwrites cvs[i], which no later call reads
+    const LaneKernel* kernels;
+    const size_t numKernels  = laneKernels(&kernels);
+    const bool   parentLanes = kernels[numKernels - 1].lanes > 1;
+    while (count > 1)
+    {
+      count /= 2;
+      if (parentLanes && count >= 4)
+      {
+        for (size_t i = 0; i < count; ++i)
+          inputs[i] = (const uint8_t*) cvs[2 * i];
+        hashMany(inputs, count, 1, 0, false, Parent, 0, 0, cvs);
+      }
+      else
+      {
+        for (size_t i = 0; i < count; ++i)
+          parentCv(cvs[2 * i], cvs[2 * i + 1], 0, cvs[i]);
+      }
+    }
+    std::memcpy(cv, cvs[0], 32);
+  }
+
+  // ---------- tree ----------
+
+  /// bytes in the current chunk
+  inline size_t chunkLength(const Blake3State* state)
+  {
+    return state->blocksCompressed * 64 + state->bufferLength;
+  }
+
+  inline void startChunk(Blake3State* state, uint64_t counter)
+  {
+    std::memcpy(state->chunkCv, IV, 32);
+    state->chunkCounter     = counter;
+    state->bufferLength     = 0;
+    state->blocksCompressed = 0;
+  }
+
+  /// last compression of the current chunk: its chaining value, or with the Root flag the digest of a single chunk stream
+  void finishChunk(const Blake3State* state, uint32_t flags, uint32_t out[8])
+  {
+    uint8_t block[64] = { 0 };
+    std::memcpy(block, state->buffer, state->bufferLength);
+    uint32_t m[16];
+    loadBlock(block, m);
+    flags |= ChunkEnd | (state->blocksCompressed == 0 ? ChunkStart : 0);
+    compress(state->chunkCv, m, state->bufferLength, state->chunkCounter, flags, out);
+  }
+
+  /// add bytes to the current chunk, up to its end. A full buffer is compressed only once more data follows,
+  /// because the last block of a chunk gets the ChunkEnd flag
+  void chunkUpdate(Blake3State* state, const uint8_t* current, size_t length)
+  {
+    while (length > 0)
+    {
+      if (state->bufferLength == 64)
+      {
+        uint32_t m[16];
+        loadBlock(state->buffer, m);
+        compress(state->chunkCv, m, 64, state->chunkCounter, state->blocksCompressed == 0 ? ChunkStart : 0, state->chunkCv);
+        state->blocksCompressed++;
+        state->bufferLength = 0;
+      }
+      const size_t fill = std::min<size_t>(64 - state->bufferLength, length);
+      std::memcpy(state->buffer + state->bufferLength, current, fill);
+      state->bufferLength += (uint8_t) fill;
+      current += fill;
+      length  -= fill;
+    }
+  }
+
+  /// append a finished subtree of 2^level chunks starting at chunk "start". While it is the right half of its parent and
+  /// the left half is on top of the stack, both are replaced by the parent. More data always follows, so that is never the root
+  void pushSubtree(Blake3State* state, const uint32_t subtreeCv[8], uint8_t level, uint64_t start)
+  {
+    uint32_t cv[8];
+    std::memcpy(cv, subtreeCv, 32);
+    while (state->stackSize > 0 && state->stackLevel[state->stackSize - 1] == level)
+    {
+      const uint64_t leftStart = start - ((uint64_t) 1 << level);
+      if (((leftStart >> level) & 1) != 0)
+        break;
+      state->stackSize--;
+      parentCv(state->stackCv[state->stackSize], cv, 0, cv);
+      level++;
+      start = leftStart;
+    }
+    state->stackLevel[state->stackSize] = level;
+    std::memcpy(state->stackCv[state->stackSize], cv, 32);
+    state->stackSize++;
+  }
+}
+
+
+/// start an empty stream, or a piece beginning "offset" bytes into the stream
+void blake3_init(Blake3State* state, uint64_t offset)
+{
+  startChunk(state, offset / Blake3ChunkSize);
+  state->stackSize = 0;
+}
+
+
+/// append data to the stream
+void blake3_update(Blake3State* state, const void* data, size_t length)
+{
+  const uint8_t* current = (const uint8_t*) data;
+  while (length > 0)
+  {
+    // more data follows a full chunk, so it is finished
+    if (chunkLength(state) == Blake3ChunkSize)
+    {
+      uint32_t cv[8];
+      finishChunk(state, 0, cv);
+      pushSubtree(state, cv, 0, state->chunkCounter);
+      startChunk(state, state->chunkCounter + 1);
+    }
+
+    // whole chunks straight from the input: the largest subtree that starts here and leaves at least one byte
+    // for the current chunk
+    if (chunkLength(state) == 0 && length > Blake3ChunkSize)
+    {
+      const uint64_t wholeChunks = (length - 1) / Blake3ChunkSize;
+      uint8_t level = 0;
+      while (level < MaxSubtreeLevel && ((uint64_t) 2 << level) <= wholeChunks && (state->chunkCounter & (((uint64_t) 2 << level) - 1)) == 0)
+        ++level;
+      uint32_t cv[8];
+      hashSubtree(current, state->chunkCounter, level, cv);
+      pushSubtree(state, cv, level, state->chunkCounter);
+      startChunk(state, state->chunkCounter + ((uint64_t) 1 << level));
+      current += Blake3ChunkSize << level;
+      length  -= Blake3ChunkSize << level;
+      continue;
+    }
+
+    const size_t fill = std::min(Blake3ChunkSize - chunkLength(state), length);
+    chunkUpdate(state, current, fill);
+    current += fill;
+    length  -= fill;
+  }
+}
+
+
+/// append the piece hashed by "next", which was initialized at the offset where "state" ends
+void blake3_combine(Blake3State* state, const Blake3State* next)
+{
+  if (next->stackSize == 0 && chunkLength(next) == 0)
+    return;
+  if (state->stackSize == 0 && chunkLength(state) == 0)
+  {
+    // nothing hashed before "next", which then starts the stream
+    *state = *next;
+    return;
+  }
+
+  // the last chunk of "state" is full and "next" holds more data
+  uint32_t cv[8];
+  finishChunk(state, 0, cv);
+  uint64_t start = state->chunkCounter;
+  pushSubtree(state, cv, 0, start++);
+
+  // subtrees of "next" start at chunk boundaries of the whole stream, so they are subtrees of its tree too
+  for (size_t i = 0; i < next->stackSize; ++i)
+  {
+    pushSubtree(state, next->stackCv[i], next->stackLevel[i], start);
+    start += (uint64_t) 1 << next->stackLevel[i];
+  }
+
+  std::memcpy(state->chunkCv, next->chunkCv, 32);
+  std::memcpy(state->buffer,  next->buffer,  64);
+  state->chunkCounter     = next->chunkCounter;
+  state->bufferLength     = next->bufferLength;
+  state->blocksCompressed = next->blocksCompressed;
+}
+
+
+/// write the 32 byte digest of the stream so far, the state stays usable
+void blake3_final(const Blake3State* state, uint8_t digest[32])
+{
+  uint32_t out[8];
+  if (state->stackSize == 0)
+  {
+    finishChunk(state, Root, out);
+  }
+  else
+  {
+    // right to left: the current chunk is the right child of the subtree on top of the stack,
+    // their parent the right child of the next one and so on, the last parent is the root
+    finishChunk(state, 0, out);
+    for (size_t i = state->stackSize; i-- > 0; )
+      parentCv(state->stackCv[i], out, i == 0 ? Root : 0, out);
+  }
+
+  for (int i = 0; i < 32; ++i)
+    digest[i] = (uint8_t) (out[i / 4] >> (8 * (i % 4)));
+}
+
+
+/// chunks hashed side by side on the running CPU
+size_t blake3_lanes()
+{
+  const LaneKernel* kernels;
+  const size_t numKernels = laneKernels(&kernels);
+  return kernels[numKernels - 1].lanes;
+}
+
+
+/// limit blake3_update to kernels of at most "lanes" lanes, returns false if the running CPU has no kernel with that many
+bool blake3_select_lanes(size_t lanes)
+{
+  const LaneKernel* kernels;
+  const size_t numKernels = supportedKernels(&kernels);
+  if (std::none_of(kernels, kernels + numKernels, [lanes](const LaneKernel& kernel) { return kernel.lanes == lanes; }))
+    return false;
+  MaxLanes.store(lanes, std::memory_order_relaxed);
+  return true;
+}
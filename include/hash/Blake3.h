@@ -0,0 +1,55 @@
+// //////////////////////////////////////////////////////////
+// Blake3.h
+// BLAKE3 (hash mode, 32 byte output), incremental state over a tree of 1 KiB chunks:
+// whole chunks are hashed side by side in SIMD lanes (4 SSE4.1, 8 AVX2, 16 AVX-512, picked at runtime),
+// and the states of consecutive pieces merge with blake3_combine, so one stream can be split between threads
+// check value blake3("abc") = 6437b3ac38465133ffb63b75273a8db548c558465d79db03fd359c6cd5bd9d85
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: SIMD chunk kernels, everything else uses the portable code
+#if defined(__x86_64__) || defined(_M_X64)
+#define BLAKE3_USE_SIMD
+#endif
+
+/// bytes per chunk, the leaves of the tree. Pieces passed to blake3_combine start at a multiple of this
+const size_t Blake3ChunkSize = 1024;
+/// subtrees waiting for their right sibling, a piece starting anywhere below 2^64 bytes needs at most 2 * 54
+const size_t Blake3MaxStack  = 108;
+
+/// running BLAKE3 of one stream (or of a piece of it), set up by blake3_init
+struct Blake3State
+{
+  // chunk being filled
+  uint32_t chunkCv[8];       // chaining value of its blocks compressed so far
+  uint64_t chunkCounter;     // index of the chunk in the whole stream
+  uint8_t  buffer[64];       // its last block, compressed once more data follows
+  uint8_t  bufferLength;
+  uint8_t  blocksCompressed;
+  // finished subtrees in stream order, ending where the current chunk starts
+  uint8_t  stackSize;
+  uint8_t  stackLevel[Blake3MaxStack];    // subtree of 2^level chunks
+  uint32_t stackCv   [Blake3MaxStack][8];
+};
+
+/// start an empty stream, or a piece beginning "offset" bytes into the stream (a multiple of Blake3ChunkSize)
+void blake3_init   (Blake3State* state, uint64_t offset = 0);
+/// append data to the stream
+void blake3_update (Blake3State* state, const void* data, size_t length);
+/// append the piece hashed by "next", which was initialized at the offset where "state" ends.
+/// "state" must hold at least one byte and end on a chunk boundary
+void blake3_combine(Blake3State* state, const Blake3State* next);
+/// write the 32 byte digest of the stream so far (state initialized at offset 0), the state stays usable
+void blake3_final  (const Blake3State* state, uint8_t digest[32]);
+
+/// chunks hashed side by side on the running CPU (1, 4, 8 or 16)
+size_t blake3_lanes ();
+/// limit blake3_update to kernels of at most "lanes" lanes (1 is the portable code), e.g. to test the narrower kernels,
+/// returns false if the running CPU has no kernel with that many lanes
+bool   blake3_select_lanes(size_t lanes);
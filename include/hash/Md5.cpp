@@ -0,0 +1,342 @@
+// //////////////////////////////////////////////////////////
+// Md5.cpp
+// MD5 (RFC 1321), see Md5.h
+// the 64 steps of a block are listed once in MD5_STEPS and expanded by the scalar and by each SIMD kernel
+//
+
+#include "Md5.h"
+#include "MultiBuffer.h"
+// std::atomic
+#include <atomic>
+
+#ifdef MD5_USE_SIMD
+  #include <utils/CpuFeatures.h>
+#endif
+
+// STEP(round function, a, b, c, d, message word, rotation, constant) is
+// a = b + ((a + f(b, c, d) + word + constant) <<< rotation)
+#define MD5_STEPS(STEP) \
+  STEP(F, a, b, c, d,  0,  7, 0xd76aa478) STEP(F, d, a, b, c,  1, 12, 0xe8c7b756) STEP(F, c, d, a, b,  2, 17, 0x242070db) STEP(F, b, c, d, a,  3, 22, 0xc1bdceee) \
+  STEP(F, a, b, c, d,  4,  7, 0xf57c0faf) STEP(F, d, a, b, c,  5, 12, 0x4787c62a) STEP(F, c, d, a, b,  6, 17, 0xa8304613) STEP(F, b, c, d, a,  7, 22, 0xfd469501) \
+  STEP(F, a, b, c, d,  8,  7, 0x698098d8) STEP(F, d, a, b, c,  9, 12, 0x8b44f7af) STEP(F, c, d, a, b, 10, 17, 0xffff5bb1) STEP(F, b, c, d, a, 11, 22, 0x895cd7be) \
+  STEP(F, a, b, c, d, 12,  7, 0x6b901122) STEP(F, d, a, b, c, 13, 12, 0xfd987193) STEP(F, c, d, a, b, 14, 17, 0xa679438e) STEP(F, b, c, d, a, 15, 22, 0x49b40821) \
+  STEP(G, a, b, c, d,  1,  5, 0xf61e2562) STEP(G, d, a, b, c,  6,  9, 0xc040b340) STEP(G, c, d, a, b, 11, 14, 0x265e5a51) STEP(G, b, c, d, a,  0, 20, 0xe9b6c7aa) \
+  STEP(G, a, b, c, d,  5,  5, 0xd62f105d) STEP(G, d, a, b, c, 10,  9, 0x02441453) STEP(G, c, d, a, b, 15, 14, 0xd8a1e681) STEP(G, b, c, d, a,  4, 20, 0xe7d3fbc8) \
+  STEP(G, a, b, c, d,  9,  5, 0x21e1cde6) STEP(G, d, a, b, c, 14,  9, 0xc33707d6) STEP(G, c, d, a, b,  3, 14, 0xf4d50d87) STEP(G, b, c, d, a,  8, 20, 0x455a14ed) \
+  STEP(G, a, b, c, d, 13,  5, 0xa9e3e905) STEP(G, d, a, b, c,  2,  9, 0xfcefa3f8) STEP(G, c, d, a, b,  7, 14, 0x676f02d9) STEP(G, b, c, d, a, 12, 20, 0x8d2a4c8a) \
+  STEP(H, a, b, c, d,  5,  4, 0xfffa3942) STEP(H, d, a, b, c,  8, 11, 0x8771f681) STEP(H, c, d, a, b, 11, 16, 0x6d9d6122) STEP(H, b, c, d, a, 14, 23, 0xfde5380c) \
+  STEP(H, a, b, c, d,  1,  4, 0xa4beea44) STEP(H, d, a, b, c,  4, 11, 0x4bdecfa9) STEP(H, c, d, a, b,  7, 16, 0xf6bb4b60) STEP(H, b, c, d, a, 10, 23, 0xbebfbc70) \
+  STEP(H, a, b, c, d, 13,  4, 0x289b7ec6) STEP(H, d, a, b, c,  0, 11, 0xeaa127fa) STEP(H, c, d, a, b,  3, 16, 0xd4ef3085) STEP(H, b, c, d, a,  6, 23, 0x04881d05) \
+  STEP(H, a, b, c, d,  9,  4, 0xd9d4d039) STEP(H, d, a, b, c, 12, 11, 0xe6db99e5) STEP(H, c, d, a, b, 15, 16, 0x1fa27cf8) STEP(H, b, c, d, a,  2, 23, 0xc4ac5665) \
+  STEP(I, a, b, c, d,  0,  6, 0xf4292244) STEP(I, d, a, b, c,  7, 10, 0x432aff97) STEP(I, c, d, a, b, 14, 15, 0xab9423a7) STEP(I, b, c, d, a,  5, 21, 0xfc93a039) \
+  STEP(I, a, b, c, d, 12,  6, 0x655b59c3) STEP(I, d, a, b, c,  3, 10, 0x8f0ccc92) STEP(I, c, d, a, b, 10, 15, 0xffeff47d) STEP(I, b, c, d, a,  1, 21, 0x85845dd1) \
+  STEP(I, a, b, c, d,  8,  6, 0x6fa87e4f) STEP(I, d, a, b, c, 15, 10, 0xfe2ce6e0) STEP(I, c, d, a, b,  6, 15, 0xa3014314) STEP(I, b, c, d, a, 13, 21, 0x4e0811a1) \
+  STEP(I, a, b, c, d,  4,  6, 0xf7537e82) STEP(I, d, a, b, c, 11, 10, 0xbd3af235) STEP(I, c, d, a, b,  2, 15, 0x2ad7d2bb) STEP(I, b, c, d, a,  9, 21, 0xeb86d391)
+
+namespace
+{
+  /// process full 64 byte blocks of one stream
+  void compress(uint32_t hash[4], const uint8_t* current, size_t blocks)
+  {
+    for (; blocks > 0; --blocks, current += 64)
+    {
+      // little endian words, compilers turn this into plain loads on x86
+      uint32_t w[16];
+      for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t) current[4*i] | (uint32_t) current[4*i + 1] << 8 | (uint32_t) current[4*i + 2] << 16 | (uint32_t) current[4*i + 3] << 24;
+
+      uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3];
+      #define F(x, y, z) ((((y) ^ (z)) & (x)) ^ (z))
+      #define G(x, y, z) ((((x) ^ (y)) & (z)) ^ (y))
+      #define H(x, y, z) ((x) ^ (y) ^ (z))
+      #define I(x, y, z) ((y) ^ ((x) | ~(z)))
+      #define STEP(f, a, b, c, d, k, s, t) \
+        a += f(b, c, d) + w[k] + t; \
+        a  = b + ((a << s) | (a >> (32 - s)));
+      MD5_STEPS(STEP)
+      #undef STEP
+      #undef I
+      #undef H
+      #undef G
+      #undef F
+      hash[0] += a; hash[1] += b; hash[2] += c; hash[3] += d;
+    }
+  }
+
+#ifdef MD5_USE_SIMD
+  // ---------- SSE2, 4 lanes ----------
+
+  inline __m128i sseF(__m128i x, __m128i y, __m128i z) { return _mm_xor_si128(_mm_and_si128(_mm_xor_si128(y, z), x), z); }
+  inline __m128i sseG(__m128i x, __m128i y, __m128i z) { return _mm_xor_si128(_mm_and_si128(_mm_xor_si128(x, y), z), y); }
+  inline __m128i sseH(__m128i x, __m128i y, __m128i z) { return _mm_xor_si128(_mm_xor_si128(x, y), z); }
+  inline __m128i sseI(__m128i x, __m128i y, __m128i z) { return _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, _mm_set1_epi32(-1)))); }
+
+  /// 16 bytes of four lanes, r0..r3 hold lane 0..3, afterwards word i of every lane
+  #define MD5_TRANSPOSE(unpacklo32, unpackhi32, unpacklo64, unpackhi64, w, r0, r1, r2, r3) \
+  { \
+    const auto t0 = unpacklo32(r0, r1), t1 = unpacklo32(r2, r3); \
+    const auto t2 = unpackhi32(r0, r1), t3 = unpackhi32(r2, r3); \
+    (w)[0] = unpacklo64(t0, t1); (w)[1] = unpackhi64(t0, t1); \
+    (w)[2] = unpacklo64(t2, t3); (w)[3] = unpackhi64(t2, t3); \
+  }
+
+  void sseLanes(uint32_t* const* hash, const uint8_t* const* data, size_t blocks)
+  {
+    __m128i a = _mm_set_epi32((int) hash[3][0], (int) hash[2][0], (int) hash[1][0], (int) hash[0][0]);
+    __m128i b = _mm_set_epi32((int) hash[3][1], (int) hash[2][1], (int) hash[1][1], (int) hash[0][1]);
+    __m128i c = _mm_set_epi32((int) hash[3][2], (int) hash[2][2], (int) hash[1][2], (int) hash[0][2]);
+    __m128i d = _mm_set_epi32((int) hash[3][3], (int) hash[2][3], (int) hash[1][3], (int) hash[0][3]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m128i w[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m128i r0 = _mm_loadu_si128((const __m128i*) (data[0] + offset + 4*i));
+        const __m128i r1 = _mm_loadu_si128((const __m128i*) (data[1] + offset + 4*i));
+        const __m128i r2 = _mm_loadu_si128((const __m128i*) (data[2] + offset + 4*i));
+        const __m128i r3 = _mm_loadu_si128((const __m128i*) (data[3] + offset + 4*i));
+        MD5_TRANSPOSE(_mm_unpacklo_epi32, _mm_unpackhi_epi32, _mm_unpacklo_epi64, _mm_unpackhi_epi64, w + i, r0, r1, r2, r3)
+      }
+
+      const __m128i a0 = a, b0 = b, c0 = c, d0 = d;
+      #define STEP(f, a, b, c, d, k, s, t) \
+        a = _mm_add_epi32(_mm_add_epi32(a, sse##f(b, c, d)), _mm_add_epi32(w[k], _mm_set1_epi32((int) t))); \
+        a = _mm_add_epi32(b, _mm_or_si128(_mm_slli_epi32(a, s), _mm_srli_epi32(a, 32 - s)));
+      MD5_STEPS(STEP)
+      #undef STEP
+      a = _mm_add_epi32(a, a0); b = _mm_add_epi32(b, b0); c = _mm_add_epi32(c, c0); d = _mm_add_epi32(d, d0);
+    }
+
+    alignas(16) uint32_t lanes[4][4];
+    _mm_store_si128((__m128i*) lanes[0], a);
+    _mm_store_si128((__m128i*) lanes[1], b);
+    _mm_store_si128((__m128i*) lanes[2], c);
+    _mm_store_si128((__m128i*) lanes[3], d);
+    for (int lane = 0; lane < 4; ++lane)
+      for (int i = 0; i < 4; ++i)
+        hash[lane][i] = lanes[i][lane];
+  }
+
+  // ---------- AVX2, 8 lanes: the low 128 bits hold lanes 0..3, the high 128 bits lanes 4..7 ----------
+
+  SFV_TARGET("avx2") inline __m256i avx2F(__m256i x, __m256i y, __m256i z) { return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(y, z), x), z); }
+  SFV_TARGET("avx2") inline __m256i avx2G(__m256i x, __m256i y, __m256i z) { return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(x, y), z), y); }
+  SFV_TARGET("avx2") inline __m256i avx2H(__m256i x, __m256i y, __m256i z) { return _mm256_xor_si256(_mm256_xor_si256(x, y), z); }
+  SFV_TARGET("avx2") inline __m256i avx2I(__m256i x, __m256i y, __m256i z) { return _mm256_xor_si256(y, _mm256_or_si256(x, _mm256_xor_si256(z, _mm256_set1_epi32(-1)))); }
+
+  SFV_TARGET("avx2") inline __m256i avx2Load(const uint8_t* low, const uint8_t* high)
+  {
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*) low)), _mm_loadu_si128((const __m128i*) high), 1);
+  }
+
+  SFV_TARGET("avx2")
+  void avx2Lanes(uint32_t* const* hash, const uint8_t* const* data, size_t blocks)
+  {
+    alignas(32) uint32_t lanes[4][8];
+    for (int lane = 0; lane < 8; ++lane)
+      for (int i = 0; i < 4; ++i)
+        lanes[i][lane] = hash[lane][i];
+    __m256i a = _mm256_load_si256((const __m256i*) lanes[0]);
+    __m256i b = _mm256_load_si256((const __m256i*) lanes[1]);
+    __m256i c = _mm256_load_si256((const __m256i*) lanes[2]);
+    __m256i d = _mm256_load_si256((const __m256i*) lanes[3]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m256i w[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m256i r0 = avx2Load(data[0] + offset + 4*i, data[4] + offset + 4*i);
+        const __m256i r1 = avx2Load(data[1] + offset + 4*i, data[5] + offset + 4*i);
+        const __m256i r2 = avx2Load(data[2] + offset + 4*i, data[6] + offset + 4*i);
+        const __m256i r3 = avx2Load(data[3] + offset + 4*i, data[7] + offset + 4*i);
+        MD5_TRANSPOSE(_mm256_unpacklo_epi32, _mm256_unpackhi_epi32, _mm256_unpacklo_epi64, _mm256_unpackhi_epi64, w + i, r0, r1, r2, r3)
+      }
+
+      const __m256i a0 = a, b0 = b, c0 = c, d0 = d;
+      #define STEP(f, a, b, c, d, k, s, t) \
+        a = _mm256_add_epi32(_mm256_add_epi32(a, avx2##f(b, c, d)), _mm256_add_epi32(w[k], _mm256_set1_epi32((int) t))); \
+        a = _mm256_add_epi32(b, _mm256_or_si256(_mm256_slli_epi32(a, s), _mm256_srli_epi32(a, 32 - s)));
+      MD5_STEPS(STEP)
+      #undef STEP
+      a = _mm256_add_epi32(a, a0); b = _mm256_add_epi32(b, b0); c = _mm256_add_epi32(c, c0); d = _mm256_add_epi32(d, d0);
+    }
+
+    _mm256_store_si256((__m256i*) lanes[0], a);
+    _mm256_store_si256((__m256i*) lanes[1], b);
+    _mm256_store_si256((__m256i*) lanes[2], c);
+    _mm256_store_si256((__m256i*) lanes[3], d);
+    for (int lane = 0; lane < 8; ++lane)
+      for (int i = 0; i < 4; ++i)
+        hash[lane][i] = lanes[i][lane];
+  }
+
+  // ---------- AVX-512, 16 lanes: 128 bit part j holds lanes 4j..4j+3, rotations and round functions are single instructions ----------
+
+  #define avx512F(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0xca) // x ? y : z
+  #define avx512G(x, y, z) _mm512_ternarylogic_epi32(z, x, y, 0xca) // z ? x : y
+  #define avx512H(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x96) // x ^ y ^ z
+  #define avx512I(x, y, z) _mm512_ternarylogic_epi32(x, y, z, 0x39) // y ^ (x | ~z)
+
+  SFV_TARGET("avx512f") inline __m512i avx512Load(const uint8_t* const* data, size_t lane, size_t offset)
+  {
+    __m512i value = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i*) (data[lane] + offset)));
+    value = _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (data[lane +  4] + offset)), 1);
+    value = _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (data[lane +  8] + offset)), 2);
+    return  _mm512_inserti32x4(value, _mm_loadu_si128((const __m128i*) (data[lane + 12] + offset)), 3);
+  }
+
+  SFV_TARGET("avx512f")
+  void avx512Lanes(uint32_t* const* hash, const uint8_t* const* data, size_t blocks)
+  {
+    alignas(64) uint32_t lanes[4][16];
+    for (int lane = 0; lane < 16; ++lane)
+      for (int i = 0; i < 4; ++i)
+        lanes[i][lane] = hash[lane][i];
+    __m512i a = _mm512_load_si512(lanes[0]);
+    __m512i b = _mm512_load_si512(lanes[1]);
+    __m512i c = _mm512_load_si512(lanes[2]);
+    __m512i d = _mm512_load_si512(lanes[3]);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      __m512i w[16];
+      for (size_t i = 0; i < 16; i += 4)
+      {
+        const __m512i r0 = avx512Load(data, 0, offset + 4*i);
+        const __m512i r1 = avx512Load(data, 1, offset + 4*i);
+        const __m512i r2 = avx512Load(data, 2, offset + 4*i);
+        const __m512i r3 = avx512Load(data, 3, offset + 4*i);
+        MD5_TRANSPOSE(_mm512_unpacklo_epi32, _mm512_unpackhi_epi32, _mm512_unpacklo_epi64, _mm512_unpackhi_epi64, w + i, r0, r1, r2, r3)
+      }
+
+      const __m512i a0 = a, b0 = b, c0 = c, d0 = d;
+      #define STEP(f, a, b, c, d, k, s, t) \
+        a = _mm512_add_epi32(_mm512_add_epi32(a, avx512##f(b, c, d)), _mm512_add_epi32(w[k], _mm512_set1_epi32((int) t))); \
+        a = _mm512_add_epi32(b, _mm512_rol_epi32(a, s));
+      MD5_STEPS(STEP)
+      #undef STEP
+      a = _mm512_add_epi32(a, a0); b = _mm512_add_epi32(b, b0); c = _mm512_add_epi32(c, c0); d = _mm512_add_epi32(d, d0);
+    }
+
+    _mm512_store_si512(lanes[0], a);
+    _mm512_store_si512(lanes[1], b);
+    _mm512_store_si512(lanes[2], c);
+    _mm512_store_si512(lanes[3], d);
+    for (int lane = 0; lane < 16; ++lane)
+      for (int i = 0; i < 4; ++i)
+        hash[lane][i] = lanes[i][lane];
+  }
+  #undef avx512I
+  #undef avx512H
+  #undef avx512G
+  #undef avx512F
+  #undef MD5_TRANSPOSE
+#endif
+
+  using multibuffer::LaneKernel;
+
+  /// widest kernel md5_multi may use, see md5_select_lanes
+  std::atomic<size_t> MaxLanes{ 16 };
+
+  /// lane kernels supported by the running CPU, narrowest first
+  size_t supportedKernels(const LaneKernel** kernels)
+  {
+    static LaneKernel supported[3];
+    static const size_t count = []
+    {
+      size_t found = 0;
+#ifdef MD5_USE_SIMD
+      supported[found++] = { 4, sseLanes };
+      if (CpuFeatures::get().avx2())
+        supported[found++] = { 8, avx2Lanes };
+      if (CpuFeatures::get().avx512())
+        supported[found++] = { 16, avx512Lanes };
+#endif
+      return found;
+    }();
+    *kernels = supported;
+    return count;
+  }
+
+  /// the supported lane kernels md5_select_lanes allows, narrowest first
+  size_t laneKernels(const LaneKernel** kernels)
+  {
+    size_t count = supportedKernels(kernels);
+    while (count > 0 && (*kernels)[count - 1].lanes > MaxLanes.load(std::memory_order_relaxed))
+      --count;
+    return count;
+  }
+}
+
+
+/// start an empty stream
+void md5_init(Md5State* state)
+{
+  state->hash[0] = 0x67452301;
+  state->hash[1] = 0xefcdab89;
+  state->hash[2] = 0x98badcfe;
+  state->hash[3] = 0x10325476;
+  state->length  = 0;
+}
+
+
+/// append data to the stream
+void md5_update(Md5State* state, const void* data, size_t length)
+{
+  multibuffer::update(state, data, length, compress);
+}
+
+
+/// write the 16 byte digest of the stream so far, the state stays usable
+void md5_final(const Md5State* state, uint8_t digest[16])
+{
+  Md5State last = *state;
+
+  // 0x80, zeros up to 56 bytes mod 64, then the length in bits (little endian)
+  uint8_t padding[64] = { 0x80 };
+  const size_t used = last.length % 64;
+  const uint64_t bits = last.length * 8;
+  md5_update(&last, padding, (used < 56 ? 56 : 120) - used);
+  uint8_t length[8];
+  for (int i = 0; i < 8; ++i)
+    length[i] = (uint8_t) (bits >> (8 * i));
+  md5_update(&last, length, sizeof(length));
+
+  for (int i = 0; i < 16; ++i)
+    digest[i] = (uint8_t) (last.hash[i / 4] >> (8 * (i % 4)));
+}
+
+
+/// append data[i] to states[i] for several independent streams at once
+void md5_multi(Md5State* const* states, const void* const* data, const size_t* lengths, size_t count)
+{
+  const LaneKernel* kernels;
+  const size_t numKernels = laneKernels(&kernels);
+  multibuffer::multiUpdate(states, data, lengths, count, kernels, numKernels, compress);
+}
+
+
+/// streams hashed side by side by md5_multi on the running CPU
+size_t md5_lanes()
+{
+  const LaneKernel* kernels;
+  const size_t numKernels = laneKernels(&kernels);
+  return numKernels == 0 ? 1 : kernels[numKernels - 1].lanes;
+}
+
+
+/// limit md5_multi to kernels of at most "lanes" lanes, returns false if the running CPU has no kernel with that many
+bool md5_select_lanes(size_t lanes)
+{
+  if (lanes != 1)
+  {
+    const LaneKernel* kernels;
+    const size_t numKernels = supportedKernels(&kernels);
+    if (std::none_of(kernels, kernels + numKernels, [lanes](const LaneKernel& kernel) { return kernel.lanes == lanes; }))
+      return false;
+  }
+  MaxLanes.store(lanes, std::memory_order_relaxed);
+  return true;
+}
@@ -0,0 +1,44 @@
+// //////////////////////////////////////////////////////////
+// Md5.h
+// MD5 (RFC 1321), incremental state plus a multi-buffer engine:
+// MD5 is serial within a stream, so md5_multi runs one stream per SIMD lane instead
+// (4 lanes SSE2, 8 lanes AVX2, 16 lanes AVX-512, picked at runtime)
+// check value md5("abc") = 900150983cd24fb0d6963f7d28e17f72
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: SIMD lanes for md5_multi, everything else uses the portable code
+#if defined(__x86_64__) || defined(_M_X64)
+#define MD5_USE_SIMD
+#endif
+
+/// running MD5 of one stream, set up by md5_init
+struct Md5State
+{
+  uint32_t hash[4];
+  uint64_t length;     // bytes so far
+  uint8_t  buffer[64]; // the last length % 64 bytes, waiting for a full block
+};
+
+/// start an empty stream
+void   md5_init  (Md5State* state);
+/// append data to the stream
+void   md5_update(Md5State* state, const void* data, size_t length);
+/// write the 16 byte digest of the stream so far, the state stays usable
+void   md5_final (const Md5State* state, uint8_t digest[16]);
+
+/// append data[i] to states[i] for several independent streams at once, every lane of the widest
+/// supported kernel gets a stream and finished lanes are refilled with the next one
+void   md5_multi (Md5State* const* states, const void* const* data, const size_t* lengths, size_t count);
+
+/// streams hashed side by side by md5_multi on the running CPU (1, 4, 8 or 16)
+size_t md5_lanes ();
+/// limit md5_multi to kernels of at most "lanes" lanes (1 hashes one stream at a time), e.g. to test the narrower kernels,
+/// returns false if the running CPU has no kernel with that many lanes
+bool   md5_select_lanes(size_t lanes);
@@ -0,0 +1,164 @@
+// //////////////////////////////////////////////////////////
+// MultiBuffer.h
+// shared by the Merkle-Damgard hashes with 64 byte blocks (MD5, SHA-256):
+// block buffering of one stream, and the lane scheduler of their *_multi functions which
+// gives every SIMD lane the blocks of a different stream and refills lanes as streams finish
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+#include <algorithm>
+#include <cstring>
+
+namespace multibuffer
+{
+  /// hash full 64 byte blocks of one stream into its chaining value
+  typedef void (*CompressFunction)(uint32_t* hash, const uint8_t* data, size_t blocks);
+  /// hash "blocks" full blocks of one stream per lane, hash[lane] is that stream's chaining value
+  typedef void (*LaneFunction)(uint32_t* const* hash, const uint8_t* const* data, size_t blocks);
+
+  struct LaneKernel
+  {
+    size_t       lanes; // at most 16
+    LaneFunction function;
+  };
+
+  /// the full blocks of one stream
+  struct Job
+  {
+    uint32_t*      hash;
+    const uint8_t* current;
+    size_t         blocks;
+  };
+
+  /// run all jobs, kernels are sorted by lanes (narrowest first). Lanes of the widest kernel are refilled
+  /// as soon as their job is done, once fewer jobs are left a narrower kernel takes over
+  inline void runJobs(Job* jobs, size_t count, const LaneKernel* kernels, size_t numKernels, CompressFunction compress)
+  {
+    const size_t maxLanes = numKernels == 0 ? 1 : kernels[numKernels - 1].lanes;
+
+    Job*   active[16];
+    size_t numActive = 0;
+    size_t next = 0;
+    while (true)
+    {
+      while (numActive < maxLanes && next < count)
+        active[numActive++] = &jobs[next++];
+      if (numActive == 0)
+        break;
+
+      // a single stream gains nothing from lanes
+      if (numActive == 1)
+      {
+        compress(active[0]->hash, active[0]->current, active[0]->blocks);
+        numActive = 0;
+        continue;
+      }
+
+      // narrowest kernel with enough lanes, unused lanes hash lane 0's data into a scratch state
+      size_t kernel = 0;
+      while (kernels[kernel].lanes < numActive)
+        ++kernel;
+      size_t steps = active[0]->blocks;
+      for (size_t lane = 1; lane < numActive; ++lane)
+        steps = std::min(steps, active[lane]->blocks);
+
+      uint32_t       scratch[16][16];
+      uint32_t*      hash[16];
+      const uint8_t* data[16];
+      for (size_t lane = 0; lane < kernels[kernel].lanes; ++lane)
+      {
+        hash[lane] = lane < numActive ? active[lane]->hash    : scratch[lane];
+        data[lane] = lane < numActive ? active[lane]->current : active[0]->current;
+      }
+      kernels[kernel].function(hash, data, steps);
+
+      // drop finished jobs, the others keep their lane
+      size_t kept = 0;
+      for (size_t lane = 0; lane < numActive; ++lane)
+      {
+        active[lane]->current += steps * 64;
+        active[lane]->blocks  -= steps;
+        if (active[lane]->blocks != 0)
+          active[kept++] = active[lane];
+      }
+      numActive = kept;
+    }
+  }
+
+  /// append data to one stream, State has hash, length (bytes so far) and a 64 byte buffer
+  template <typename State>
+  void update(State* state, const void* data, size_t length, CompressFunction compress)
+  {
+    const uint8_t* current = (const uint8_t*) data;
+    const size_t   used    = state->length % 64;
+    state->length += length;
+
+    // complete the buffered block first
+    if (used != 0)
+    {
+      const size_t fill = std::min(64 - used, length);
+      std::memcpy(state->buffer + used, current, fill);
+      current += fill;
+      length  -= fill;
+      if (used + fill < 64)
+        return;
+      compress(state->hash, state->buffer, 1);
+    }
+
+    compress(state->hash, current, length / 64);
+    if (length % 64 != 0)
+      std::memcpy(state->buffer, current + (length & ~(size_t) 63), length % 64);
+  }
+
+  /// append data[i] to states[i], the full blocks of all streams go through runJobs
+  template <typename State>
+  void multiUpdate(State* const* states, const void* const* data, const size_t* lengths, size_t count,
+                   const LaneKernel* kernels, size_t numKernels, CompressFunction compress)
+  {
+    // jobs live on the stack, larger batches are split
+    const size_t MaxJobs = 64;
+    for (size_t first = 0; first < count; first += MaxJobs)
+    {
+      const size_t numStreams = std::min(MaxJobs, count - first);
+      Job            jobs[MaxJobs];
+      const uint8_t* tails[MaxJobs];
+      size_t         tailLengths[MaxJobs];
+      size_t         numJobs = 0;
+
+      for (size_t i = 0; i < numStreams; ++i)
+      {
+        State*         state   = states[first + i];
+        const uint8_t* current = (const uint8_t*) data[first + i];
+        size_t         length  = lengths[first + i];
+
+        // finish a partially filled block the single stream way, then the lanes only see whole blocks
+        const size_t used = state->length % 64;
+        if (used != 0)
+        {
+          const size_t fill = std::min(64 - used, length);
+          update(state, current, fill, compress);
+          current += fill;
+          length  -= fill;
+        }
+
+        const size_t blocks = length / 64;
+        if (blocks != 0)
+          jobs[numJobs++] = { state->hash, current, blocks };
+        state->length  += blocks * 64;
+        tails[i]       = current + blocks * 64;
+        tailLengths[i] = length % 64;
+      }
+
+      runJobs(jobs, numJobs, kernels, numKernels, compress);
+
+      // the rest is less than a block, it is only buffered
+      for (size_t i = 0; i < numStreams; ++i)
+        update(states[first + i], tails[i], tailLengths[i], compress);
+    }
+  }
+}
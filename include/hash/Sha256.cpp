@@ -0,0 +1,278 @@
+// //////////////////////////////////////////////////////////
+// Sha256.cpp
+// SHA-256 (FIPS 180-4), see Sha256.h
+//
+
+#include "Sha256.h"
+#include "MultiBuffer.h"
+// std::atomic
+#include <atomic>
+// strcmp
+#include <cstring>
+
+#ifdef SHA256_USE_SHANI
+  #include <utils/CpuFeatures.h>
+#endif
+
+namespace
+{
+  /// round constants, first 32 bits of the fractional parts of the cube roots of the first 64 primes
+  alignas(16) const uint32_t K[64] =
+  {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+  };
+
+  inline uint32_t rotateRight(uint32_t x, int s) { return (x >> s) | (x << (32 - s)); }
+
+  /// process full 64 byte blocks of one stream, portable
+  void compressPortable(uint32_t* hash, const uint8_t* current, size_t blocks)
+  {
+    for (; blocks > 0; --blocks, current += 64)
+    {
+      // big endian words
+      uint32_t w[16];
+      for (int i = 0; i < 16; ++i)
+        w[i] = (uint32_t) current[4*i] << 24 | (uint32_t) current[4*i + 1] << 16 | (uint32_t) current[4*i + 2] << 8 | (uint32_t) current[4*i + 3];
+
+      uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3];
+      uint32_t e = hash[4], f = hash[5], g = hash[6], h = hash[7];
+
+      // renaming the variables instead of moving them around, rounds from 16 on extend the schedule in place
+      #define ROUND(a, b, c, d, e, f, g, h, i) \
+      { \
+        if ((i) >= 16) \
+        { \
+          const uint32_t w15 = w[((i) - 15) & 15], w2 = w[((i) - 2) & 15]; \
+          w[(i) & 15] += (rotateRight(w15, 7) ^ rotateRight(w15, 18) ^ (w15 >> 3)) + w[((i) - 7) & 15] + \
+                         (rotateRight(w2, 17) ^ rotateRight(w2, 19) ^ (w2 >> 10)); \
+        } \
+        const uint32_t t1 = h + (rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25)) + (((f ^ g) & e) ^ g) + K[i] + w[(i) & 15]; \
+        const uint32_t t2 = (rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22)) + ((a & b) | (c & (a | b))); \
+        d += t1; \
+        h  = t1 + t2; \
+      }
+      for (int i = 0; i < 64; i += 8)
+      {
+        ROUND(a, b, c, d, e, f, g, h, i    )
+        ROUND(h, a, b, c, d, e, f, g, i + 1)
+        ROUND(g, h, a, b, c, d, e, f, i + 2)
+        ROUND(f, g, h, a, b, c, d, e, i + 3)
+        ROUND(e, f, g, h, a, b, c, d, i + 4)
+        ROUND(d, e, f, g, h, a, b, c, i + 5)
+        ROUND(c, d, e, f, g, h, a, b, i + 6)
+        ROUND(b, c, d, e, f, g, h, a, i + 7)
+      }
+      #undef ROUND
+
+      hash[0] += a; hash[1] += b; hash[2] += c; hash[3] += d;
+      hash[4] += e; hash[5] += f; hash[6] += g; hash[7] += h;
+    }
+  }
+
+#ifdef SHA256_USE_SHANI
+  // SHA-NI keeps the state as two registers, ABEF and CDGH
+
+  SFV_TARGET("sse4.1")
+  inline void shaniLoad(const uint32_t* hash, __m128i& abef, __m128i& cdgh)
+  {
+    const __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) hash), 0xB1);
+    const __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*) (hash + 4)), 0x1B);
+    abef = _mm_alignr_epi8(cdab, efgh, 8);
+    cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+  }
+
+  SFV_TARGET("sse4.1")
+  inline void shaniStore(uint32_t* hash, __m128i abef, __m128i cdgh)
+  {
+    const __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    const __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*) hash,       _mm_blend_epi16(feba, dchg, 0xF0)); // DCBA
+    _mm_storeu_si128((__m128i*) (hash + 4), _mm_alignr_epi8(dchg, feba, 8));    // HGFE
+  }
+
+  // four rounds with message words m[j], each SHA256RNDS2 does two
+  #define SHANI_ROUNDS(abef, cdgh, m, j) \
+  { \
+    const __m128i wk = _mm_add_epi32(m[j], _mm_load_si128((const __m128i*) (K + 4 * (j)))); \
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk); \
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E)); \
+  }
+  // message words 4j..4j+3 from the previous 16
+  #define SHANI_SCHEDULE(m, j) \
+    m[j] = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m[(j) - 4], m[(j) - 3]), _mm_alignr_epi8(m[(j) - 1], m[(j) - 2], 4)), m[(j) - 1]);
+  // the 64 rounds of a block, ROUNDS(j) runs rounds 4j..4j+3 once m[j] is known
+  #define SHANI_BLOCK(LOAD, SCHEDULE, ROUNDS) \
+    LOAD(0) LOAD(1) LOAD(2) LOAD(3) \
+    ROUNDS(0) ROUNDS(1) ROUNDS(2) ROUNDS(3) \
+    SCHEDULE(4)  ROUNDS(4)  SCHEDULE(5)  ROUNDS(5)  SCHEDULE(6)  ROUNDS(6)  SCHEDULE(7)  ROUNDS(7) \
+    SCHEDULE(8)  ROUNDS(8)  SCHEDULE(9)  ROUNDS(9)  SCHEDULE(10) ROUNDS(10) SCHEDULE(11) ROUNDS(11) \
+    SCHEDULE(12) ROUNDS(12) SCHEDULE(13) ROUNDS(13) SCHEDULE(14) ROUNDS(14) SCHEDULE(15) ROUNDS(15)
+
+  /// process full 64 byte blocks of one stream, requires SHA-NI
+  SFV_TARGET("sha,sse4.1")
+  void compressShani(uint32_t* hash, const uint8_t* current, size_t blocks)
+  {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef, cdgh;
+    shaniLoad(hash, abef, cdgh);
+
+    for (; blocks > 0; --blocks, current += 64)
+    {
+      const __m128i abefSaved = abef, cdghSaved = cdgh;
+      __m128i m[16];
+      #define LOAD(j)     m[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (current + 16 * (j))), byteSwap);
+      #define SCHEDULE(j) SHANI_SCHEDULE(m, j)
+      #define ROUNDS(j)   SHANI_ROUNDS(abef, cdgh, m, j)
+      SHANI_BLOCK(LOAD, SCHEDULE, ROUNDS)
+      #undef ROUNDS
+      #undef SCHEDULE
+      #undef LOAD
+      abef = _mm_add_epi32(abef, abefSaved);
+      cdgh = _mm_add_epi32(cdgh, cdghSaved);
+    }
+
+    shaniStore(hash, abef, cdgh);
+  }
+
+  /// two streams in lockstep, requires SHA-NI
+  SFV_TARGET("sha,sse4.1")
+  void shaniLanes(uint32_t* const* hash, const uint8_t* const* data, size_t blocks)
+  {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i abef0, cdgh0, abef1, cdgh1;
+    shaniLoad(hash[0], abef0, cdgh0);
+    shaniLoad(hash[1], abef1, cdgh1);
+
+    for (size_t offset = 0; offset < blocks * 64; offset += 64)
+    {
+      const __m128i abefSaved0 = abef0, cdghSaved0 = cdgh0, abefSaved1 = abef1, cdghSaved1 = cdgh1;
+      __m128i m0[16], m1[16];
+      #define LOAD(j) \
+        m0[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data[0] + offset + 16 * (j))), byteSwap); \
+        m1[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*) (data[1] + offset + 16 * (j))), byteSwap);
+      #define SCHEDULE(j) SHANI_SCHEDULE(m0, j) SHANI_SCHEDULE(m1, j)
+      #define ROUNDS(j)   SHANI_ROUNDS(abef0, cdgh0, m0, j) SHANI_ROUNDS(abef1, cdgh1, m1, j)
+      SHANI_BLOCK(LOAD, SCHEDULE, ROUNDS)
+      #undef ROUNDS
+      #undef SCHEDULE
+      #undef LOAD
+      abef0 = _mm_add_epi32(abef0, abefSaved0); cdgh0 = _mm_add_epi32(cdgh0, cdghSaved0);
+      abef1 = _mm_add_epi32(abef1, abefSaved1); cdgh1 = _mm_add_epi32(cdgh1, cdghSaved1);
+    }
+
+    shaniStore(hash[0], abef0, cdgh0);
+    shaniStore(hash[1], abef1, cdgh1);
+  }
+  #undef SHANI_BLOCK
+  #undef SHANI_SCHEDULE
+  #undef SHANI_ROUNDS
+#endif
+
+  using multibuffer::LaneKernel;
+
+  /// set by sha256_select_kernel("portable")
+  std::atomic<bool> ForcePortable{ false };
+
+  /// single stream kernel for the running CPU
+  multibuffer::CompressFunction compressFunction()
+  {
+#ifdef SHA256_USE_SHANI
+    static const multibuffer::CompressFunction function = CpuFeatures::get().sha() ? compressShani : compressPortable;
+    return ForcePortable.load(std::memory_order_relaxed) ? compressPortable : function;
+#else
+    return compressPortable;
+#endif
+  }
+
+  /// lane kernels supported by the running CPU, narrowest first
+  size_t laneKernels(const LaneKernel** kernels)
+  {
+#ifdef SHA256_USE_SHANI
+    static const LaneKernel shani[1] = { { 2, shaniLanes } };
+    *kernels = shani;
+    return CpuFeatures::get().sha() && !ForcePortable.load(std::memory_order_relaxed) ? 1 : 0;
+#else
+    *kernels = nullptr;
+    return 0;
+#endif
+  }
+}
+
+
+/// start an empty stream
+void sha256_init(Sha256State* state)
+{
+  const uint32_t initial[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+  for (int i = 0; i < 8; ++i)
+    state->hash[i] = initial[i];
+  state->length = 0;
+}
+
+
+/// append data to the stream
+void sha256_update(Sha256State* state, const void* data, size_t length)
+{
+  multibuffer::update(state, data, length, compressFunction());
+}
+
+
+/// write the 32 byte digest of the stream so far, the state stays usable
+void sha256_final(const Sha256State* state, uint8_t digest[32])
+{
+  Sha256State last = *state;
+
+  // 0x80, zeros up to 56 bytes mod 64, then the length in bits (big endian)
+  uint8_t padding[64] = { 0x80 };
+  const size_t used = last.length % 64;
+  const uint64_t bits = last.length * 8;
+  sha256_update(&last, padding, (used < 56 ? 56 : 120) - used);
+  uint8_t length[8];
+  for (int i = 0; i < 8; ++i)
+    length[i] = (uint8_t) (bits >> (56 - 8 * i));
+  sha256_update(&last, length, sizeof(length));
+
+  for (int i = 0; i < 32; ++i)
+    digest[i] = (uint8_t) (last.hash[i / 4] >> (24 - 8 * (i % 4)));
+}
+
+
+/// append data[i] to states[i] for several independent streams at once
+void sha256_multi(Sha256State* const* states, const void* const* data, const size_t* lengths, size_t count)
+{
+  const LaneKernel* kernels;
+  const size_t numKernels = laneKernels(&kernels);
+  multibuffer::multiUpdate(states, data, lengths, count, kernels, numKernels, compressFunction());
+}
+
+
+/// name of the kernel used on the running CPU
+const char* sha256_kernel()
+{
+  return compressFunction() == compressPortable ? "portable" : "shani";
+}
+
+
+/// choose the kernel by name, returns false if the name is unknown or the CPU doesn't support it
+bool sha256_select_kernel(const char* name)
+{
+  if (strcmp(name, "portable") == 0)
+  {
+    ForcePortable.store(true, std::memory_order_relaxed);
+    return true;
+  }
+#ifdef SHA256_USE_SHANI
+  if (strcmp(name, "shani") == 0 && CpuFeatures::get().sha())
+  {
+    ForcePortable.store(false, std::memory_order_relaxed);
+    return true;
+  }
+#endif
+  return false;
+}
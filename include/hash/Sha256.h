@@ -0,0 +1,44 @@
+// //////////////////////////////////////////////////////////
+// Sha256.h
+// SHA-256 (FIPS 180-4), incremental state with the same interface as Md5.h
+// uses the SHA-NI instructions if the CPU has them, else an unrolled portable implementation
+// check value sha256("abc") = ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: SHA-NI kernel, picked at runtime if the CPU supports it
+#if defined(__x86_64__) || defined(_M_X64)
+#define SHA256_USE_SHANI
+#endif
+
+/// running SHA-256 of one stream, set up by sha256_init
+struct Sha256State
+{
+  uint32_t hash[8];
+  uint64_t length;     // bytes so far
+  uint8_t  buffer[64]; // the last length % 64 bytes, waiting for a full block
+};
+
+/// start an empty stream
+void sha256_init  (Sha256State* state);
+/// append data to the stream
+void sha256_update(Sha256State* state, const void* data, size_t length);
+/// write the 32 byte digest of the stream so far, the state stays usable
+void sha256_final (const Sha256State* state, uint8_t digest[32]);
+
+/// append data[i] to states[i] for several independent streams at once,
+/// with SHA-NI two streams are interleaved so one stream's rounds fill the other's latency
+void sha256_multi (Sha256State* const* states, const void* const* data, const size_t* lengths, size_t count);
+
+/// name of the kernel used on the running CPU ("shani" or "portable")
+const char* sha256_kernel();
+
+/// choose the kernel of sha256_update and sha256_multi ("shani" or "portable"), e.g. to test the portable code,
+/// returns false if the name is unknown or the CPU doesn't support it
+bool sha256_select_kernel(const char* name);
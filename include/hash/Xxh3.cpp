@@ -0,0 +1,576 @@
+// //////////////////////////////////////////////////////////
+// Xxh3.cpp
+// XXH3, see Xxh3.h
+// inputs up to 240 bytes are hashed in one go from the buffer, longer ones go stripe by stripe through the kernel
+//
+
+#include "Xxh3.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#ifdef XXH3_USE_SIMD
+  #include <utils/CpuFeatures.h>
+#endif
+
+namespace
+{
+  /// default secret of xxHash 0.8
+  const uint8_t Secret[192] =
+  {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+  };
+
+  const size_t StripeLength    = 64;
+  /// every stripe of a block uses the secret 8 bytes further on, then the accumulators are scrambled
+  const size_t StripesPerBlock = (sizeof(Secret) - StripeLength) / 8;
+  /// longest input hashed without the stripe loop
+  const size_t MidSizeMax      = 240;
+
+  const uint64_t Prime32_1 = 0x9E3779B1U;
+  const uint64_t Prime32_2 = 0x85EBCA77U;
+  const uint64_t Prime32_3 = 0xC2B2AE3DU;
+  const uint64_t Prime64_1 = 0x9E3779B185EBCA87ULL;
+  const uint64_t Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+  const uint64_t Prime64_3 = 0x165667B19E3779F9ULL;
+  const uint64_t Prime64_4 = 0x85EBCA77C2B2AE63ULL;
+  const uint64_t Prime64_5 = 0x27D4EB2F165667C5ULL;
+  const uint64_t PrimeMx1  = 0x165667919E3779F9ULL;
+  const uint64_t PrimeMx2  = 0x9FB21C651E98DF25ULL;
+
+  // little endian reads, compilers turn these into plain loads on x86
+  inline uint32_t read32(const uint8_t* p)
+  {
+    return (uint32_t) p[0] | (uint32_t) p[1] << 8 | (uint32_t) p[2] << 16 | (uint32_t) p[3] << 24;
+  }
+  inline uint64_t read64(const uint8_t* p)
+  {
+    return (uint64_t) read32(p) | (uint64_t) read32(p + 4) << 32;
+  }
+
+  inline uint32_t swap32(uint32_t x) { return (x >> 24) | ((x >> 8) & 0xff00) | ((x << 8) & 0xff0000) | (x << 24); }
+  inline uint64_t swap64(uint64_t x) { return (uint64_t) swap32((uint32_t) x) << 32 | swap32((uint32_t) (x >> 32)); }
+  inline uint32_t rotl32(uint32_t x, int bits) { return (x << bits) | (x >> (32 - bits)); }
+  inline uint64_t rotl64(uint64_t x, int bits) { return (x << bits) | (x >> (64 - bits)); }
+
+  struct Product
+  {
+    uint64_t low, high;
+  };
+
+  /// full 128 bit product
+  inline Product multiply(uint64_t a, uint64_t b)
+  {
+#if defined(__SIZEOF_INT128__)
+    const unsigned __int128 product = (unsigned __int128) a * b;
+    return { (uint64_t) product, (uint64_t) (product >> 64) };
+#else
+    const uint64_t lowLow  = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+    const uint64_t highLow = (a >> 32)        * (b & 0xFFFFFFFF);
+    const uint64_t lowHigh = (a & 0xFFFFFFFF) * (b >> 32);
+    const uint64_t highHigh= (a >> 32)        * (b >> 32);
+    const uint64_t cross   = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+    return { (cross << 32) | (lowLow & 0xFFFFFFFF), (highLow >> 32) + (cross >> 32) + highHigh };
+#endif
+  }
+
+  inline uint64_t multiplyFold(uint64_t a, uint64_t b)
+  {
+    const Product product = multiply(a, b);
+    return product.low ^ product.high;
+  }
+
+  /// final mix of XXH64
+  inline uint64_t avalancheXxh64(uint64_t h)
+  {
+    h ^= h >> 33; h *= Prime64_2;
+    h ^= h >> 29; h *= Prime64_3;
+    return h ^ (h >> 32);
+  }
+
+  inline uint64_t avalanche(uint64_t h)
+  {
+    h ^= h >> 37; h *= PrimeMx1;
+    return h ^ (h >> 32);
+  }
+
+  /// stronger mix for 4 to 8 bytes
+  inline uint64_t rrmxmx(uint64_t h, uint64_t length)
+  {
+    h ^= rotl64(h, 49) ^ rotl64(h, 24);
+    h *= PrimeMx2;
+    h ^= (h >> 35) + length;
+    h *= PrimeMx2;
+    return h ^ (h >> 28);
+  }
+
+  inline uint64_t mix16(const uint8_t* input, const uint8_t* secret)
+  {
+    return multiplyFold(read64(input) ^ read64(secret), read64(input + 8) ^ read64(secret + 8));
+  }
+
+  /// two mix16 into the halves of a 128 bit accumulator, each half also takes in the other input
+  inline void mix32(Product& acc, const uint8_t* first, const uint8_t* second, const uint8_t* secret)
+  {
+    acc.low  += mix16(first, secret);
+    acc.low  ^= read64(second) + read64(second + 8);
+    acc.high += mix16(second, secret + 16);
+    acc.high ^= read64(first) + read64(first + 8);
+  }
+
+  // ---------- up to 240 bytes ----------
+
+  uint64_t short64(const uint8_t* input, size_t length)
+  {
+    if (length > 128)
+    {
+      uint64_t acc = length * Prime64_1;
+      for (size_t i = 0; i < 8; ++i)
+        acc += mix16(input + 16 * i, Secret + 16 * i);
+      acc = avalanche(acc);
+      for (size_t i = 8; i < length / 16; ++i)
+        acc += mix16(input + 16 * i, Secret + 16 * (i - 8) + 3);
+      acc += mix16(input + length - 16, Secret + 136 - 17);
+      return avalanche(acc);
+    }
+    if (length > 16)
+    {
+      uint64_t acc = length * Prime64_1;
+      if (length > 32)
+      {
+        if (length > 64)
+        {
+          if (length > 96)
+          {
+            acc += mix16(input + 48, Secret + 96);
+            acc += mix16(input + length - 64, Secret + 112);
+          }
+          acc += mix16(input + 32, Secret + 64);
+          acc += mix16(input + length - 48, Secret + 80);
+        }
+        acc += mix16(input + 16, Secret + 32);
+        acc += mix16(input + length - 32, Secret + 48);
+      }
+      acc += mix16(input, Secret);
+      acc += mix16(input + length - 16, Secret + 16);
+      return avalanche(acc);
+    }
+    if (length > 8)
+    {
+      const uint64_t low  = read64(input)              ^ (read64(Secret + 24) ^ read64(Secret + 32));
+      const uint64_t high = read64(input + length - 8) ^ (read64(Secret + 40) ^ read64(Secret + 48));
+      return avalanche(length + swap64(low) + high + multiplyFold(low, high));
+    }
+    if (length >= 4)
+    {
+      const uint64_t value = read32(input + length - 4) + ((uint64_t) read32(input) << 32);
+      return rrmxmx(value ^ (read64(Secret + 8) ^ read64(Secret + 16)), length);
+    }
+    if (length > 0)
+    {
+      const uint32_t combined = (uint32_t) input[0] << 16 | (uint32_t) input[length >> 1] << 24 | input[length - 1] | (uint32_t) length << 8;
+      return avalancheXxh64(combined ^ (uint64_t) (read32(Secret) ^ read32(Secret + 4)));
+    }
+    return avalancheXxh64(read64(Secret + 56) ^ read64(Secret + 64));
+  }
+
+  Product short128(const uint8_t* input, size_t length)
+  {
+    if (length > 16)
+    {
+      Product acc = { length * Prime64_1, 0 };
+      if (length > 128)
+      {
+        for (size_t i = 0; i < 4; ++i)
+          mix32(acc, input + 32 * i, input + 32 * i + 16, Secret + 32 * i);
+        acc.low  = avalanche(acc.low);
+        acc.high = avalanche(acc.high);
+        for (size_t i = 4; i < length / 32; ++i)
+          mix32(acc, input + 32 * i, input + 32 * i + 16, Secret + 32 * (i - 4) + 3);
+        mix32(acc, input + length - 16, input + length - 32, Secret + 136 - 17 - 16);
+      }
+      else
+      {
+        if (length > 32)
+        {
+          if (length > 64)
+          {
+            if (length > 96)
+              mix32(acc, input + 48, input + length - 64, Secret + 96);
+            mix32(acc, input + 32, input + length - 48, Secret + 64);
+          }
+          mix32(acc, input + 16, input + length - 32, Secret + 32);
+        }
+        mix32(acc, input, input + length - 16, Secret);
+      }
+      const uint64_t low  = acc.low + acc.high;
+      const uint64_t high = acc.low * Prime64_1 + acc.high * Prime64_4 + length * Prime64_2;
+      return { avalanche(low), 0 - avalanche(high) };
+    }
+    if (length > 8)
+    {
+      const uint64_t flipLow  = read64(Secret + 32) ^ read64(Secret + 40);
+      const uint64_t flipHigh = read64(Secret + 48) ^ read64(Secret + 56);
+      const uint64_t low  = read64(input);
+      uint64_t       high = read64(input + length - 8);
+      Product m = multiply(low ^ high ^ flipLow, Prime64_1);
+      m.low  += (uint64_t) (length - 1) << 54;
+      high   ^= flipHigh;
+      m.high += high + (uint64_t) (uint32_t) high * (Prime32_2 - 1);
+      m.low  ^= swap64(m.high);
+      Product h = multiply(m.low, Prime64_2);
+      h.high += m.high * Prime64_2;
+      return { avalanche(h.low), avalanche(h.high) };
+    }
+    if (length >= 4)
+    {
+      const uint64_t value = read32(input) + ((uint64_t) read32(input + length - 4) << 32);
+      Product m = multiply(value ^ (read64(Secret + 16) ^ read64(Secret + 24)), Prime64_1 + (length << 2));
+      m.high += m.low << 1;
+      m.low  ^= m.high >> 3;
+      m.low  ^= m.low >> 35;
+      m.low  *= PrimeMx2;
+      m.low  ^= m.low >> 28;
+      return { m.low, avalanche(m.high) };
+    }
+    if (length > 0)
+    {
+      const uint32_t combinedLow  = (uint32_t) input[0] << 16 | (uint32_t) input[length >> 1] << 24 | input[length - 1] | (uint32_t) length << 8;
+      const uint32_t combinedHigh = rotl32(swap32(combinedLow), 13);
+      return { avalancheXxh64(combinedLow  ^ (uint64_t) (read32(Secret)     ^ read32(Secret + 4))),
+               avalancheXxh64(combinedHigh ^ (uint64_t) (read32(Secret + 8) ^ read32(Secret + 12))) };
+    }
+    return { avalancheXxh64(read64(Secret + 64) ^ read64(Secret + 72)), avalancheXxh64(read64(Secret + 80) ^ read64(Secret + 88)) };
+  }
+
+  // ---------- stripe kernels ----------
+
+  /// add "stripes" stripes into the accumulators, stripe i is keyed with the secret at 8 * i
+  typedef void (*AccumulateFunction)(uint64_t acc[8], const uint8_t* input, const uint8_t* secret, size_t stripes);
+  /// scramble the accumulators at the end of a block
+  typedef void (*ScrambleFunction)(uint64_t acc[8], const uint8_t* secret);
+
+  void portableAccumulate(uint64_t acc[8], const uint8_t* input, const uint8_t* secret, size_t stripes)
+  {
+    for (; stripes > 0; --stripes, input += StripeLength, secret += 8)
+      for (size_t i = 0; i < 8; ++i)
+      {
+        const uint64_t data = read64(input + 8 * i);
+        const uint64_t key  = data ^ read64(secret + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i]     += (key & 0xFFFFFFFF) * (key >> 32);
+      }
+  }
+
+  void portableScramble(uint64_t acc[8], const uint8_t* secret)
+  {
+    for (size_t i = 0; i < 8; ++i)
+    {
+      uint64_t value = acc[i];
+      value ^= value >> 47;
+      value ^= read64(secret + 8 * i);
+      acc[i] = value * Prime32_1;
+    }
+  }
+
+#ifdef XXH3_USE_SIMD
+  // same steps for every register width: the 32x32 bit product of each key's halves, the data goes into the neighbouring
+  // accumulator (64 bit halves swapped), scrambling multiplies both 32 bit halves by Prime32_1
+
+  // ---------- SSE2, four registers per stripe ----------
+
+  void sseAccumulate(uint64_t acc[8], const uint8_t* input, const uint8_t* secret, size_t stripes)
+  {
+    __m128i a[4];
+    for (int j = 0; j < 4; ++j)
+      a[j] = _mm_loadu_si128((const __m128i*) acc + j);
+    for (; stripes > 0; --stripes, input += StripeLength, secret += 8)
+      for (int j = 0; j < 4; ++j)
+      {
+        const __m128i data = _mm_loadu_si128((const __m128i*) input + j);
+        const __m128i key  = _mm_xor_si128(data, _mm_loadu_si128((const __m128i*) secret + j));
+        const __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+        a[j] = _mm_add_epi64(_mm_add_epi64(a[j], _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))), product);
+      }
+    for (int j = 0; j < 4; ++j)
+      _mm_storeu_si128((__m128i*) acc + j, a[j]);
+  }
+
+  void sseScramble(uint64_t acc[8], const uint8_t* secret)
+  {
+    const __m128i prime = _mm_set1_epi32((int) Prime32_1);
+    for (int j = 0; j < 4; ++j)
+    {
+      __m128i value = _mm_loadu_si128((const __m128i*) acc + j);
+      value = _mm_xor_si128(_mm_xor_si128(value, _mm_srli_epi64(value, 47)), _mm_loadu_si128((const __m128i*) secret + j));
+      const __m128i low  = _mm_mul_epu32(value, prime);
+      const __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+      _mm_storeu_si128((__m128i*) acc + j, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+    }
+  }
+
+  // ---------- AVX2, two registers per stripe ----------
+
+  SFV_TARGET("avx2")
+  void avx2Accumulate(uint64_t acc[8], const uint8_t* input, const uint8_t* secret, size_t stripes)
+  {
+    __m256i a[2];
+    for (int j = 0; j < 2; ++j)
+      a[j] = _mm256_loadu_si256((const __m256i*) acc + j);
+    for (; stripes > 0; --stripes, input += StripeLength, secret += 8)
+      for (int j = 0; j < 2; ++j)
+      {
+        const __m256i data = _mm256_loadu_si256((const __m256i*) input + j);
+        const __m256i key  = _mm256_xor_si256(data, _mm256_loadu_si256((const __m256i*) secret + j));
+        const __m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+        a[j] = _mm256_add_epi64(_mm256_add_epi64(a[j], _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2))), product);
+      }
+    for (int j = 0; j < 2; ++j)
+      _mm256_storeu_si256((__m256i*) acc + j, a[j]);
+  }
+
+  SFV_TARGET("avx2")
+  void avx2Scramble(uint64_t acc[8], const uint8_t* secret)
+  {
+    const __m256i prime = _mm256_set1_epi32((int) Prime32_1);
+    for (int j = 0; j < 2; ++j)
+    {
+      __m256i value = _mm256_loadu_si256((const __m256i*) acc + j);
+      value = _mm256_xor_si256(_mm256_xor_si256(value, _mm256_srli_epi64(value, 47)), _mm256_loadu_si256((const __m256i*) secret + j));
+      const __m256i low  = _mm256_mul_epu32(value, prime);
+      const __m256i high = _mm256_mul_epu32(_mm256_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+      _mm256_storeu_si256((__m256i*) acc + j, _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+    }
+  }
+
+  // ---------- AVX-512, one register per stripe ----------
+
+  SFV_TARGET("avx512f")
+  void avx512Accumulate(uint64_t acc[8], const uint8_t* input, const uint8_t* secret, size_t stripes)
+  {
+    __m512i a = _mm512_loadu_si512(acc);
+    for (; stripes > 0; --stripes, input += StripeLength, secret += 8)
+    {
+      const __m512i data = _mm512_loadu_si512(input);
+      const __m512i key  = _mm512_xor_si512(data, _mm512_loadu_si512(secret));
+      const __m512i product = _mm512_mul_epu32(key, _mm512_shuffle_epi32(key, (_MM_PERM_ENUM) _MM_SHUFFLE(0, 3, 0, 1)));
+      a = _mm512_add_epi64(_mm512_add_epi64(a, _mm512_shuffle_epi32(data, (_MM_PERM_ENUM) _MM_SHUFFLE(1, 0, 3, 2))), product);
+    }
+    _mm512_storeu_si512(acc, a);
+  }
+
+  SFV_TARGET("avx512f")
+  void avx512Scramble(uint64_t acc[8], const uint8_t* secret)
+  {
+    const __m512i prime = _mm512_set1_epi32((int) Prime32_1);
+    __m512i value = _mm512_loadu_si512(acc);
+    value = _mm512_ternarylogic_epi32(value, _mm512_srli_epi64(value, 47), _mm512_loadu_si512(secret), 0x96); // a ^ b ^ c
+    const __m512i low  = _mm512_mul_epu32(value, prime);
+    const __m512i high = _mm512_mul_epu32(_mm512_shuffle_epi32(value, (_MM_PERM_ENUM) _MM_SHUFFLE(0, 3, 0, 1)), prime);
+    _mm512_storeu_si512(acc, _mm512_add_epi64(low, _mm512_slli_epi64(high, 32)));
+  }
+#endif
+
+  struct StripeKernel
+  {
+    const char*        name;
+    AccumulateFunction accumulate;
+    ScrambleFunction   scramble;
+  };
+
+  /// kernels supported by the running CPU, narrowest first
+  size_t stripeKernels(const StripeKernel** kernels)
+  {
+    static StripeKernel supported[4];
+    static const size_t count = []
+    {
+      size_t found = 0;
+      supported[found++] = { "portable", portableAccumulate, portableScramble };
+#ifdef XXH3_USE_SIMD
+      supported[found++] = { "sse2", sseAccumulate, sseScramble };
+      if (CpuFeatures::get().avx2())
+        supported[found++] = { "avx2", avx2Accumulate, avx2Scramble };
+      if (CpuFeatures::get().avx512())
+        supported[found++] = { "avx512", avx512Accumulate, avx512Scramble };
+#endif
+      return found;
+    }();
+    *kernels = supported;
+    return count;
+  }
+
+  /// set by xxh3_select_kernel, nullptr for the widest kernel
+  std::atomic<const StripeKernel*> SelectedKernel{ nullptr };
+
+  /// kernel in use
+  const StripeKernel& stripeKernel()
+  {
+    if (const StripeKernel* selected = SelectedKernel.load(std::memory_order_relaxed))
+      return *selected;
+    const StripeKernel* kernels;
+    const size_t count = stripeKernels(&kernels);
+    return kernels[count - 1];
+  }
+
+  /// accumulate whole stripes, the accumulators are scrambled whenever a block is complete
+  void consumeStripes(uint64_t acc[8], uint32_t* stripesInBlock, const uint8_t* input, size_t stripes)
+  {
+    const StripeKernel& kernel = stripeKernel();
+    while (stripes > 0)
+    {
+      const size_t count = std::min(stripes, StripesPerBlock - *stripesInBlock);
+      kernel.accumulate(acc, input, Secret + 8 * *stripesInBlock, count);
+      *stripesInBlock += (uint32_t) count;
+      input   += count * StripeLength;
+      stripes -= count;
+      if (*stripesInBlock == StripesPerBlock)
+      {
+        kernel.scramble(acc, Secret + sizeof(Secret) - StripeLength);
+        *stripesInBlock = 0;
+      }
+    }
+  }
+
+  /// accumulators of a stream longer than MidSizeMax after its buffered stripes and the final stripe
+  void finishLong(const Xxh3State* state, uint64_t acc[8])
+  {
+    std::memcpy(acc, state->acc, sizeof(state->acc));
+    uint32_t stripesInBlock = state->stripesInBlock;
+    consumeStripes(acc, &stripesInBlock, state->buffer, (state->bufferLength - 1) / StripeLength);
+
+    // the last 64 bytes of the stream, with its own part of the secret
+    uint8_t last[StripeLength];
+    if (state->bufferLength >= StripeLength)
+    {
+      std::memcpy(last, state->buffer + state->bufferLength - StripeLength, StripeLength);
+    }
+    else
+    {
+      const size_t catchUp = StripeLength - state->bufferLength;
+      std::memcpy(last, state->lastStripe + StripeLength - catchUp, catchUp);
+      std::memcpy(last + catchUp, state->buffer, state->bufferLength);
+    }
+    stripeKernel().accumulate(acc, last, Secret + sizeof(Secret) - StripeLength - 7, 1);
+  }
+
+  uint64_t mergeAccumulators(const uint64_t acc[8], const uint8_t* secret, uint64_t start)
+  {
+    for (size_t i = 0; i < 4; ++i)
+      start += multiplyFold(acc[2 * i] ^ read64(secret + 16 * i), acc[2 * i + 1] ^ read64(secret + 16 * i + 8));
+    return avalanche(start);
+  }
+}
+
+
+/// start an empty stream
+void xxh3_init(Xxh3State* state)
+{
+  const uint64_t acc[8] = { Prime32_3, Prime64_1, Prime64_2, Prime64_3, Prime64_4, Prime32_2, Prime64_5, Prime32_1 };
+  std::memcpy(state->acc, acc, sizeof(acc));
+  state->length         = 0;
+  state->bufferLength   = 0;
+  state->stripesInBlock = 0;
+}
+
+
+/// append data to the stream
+void xxh3_update(Xxh3State* state, const void* data, size_t length)
+{
+  const uint8_t* current = (const uint8_t*) data;
+  state->length += length;
+  if (state->bufferLength + length <= sizeof(state->buffer))
+  {
+    std::memcpy(state->buffer + state->bufferLength, current, length);
+    state->bufferLength += (uint32_t) length;
+    return;
+  }
+
+  // complete the buffer, more data follows so all of its stripes can be accumulated
+  if (state->bufferLength != 0)
+  {
+    const size_t fill = sizeof(state->buffer) - state->bufferLength;
+    std::memcpy(state->buffer + state->bufferLength, current, fill);
+    current += fill;
+    length  -= fill;
+    consumeStripes(state->acc, &state->stripesInBlock, state->buffer, sizeof(state->buffer) / StripeLength);
+    std::memcpy(state->lastStripe, state->buffer + sizeof(state->buffer) - StripeLength, StripeLength);
+    state->bufferLength = 0;
+  }
+
+  // whole stripes straight from the input, at least one byte is kept back
+  if (length > sizeof(state->buffer))
+  {
+    const size_t stripes = (length - 1) / StripeLength;
+    consumeStripes(state->acc, &state->stripesInBlock, current, stripes);
+    current += stripes * StripeLength;
+    length  -= stripes * StripeLength;
+    std::memcpy(state->lastStripe, current - StripeLength, StripeLength);
+  }
+
+  std::memcpy(state->buffer, current, length);
+  state->bufferLength = (uint32_t) length;
+}
+
+
+/// 64 bit digest of the stream so far
+uint64_t xxh3_64_final(const Xxh3State* state)
+{
+  if (state->length <= MidSizeMax)
+    return short64(state->buffer, (size_t) state->length);
+
+  uint64_t acc[8];
+  finishLong(state, acc);
+  return mergeAccumulators(acc, Secret + 11, state->length * Prime64_1);
+}
+
+
+/// 128 bit digest of the stream so far
+void xxh3_128_final(const Xxh3State* state, uint64_t* low, uint64_t* high)
+{
+  if (state->length <= MidSizeMax)
+  {
+    const Product hash = short128(state->buffer, (size_t) state->length);
+    *low  = hash.low;
+    *high = hash.high;
+    return;
+  }
+
+  uint64_t acc[8];
+  finishLong(state, acc);
+  *low  = mergeAccumulators(acc, Secret + 11, state->length * Prime64_1);
+  *high = mergeAccumulators(acc, Secret + sizeof(Secret) - StripeLength - 11, ~(state->length * Prime64_2));
+}
+
+
+/// name of the stripe kernel used on the running CPU
+const char* xxh3_kernel()
+{
+  return stripeKernel().name;
+}
+
+
+/// choose the stripe kernel by name, returns false if the name is unknown or the CPU doesn't support it
+bool xxh3_select_kernel(const char* name)
+{
+  const StripeKernel* kernels;
+  const size_t count = stripeKernels(&kernels);
+  for (size_t i = 0; i < count; ++i)
+  {
+    if (strcmp(kernels[i].name, name) != 0)
+      continue;
+    SelectedKernel.store(&kernels[i], std::memory_order_relaxed);
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,46 @@
+// //////////////////////////////////////////////////////////
+// Xxh3.h
+// XXH3 (xxHash 0.8, default secret, seed 0), incremental state with a 64 and a 128 bit digest:
+// the long input loop multiplies 64 byte stripes into eight 64 bit accumulators, one SIMD register
+// per stripe with AVX-512 (two AVX2, four SSE2 registers), picked at runtime
+// check values xxh3_64("abc") = 78af5f94892f3950, xxh3_128("abc") = 06b05ab6733a618578af5f94892f3950
+//
+
+#pragma once
+
+// uint8_t, uint32_t, uint64_t
+#include <stdint.h>
+// size_t
+#include <cstddef>
+
+// x64 only: SIMD stripe kernels, everything else uses the portable code
+#if defined(__x86_64__) || defined(_M_X64)
+#define XXH3_USE_SIMD
+#endif
+
+/// running XXH3 of one stream, set up by xxh3_init
+struct Xxh3State
+{
+  uint64_t acc[8];
+  uint64_t length;          // bytes so far
+  uint32_t bufferLength;
+  uint32_t stripesInBlock;  // stripes accumulated since the last scramble
+  uint8_t  buffer[256];     // bytes not accumulated yet, a stripe is only accumulated once more data follows
+  uint8_t  lastStripe[64];  // last accumulated stripe, the final stripe may reach back into it
+};
+
+/// start an empty stream
+void     xxh3_init    (Xxh3State* state);
+/// append data to the stream
+void     xxh3_update  (Xxh3State* state, const void* data, size_t length);
+/// 64 bit digest of the stream so far, the state stays usable
+uint64_t xxh3_64_final(const Xxh3State* state);
+/// 128 bit digest of the stream so far, the state stays usable
+void     xxh3_128_final(const Xxh3State* state, uint64_t* low, uint64_t* high);
+
+/// name of the stripe kernel used on the running CPU ("avx512", "avx2", "sse2" or "portable")
+const char* xxh3_kernel();
+
+/// choose the stripe kernel by name (see xxh3_kernel), e.g. to test the narrower ones,
+/// returns false if the name is unknown or the CPU doesn't support it
+bool xxh3_select_kernel(const char* name);
@@ -0,0 +1,53 @@
+/**
+ *  @file   CacheResidency.h
+ *  @brief  Remembers which pages of a file range were in the page cache before it was read
+ ***********************************************/
+
+#ifndef SFVARCHIVING_CACHE_RESIDENCY_H
+#define SFVARCHIVING_CACHE_RESIDENCY_H
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Page cache snapshot of a file range, used to drop only the pages a scrub brought in
+ * \note Pages that another process had cached are left alone, so reading a file costs the page cache nothing. \n
+ *       The snapshot is taken once for the whole range before reading starts, so pages the kernel reads ahead count as new. \n
+ *       Uses mincore and posix_fadvise(POSIX_FADV_DONTNEED), one bit per page. Off POSIX nothing is recorded or dropped
+ */
+class CacheResidency {
+public:
+    /**
+     * \brief Drops should start and end on multiples of this. The kernel caches file data in folios of up to 2 MiB,
+     *        aligned to their size, and only drops a folio when the whole of it is dropped
+     */
+    static constexpr uint64_t drop_alignment = uint64_t(2) << 20;
+    /**
+     * \brief Bytes past its range a reader also records and drops. Read-ahead, and read-ahead marks left by other readers,
+     *        bring in pages past the range before the next range's snapshot may have been taken
+     */
+    static constexpr uint64_t read_ahead_slack = uint64_t(32) << 20;
+
+    /**
+     * \brief Records the cached pages of a file range, through temporary mappings that aren't read from
+     * \param fd Open file
+     * \param offset First byte
+     * \param length Bytes in the range
+     */
+    void record(int fd, uint64_t offset, uint64_t length);
+
+    /**
+     * \brief Drops the pages of part of the recorded range that weren't cached when it was recorded
+     * \param fd Open file
+     * \param offset First byte
+     * \param length Bytes to drop, pages outside the recorded range are left alone
+     * \note Readers drop behind themselves in drop_alignment steps, a smaller part may leave its pages cached
+     */
+    void dropNew(int fd, uint64_t offset, uint64_t length) const;
+
+private:
+    uint64_t m_FirstPage = 0;
+    std::vector<bool> m_Resident; // One per page from m_FirstPage
+};
+
+#endif //SFVARCHIVING_CACHE_RESIDENCY_H
@@ -0,0 +1,51 @@
+/**
+ *  @file   DeviceGroups.h
+ *  @brief  Groups files by the device they are stored on
+ ***********************************************/
+
+#ifndef SFVARCHIVING_DEVICE_GROUPS_H
+#define SFVARCHIVING_DEVICE_GROUPS_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * \brief Splits a list of files by device (st_dev), so every disk of a host can be read at once, each at its own pace
+ * \note Rotational disks are found through /sys/dev/block/<major>:<minor>/queue/rotational, or the queue of the whole disk
+ *       for a partition. Devices without one (network and FUSE mounts, btrfs subvolumes, tmpfs) count as solid state. \n
+ *       Off POSIX every file is in a single group
+ */
+class DeviceGroups {
+public:
+    /**
+     * \brief Files stored on one device
+     */
+    struct Group {
+        uint64_t device = 0; // st_dev
+        bool rotational = false;
+        std::vector<size_t> files; // Positions in the split list, in order
+        std::vector<uint64_t> sizes; // st_size of each file, unknown_size where it couldn't be found
+    };
+
+    /**
+     * \brief Size of a file that couldn't be found
+     */
+    static constexpr uint64_t unknown_size = UINT64_MAX;
+
+    /**
+     * \brief Groups files by device, one stat per file. The sizes come with it, so small files need no other stat to be read
+     * \param file_paths Files, ones that can't be found (or aren't regular files) are put with the first file's group and fail when hashed
+     * \return Groups in order of their first file
+     */
+    static std::vector<Group> split(const std::vector<std::string>& file_paths);
+
+    /**
+     * \brief Checks if a device is a spinning disk, which reads fastest from one stream at a time
+     * \param device st_dev of a file on the device
+     * \return True if the kernel reports the disk as rotational
+     */
+    static bool rotational(uint64_t device);
+};
+
+#endif //SFVARCHIVING_DEVICE_GROUPS_H
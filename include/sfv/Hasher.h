@@ -0,0 +1,147 @@
+/**
+ *  @file   Hasher.h
+ *  @brief  Incremental hash state, fed from files, pipes or in-memory buffers
+ ***********************************************/
+
+#ifndef SFVARCHIVING_HASHER_H
+#define SFVARCHIVING_HASHER_H
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <hash/Md5.h>
+#include <hash/Sha256.h>
+#include <hash/Blake3.h>
+#include <hash/Xxh3.h>
+
+enum class HashType{CRC,CRC32C,CRC64,MD5,SHA256,BLAKE3,XXH3,XXH128};
+
+/**
+ * \brief Running hash of a byte stream
+ * \note Holds the kernel and the current state only, update() never allocates. \n
+ *       Two CRC or BLAKE3 hashers over consecutive pieces can be merged with combine(), so pieces may be hashed on different threads.
+ */
+class Hasher {
+public:
+    /**
+     * \brief Creates an empty state
+     * \param type Hash type
+     * \param offset Position of the first byte in the whole stream, for pieces that are combine()d later. A multiple of split_alignment
+     */
+    explicit Hasher(HashType type, uint64_t offset = 0);
+
+    /**
+     * \brief Appends data to the hashed stream
+     * \param data Next bytes of the stream
+     */
+    void update(std::span<const std::byte> data) {
+        update(data.data(), data.size());
+    }
+    void update(const void* data, const size_t length) {
+        if (m_Functions.update != nullptr) m_Value = m_Functions.update(data, length, m_Value);
+        else updateDigest(data, length);
+    }
+
+    /**
+     * \brief Checks if hashes of consecutive pieces can be merged, so a single stream can be split between threads
+     * \param type Hash type
+     * \return True for the CRCs and BLAKE3
+     */
+    static bool combinable(HashType type);
+
+    /**
+     * \brief Pieces hashed separately start at a multiple of this many bytes, BLAKE3 splits its tree between chunks
+     */
+    static constexpr size_t split_alignment = Blake3ChunkSize;
+
+    /**
+     * \brief Appends the stream hashed by other, as if its data had been passed to update()
+     * \param other State of the bytes following this one's, created at the offset where they start. Must be of the same, combinable() type
+     * \param other_length Number of bytes hashed by other
+     * \throws std::logic_error if the types differ or can't be combined
+     */
+    void combine(const Hasher& other, const uint64_t other_length) {
+        if (other.m_Type != m_Type || !combinable(m_Type)) throw std::logic_error("Hasher::combine needs two hashers of the same CRC or BLAKE3 type");
+        if (m_Functions.combine != nullptr) m_Value = m_Functions.combine(m_Value, other.m_Value, other_length);
+        else blake3_combine(&m_Blake3, &other.m_Blake3);
+    }
+
+    /**
+     * \brief Appends one buffer to each of several hashers, using the multi-buffer kernels
+     * \param hashers States, all of the same type
+     * \param data Next bytes of each hasher's stream
+     * \param lengths Size of each buffer
+     * \param count Number of hashers
+     * \note Fastest for many small buffers of similar size, e.g a batch of small files sorted by size
+     */
+    static void updateMulti(Hasher* hashers, const void* const* data, const size_t* lengths, size_t count);
+
+    /**
+     * \brief Restarts with an empty stream
+     * \param offset Position of the first byte in the whole stream, see Hasher()
+     */
+    void reset(uint64_t offset = 0);
+
+    /**
+     * \brief Gets the CRC of all the data so far. The state stays usable
+     * \return CRC, 32 bit CRCs use the low half
+     * \throws std::logic_error for the types that aren't CRCs, they only have a digest()
+     */
+    [[nodiscard]] uint64_t finalize() const {
+        if (m_Functions.update == nullptr) throw std::logic_error("Hasher::finalize is only for CRCs, use digest()");
+        return m_Value;
+    }
+
+    /**
+     * \brief Largest digest() of all types, in bytes
+     */
+    static constexpr size_t max_digest_size = 32;
+
+    /**
+     * \brief Gets the hash of all the data so far, of any type. The state stays usable
+     * \param digest Receives digits() / 2 bytes, CRCs are big endian like their hex form
+     */
+    void digest(uint8_t* digest) const;
+
+    /**
+     * \brief Hex digits of the finalized hash
+     */
+    [[nodiscard]] unsigned int digits() const {return m_Functions.digits;}
+
+    [[nodiscard]] HashType type() const {return m_Type;}
+
+private:
+    /**
+     * \brief Kernel and combine function of one CRC variant. 32 bit CRCs use the low half. \n
+     *        Null functions for the other types, they keep their own state
+     */
+    struct CrcFunctions {
+        uint64_t (*update)(const void* data, size_t length, uint64_t previous_crc);
+        uint64_t (*combine)(uint64_t crc_a, uint64_t crc_b, size_t length_b);
+        void (*multi)(const void* const* data, const size_t* lengths, uint64_t* crcs, size_t count);
+        unsigned int digits; // Hex digits of the result
+    };
+    /**
+     * \brief Gets the functions of a CRC hash type
+     * \param type Hash type
+     * \return Functions
+     */
+    static CrcFunctions crcFunctions(HashType type);
+
+    /**
+     * \brief update() of the types that aren't CRCs
+     */
+    void updateDigest(const void* data, size_t length);
+
+    HashType m_Type;
+    CrcFunctions m_Functions;
+    uint64_t m_Value = 0; // CRCs
+    union { // Other types, set up by reset()
+        Md5State m_Md5;
+        Sha256State m_Sha256;
+        Blake3State m_Blake3;
+        Xxh3State m_Xxh3; // XXH3 and XXH128
+    };
+};
+
+#endif //SFVARCHIVING_HASHER_H
@@ -0,0 +1,74 @@
+/**
+ *  @file   MapPolicy.h
+ *  @brief  Kernel hints given for the memory mapped files
+ ***********************************************/
+
+#ifndef SFVARCHIVING_MAP_POLICY_H
+#define SFVARCHIVING_MAP_POLICY_H
+#include <cstdint>
+#include <string>
+#include <mio/mio.hpp>
+#include <sfv/CacheResidency.h>
+
+/**
+ * \brief madvise / posix_fadvise hints applied to each mio mapping before and after it is hashed
+ * \note The hints are best effort, a kernel or file system that doesn't support one ignores it. No-op off POSIX
+ */
+class MapPolicy {
+public:
+    /**
+     * \brief MADV_SEQUENTIAL, more read-ahead and pages behind the reader are reclaimed first
+     */
+    bool sequential = true;
+    /**
+     * \brief MADV_WILLNEED, starts reading the whole mapping in the background
+     */
+    bool will_need = false;
+    /**
+     * \brief Faults every page in with one call (MADV_POPULATE_READ, the MAP_POPULATE of an existing mapping), Linux 5.14+
+     */
+    bool populate = false;
+    /**
+     * \brief MADV_HUGEPAGE, lets file backed transparent huge pages cover the mapping where the kernel supports them
+     */
+    bool huge_pages = false;
+    /**
+     * \brief MADV_DONTNEED and POSIX_FADV_DONTNEED once a mapping is hashed, so a large verify doesn't push others out of the page cache
+     */
+    bool drop_behind = false;
+    /**
+     * \brief Like drop_behind, but only the pages that weren't cached before the file was read, so a scrub leaves the page
+     *        cache as it found it. The caller records the CacheResidency passed to release()
+     */
+    bool cache_neutral = false;
+
+    /**
+     * \brief Reads a comma separated list of hint names
+     * \param names e.g "sequential,populate". "none" clears all hints
+     * \param policy Set to the named hints
+     * \return If every name is known
+     */
+    static bool fromNames(const std::string& names, MapPolicy& policy);
+
+    /**
+     * \brief Gets the names of the set hints
+     * \return Comma separated list as read by fromNames
+     */
+    [[nodiscard]] std::string names() const;
+
+    /**
+     * \brief Gives the hints for a mapping that is about to be read
+     * \param mmap Fresh mapping
+     */
+    void prepare(const mio::mmap_source& mmap) const;
+
+    /**
+     * \brief Gives the hints for a mapping that was read, before it is unmapped
+     * \param mmap Mapping, made from a path so mio still holds the file open
+     * \param offset Position of mmap.data() in the file
+     * \param residency Snapshot of the file taken before the mapping was read, needed for cache_neutral
+     */
+    void release(const mio::mmap_source& mmap, uint64_t offset, const CacheResidency* residency = nullptr) const;
+};
+
+#endif //SFVARCHIVING_MAP_POLICY_H
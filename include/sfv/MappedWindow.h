@@ -0,0 +1,66 @@
+/**
+ *  @file   MappedWindow.h
+ *  @brief  Walks a file through large memory mapped windows
+ ***********************************************/
+
+#ifndef SFVARCHIVING_MAPPED_WINDOW_H
+#define SFVARCHIVING_MAPPED_WINDOW_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <system_error>
+#include <mio/mio.hpp>
+#include <sfv/MapPolicy.h>
+
+/**
+ * \brief Maps a file one window at a time, front to back
+ * \note Only one window is mapped at once, so files larger than the address space still work. \n
+ *       A window of hundreds of MiB costs one mmap/munmap pair, where mapping each read buffer would cost thousands
+ */
+class MappedWindow {
+public:
+    /**
+     * \brief Default bytes per window
+     */
+    static constexpr uint64_t default_window_size = uint64_t(256) << 20;
+
+    /**
+     * \brief Prepares the walk, nothing is mapped until next()
+     * \param file_path Target file
+     * \param file_size Bytes to walk, from the start of the file
+     * \param window_size Bytes per window, the last one may be shorter
+     * \param policy Hints given for each window
+     */
+    MappedWindow(const std::string& file_path, uint64_t file_size, uint64_t window_size = default_window_size, const MapPolicy& policy = MapPolicy());
+
+    /**
+     * \brief Unmaps the current window and maps the one following it
+     * \param error Set if the window can't be mapped
+     * \return False at the end of the file or on error, nothing is mapped then
+     */
+    bool next(std::error_code& error);
+
+    /**
+     * \brief First byte of the current window
+     */
+    [[nodiscard]] const char* data() const {return m_Map.data();}
+    /**
+     * \brief Bytes in the current window
+     */
+    [[nodiscard]] size_t size() const {return m_Map.size();}
+    /**
+     * \brief Position of the current window in the file
+     */
+    [[nodiscard]] uint64_t offset() const {return m_Offset;}
+
+private:
+    std::string m_FilePath;
+    uint64_t m_FileSize;
+    uint64_t m_WindowSize;
+    uint64_t m_Offset = 0;
+    MapPolicy m_Policy;
+    CacheResidency m_Residency; // Of the whole file, cache_neutral only
+    mio::mmap_source m_Map;
+};
+
+#endif //SFVARCHIVING_MAPPED_WINDOW_H
@@ -0,0 +1,50 @@
+/**
+ *  @file   PreadReader.h
+ *  @brief  Reads files with pread on a reader thread, ahead of the hashing
+ ***********************************************/
+
+#ifndef SFVARCHIVING_PREAD_READER_H
+#define SFVARCHIVING_PREAD_READER_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+
+/**
+ * \brief Streams a range of a file through a ring of buffers filled by a reader thread
+ * \note Plain POSIX (pread and posix_fadvise), for file systems where mapping is slow such as FUSE and network mounts. \n
+ *       The reader thread fills up to buffer_count buffers ahead while the calling thread hashes, the two only share
+ *       a pair of atomic block counters
+ */
+class PreadReader {
+public:
+    /**
+     * \brief Bytes per read
+     */
+    static constexpr size_t block_size = size_t(4) << 20;
+    /**
+     * \brief Buffers in the ring, the reader thread stays up to this many blocks ahead
+     */
+    static constexpr unsigned int buffer_count = 4;
+
+    /**
+     * \brief Checks if pread is available, false on systems without POSIX file IO
+     */
+    static bool available();
+
+    /**
+     * \brief Reads part of a file and hands it out block by block, in order
+     * \param file_path Target file
+     * \param offset First byte
+     * \param length Bytes to read, the range must lie inside the file
+     * \param consume Called with each block, on this thread. The data is only valid during the call. If it throws, the reader
+     *        thread is stopped before the exception is passed on
+     * \param error Set on failure
+     * \param cache_neutral Drops each block's pages from the page cache once it is hashed, unless they were cached before it was read
+     * \return If every byte was read and consumed
+     */
+    static bool read(const std::string& file_path, uint64_t offset, uint64_t length, const std::function<void(const char*, size_t)>& consume, std::error_code& error, bool cache_neutral = false);
+};
+
+#endif //SFVARCHIVING_PREAD_READER_H
@@ -7,8 +7,14 @@
 
 #ifndef SFVARCHIVING_SFV_COMMON_H
 #define SFVARCHIVING_SFV_COMMON_H
+#include <algorithm>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
+#include <sfv/Hasher.h>
+#include <sfv/MapPolicy.h>
 
 class SFV {
     // options
@@ -25,6 +31,59 @@ public:
 
     virtual void process() = 0;
 
+    using HashType = ::HashType;
+
+    /**
+     * \brief Sets the hash algorithm. Readers switch to the one named in the SFV header if there is one
+     * \param type Target hash type
+     */
+    void setHashType(const HashType type) {
+        if (b_HasProcessed) {logResult(LogType::Critical, "You can't set the hash type after it's processed");}
+        m_HashType = type;
+    }
+
+    /**
+     * \brief Gets the name of a hash type, as used by --hash and the SFV header
+     * \param type Hash type
+     * \return Name as string (e.g "crc32c")
+     */
+    static std::string hashName(HashType type);
+
+    /**
+     * \brief Finds the hash type by name
+     * \param name Name as returned by hashName
+     * \param type Set to the found type
+     * \return If the name is known
+     */
+    static bool hashTypeFromName(const std::string& name, HashType& type);
+
+    /**
+     * \brief Checks if a hash type is written as a checksum list ("<hash>  <file>" like md5sum, sha256sum, b3sum and xxhsum) instead of a SFV
+     * \param type Hash type
+     * \return True for every type but the CRCs
+     */
+    static bool checksumList(const HashType type) {
+        return type != HashType::CRC && type != HashType::CRC32C && type != HashType::CRC64;
+    }
+
+    /**
+     * \brief Gets the text in front of each hash of a checksum list
+     * \param type Hash type
+     * \return "XXH3_" for XXH3, which xxhsum uses to tell it from XXH64 of the same length. Empty for the others
+     */
+    static std::string checksumPrefix(const HashType type) {
+        return type == HashType::XXH3 ? "XXH3_" : "";
+    }
+
+    /**
+     * \brief Gets the extension of the files written for a hash type
+     * \param type Hash type
+     * \return ".sfv", or "." + hashName for checksum lists (e.g ".sha256")
+     */
+    static std::string fileExtension(HashType type) {
+        return checksumList(type) ? std::string(".").append(hashName(type)) : ".sfv";
+    }
+
     /**
      * \brief Sets the amount of threads allowed to be used by the hashing async
      * \param count Target thread count. Zero equals max possible
@@ -34,6 +93,74 @@ public:
         m_Threads = count;
     }
 
+    /**
+     * \brief How large files are read
+     */
+    enum class IoEngine{
+        Mmap = 0x00, // Memory mapped with mio
+        Uring = 0x01, // io_uring direct reads (Linux), falls back to Mmap where it can't run
+        Pread = 0x02 // pread on a reader thread, ahead of the hashing (POSIX), for file systems that map slowly
+    };
+
+    /**
+     * \brief Sets how large files are read
+     * \param engine Target engine
+     */
+    void setIoEngine(const IoEngine engine) {
+        if (b_HasProcessed) {logResult(LogType::Critical, "You can't set the IO engine after it's processed");}
+        m_IoEngine = engine;
+    }
+
+    /**
+     * \brief Sets the kernel hints given for mapped files
+     * \param policy Target hints
+     */
+    void setMapPolicy(const MapPolicy& policy) {
+        if (b_HasProcessed) {logResult(LogType::Critical, "You can't set the map policy after it's processed");}
+        m_MapPolicy = policy;
+    }
+
+    /**
+     * \brief Sets scrub mode, which leaves the page cache as it found it
+     * \param scrub If pages a file's read brought into the page cache are dropped again once hashed. Pages that were already
+     *        cached, e.g by a service on the same machine, stay. Applies to every IO engine (io_uring's O_DIRECT reads skip the cache anyway)
+     */
+    void setScrub(const bool scrub) {
+        if (b_HasProcessed) {logResult(LogType::Critical, "You can't set scrub mode after it's processed");}
+        b_Scrub = scrub;
+    }
+
+    /**
+     * \brief Sets the size up to which files are read into a shared buffer and hashed in batches instead of being mapped
+     * \param size Bytes, clamped to min_small_file_limit and max_small_file_limit
+     */
+    void setSmallFileLimit(const unsigned long long int size) {
+        if (b_HasProcessed) {logResult(LogType::Critical, "You can't set the small file limit after it's processed");}
+        m_SmallFileLimit = std::clamp(size, min_small_file_limit, max_small_file_limit);
+    }
+    /**
+     * \brief setSmallFileLimit() sizes. Every batched file has a buffer of its size, up to the limit
+     */
+    static constexpr unsigned long long int default_small_file_limit = 64 * 1024;
+    static constexpr unsigned long long int min_small_file_limit = 4 * 1024;
+    static constexpr unsigned long long int max_small_file_limit = 16 * 1024 * 1024;
+
+    /**
+     * \brief Hashes data on several threads, which take fixed size chunks of it in turn. The chunk scheduler of calculateCrcChunked,
+     *        also timed by --calibrate
+     * \param type Hash type, one that Hasher::combinable
+     * \param size Bytes
+     * \param threads Threads
+     * \param min_block_size Smallest chunk, smaller data uses fewer threads. Zero splits evenly
+     * \param hash_chunk Called with the offset and length of each chunk, from any of the threads. Returns a Hasher of the type
+     *        started at the offset, with the chunk added
+     * \return State of the whole data
+     * \note Chunks are an even share of the data up to max_chunk_size, and are combined in order as soon as the ones before
+     *       them are done
+     */
+    static Hasher hashChunked(HashType type, unsigned long long int size, unsigned int threads, unsigned long long int min_block_size,
+                              const std::function<Hasher(unsigned long long int, unsigned long long int)>& hash_chunk);
+
     virtual ~SFV() = default;
 protected:
 
@@ -55,7 +182,11 @@ protected:
         Processed = 0x06
     };
 
-    enum class HashType{CRC,MD5}; // TODO add MD5 support
+    /**
+     * \brief SFV comment line naming the hash, only written for types other than plain CRC
+     */
+    static constexpr const char* hash_header = "; hash: ";
+
     /**
      * \brief Logs the string in a consistent format
      * \param log Message type
@@ -66,10 +197,71 @@ protected:
     /**
      * \brief Calculates the CRC of a file
      * \param file_path target file
+     * \param threads Threads to split the file between, zero for threadCount()
      * \return Hash as string
      * \note The function will return a error message as string upon failure. (e.g "openError" or "sizeError")
      */
-    [[nodiscard]] std::string calculateCrc(const std::string& file_path) const;
+    [[nodiscard]] std::string calculateCrc(const std::string& file_path, unsigned int threads = 0) const;
+
+    /**
+     * \brief Calculates several hashes of a file from a single read of its data
+     * \param file_path target file
+     * \param types Hash types
+     * \param threads Threads to split the hashes between, zero for threadCount()
+     * \return Hash per type as string, in the same order. Every entry is the error message upon failure (see calculateCrc)
+     * \note Each mapped window, or block of the streaming reader of m_IoEngine, is handed to every hash before the next one is read. \n
+     *       With more than one thread the hashes are split between threads, which hash the same data side by side
+     */
+    [[nodiscard]] std::vector<std::string> calculateHashes(const std::string& file_path, const std::vector<HashType>& types, unsigned int threads = 0) const;
+
+    /**
+     * \brief Calculates the hashes of many files, every device they are stored on is read at the same time
+     * \param file_paths Target files
+     * \param types Hash types, a single one must be m_HashType
+     * \param done Called with each file's position in file_paths and its hash per type, in file_paths order. Called from the
+     *        device threads, one call at a time
+     * \note Files are grouped by DeviceGroups and each group has its own thread and queue. Rotational disks get a single
+     *       thread, so a large file is read as one stream. The other devices share threadCount() threads to split large files between. \n
+     *       Small files of a group are hashed in batches by calculateCrcs,
+     *       the others one by one by calculateCrc, or calculateHashes for several types
+     */
+    void calculateFiles(const std::vector<std::string>& file_paths, const std::vector<HashType>& types, const std::function<void(size_t, std::vector<std::string>&)>& done) const;
+
+    /**
+     * \brief Files per thread in a batch
+     */
+    static constexpr size_t small_file_batch = 16;
+
+    /**
+     * \brief Read buffer of a batch across its threads. A batch ends at this many bytes even if it has fewer than
+     *        small_file_batch files per thread, so large limits and thread counts don't allocate gigabytes
+     */
+    static constexpr unsigned long long int small_file_batch_bytes = 64 * 1024 * 1024;
+
+    /**
+     * \brief Checks if calculateFiles should batch a file rather than pass it to calculateCrc
+     * \param size File size
+     * \return True for files up to the small file limit, of any hash type
+     */
+    [[nodiscard]] bool batched(const unsigned long long int size) const {
+        return size <= m_SmallFileLimit;
+    }
+
+    /**
+     * \brief Formats a finished hash the way it is written to the SFV
+     * \param hasher State after all data was added
+     * \return Upper case hex string for the CRCs (8 or 16 characters), lower case like md5sum for checksum lists
+     */
+    [[nodiscard]] static std::string digestString(const Hasher& hasher);
+
+    /**
+     * \brief Checks if a hash is one of the error messages returned in its place
+     * \param hash Hash from calculateCrc, calculateHashes or calculateFiles
+     * \return True for "openError", "sizeError" and "readError"
+     */
+    [[nodiscard]] static bool hashFailed(const std::string& hash) {
+        return hash == "openError" || hash == "sizeError" || hash == "readError";
+    }
 
     /**
      * \brief Marks the processing has completed
@@ -82,30 +274,86 @@ private:
     bool b_HasProcessed = false;
     bool b_CanRun = true;
     unsigned int m_Threads = 0;
+    IoEngine m_IoEngine = IoEngine::Mmap;
+    MapPolicy m_MapPolicy;
+    bool b_Scrub = false;
+    unsigned long long int m_SmallFileLimit = default_small_file_limit;
+    /**
+     * \brief Gets the map policy in use
+     * \return setMapPolicy() policy, made cache neutral in scrub mode
+     */
+    [[nodiscard]] MapPolicy mapPolicy() const {
+        MapPolicy policy = m_MapPolicy;
+        policy.cache_neutral = policy.cache_neutral || b_Scrub;
+        return policy;
+    }
+    /**
+     * \brief Gets the thread count
+     * \return setThreadCount() count, or the core count for zero
+     */
+    [[nodiscard]] unsigned int threadCount() const;
+    /**
+     * \brief Read buffer of calculateCrcs, reused between calls. Only grows, and is never zero filled
+     */
+    struct BatchBuffer {
+        std::unique_ptr<char[]> data;
+        size_t size = 0;
+    };
+    /**
+     * \brief Calculates several hashes of several files at once with the multi-buffer kernels, each file is read once
+     * \param file_paths Target files, a thread per small_file_batch of them
+     * \param file_sizes Size of each file, as found by DeviceGroups::split
+     * \param types Hash types
+     * \param buffer Grown to the size of each file, up to m_SmallFileLimit, reused between calls
+     * \return Hash per file and type as string, [file][type]
+     * \note Each thread streams its files through the buffer, m_SmallFileLimit bytes per file at a time. A small file costs an
+     *       open, a read and a close, there is no mapping or thread per file, and a file's hash only uses one SIMD lane
+     */
+    [[nodiscard]] std::vector<std::vector<std::string>> calculateCrcs(const std::vector<std::string>& file_paths, const std::vector<unsigned long long int>& file_sizes,
+                                                                    const std::vector<HashType>& types, BatchBuffer& buffer) const;
+    /**
+     * \brief Hashes one thread's share of a calculateCrcs call
+     * \param file_paths First file
+     * \param file_sizes Size of the first file
+     * \param count Number of files, up to small_file_batch
+     * \param types Hash types, every piece read is passed to each of them
+     * \param buffers Read buffer of each file, the size of the file up to m_SmallFileLimit
+     * \param results Hash per file and type as string
+     */
+    void calculateCrcGroup(const std::string* file_paths, const unsigned long long int* file_sizes, size_t count, const std::vector<HashType>& types, char* const* buffers, std::vector<std::string>* results) const;
+    /**
+     * \brief Hashes a file with the streaming reader of m_IoEngine (UringReader or PreadReader), one reader per thread, each
+     *        reading its own part of the file
+     * \param file_path Target file
+     * \param file_size File size
+     * \param threads Readers
+     * \param hasher Set to the state of the whole file
+     * \return False if the reader can't read the file, calculateCrc falls back to mmap
+     */
+    bool calculateCrcStreamed(const std::string& file_path, unsigned long long int file_size, unsigned int threads, Hasher& hasher) const;
     /**
-     * \brief Generates a CRC hash based on data
-     * \param data File File data as char* 
-     * \param num_bytes Number of bytes left
-     * \param max_block_size Max target block size
-     * \return CRC as unsigned int
-     * \note Simply put. This function is self recursive. \n It calculates what if should process, hands the rest of the data to a another async-ed version of itself. \n Then processes a chunk of the data. Combining it with the response from the async-ed version.
+     * \brief Reads part of a file with the streaming reader of m_IoEngine, io_uring readers are reused between calls
+     * \param file_path Target file
+     * \param offset First byte
+     * \param length Bytes to read, the range must lie inside the file
+     * \param consume Called with each block in order, on this thread
+     * \return False if the reader can't read the range
      */
-    static unsigned int asyncChunkCrc(const char* data, unsigned int num_bytes, unsigned int max_block_size);
-    static constexpr size_t buffer_size = 20*4096;
+    bool readStreamed(const std::string& file_path, unsigned long long int offset, unsigned long long int length, const std::function<void(const char*, size_t)>& consume) const;
     /**
-     * \brief If the file size is over 3.899999894 GB we change the file in chunks
+     * \brief Largest piece of a file hashed by one task of calculateCrcChunked. At most one chunk per thread is mapped at a time
      */
-    static constexpr unsigned long long int file_limit = 4187593000;  // 3.899999894 gb
+    static constexpr unsigned long long int max_chunk_size = 64ull << 20;
     /**
-     * \brief Opens a file in memory map and processes the chunk
-     * \param file_path Target File
-     * \param offset File offset
-     * \param num_bytes Number of bytes left
-     * \param max_block_size Max target block size
-     * \return CRC as unsigned int
-     * \note Edited version of asyncChunkCrc just for memory mapped files
+     * \brief Hashes a file on several threads, which take fixed size chunks of it in turn and map only the chunk they hash
+     * \param file_path Target file
+     * \param file_size File size
+     * \param threads Threads
+     * \return State of the whole file
+     * \note Offsets are 64 bit throughout and the mapped total stays under threads * max_chunk_size, so multi-terabyte files
+     *       hash at full speed without using up the address space. Chunks are combined in order as soon as the ones before them are done
      */
-    static unsigned int asyncChunkCrcMmap(const std::string& file_path, unsigned long long int offset, unsigned long long int num_bytes, unsigned int max_block_size);
+    [[nodiscard]] Hasher calculateCrcChunked(const std::string& file_path, unsigned long long int file_size, unsigned int threads) const;
 
     // https://johnnylee-sde.github.io/Fast-unsigned-integer-to-hex-string/
     static uint32_t toHex(uint64_t num, char *s, bool lower_alpha);
@@ -8,10 +8,13 @@
 #ifndef SFVARCHIVING_SFV_READER_H
 #define SFVARCHIVING_SFV_READER_H
 
+#include <algorithm>
+#include <cctype>
 #include <iostream>
 #include <filesystem>
 #include <fstream>
 #include <future>
+#include <vector>
 #include <sfv/SFVCommon.h>
 
 class SFVReader final : public SFV {
@@ -43,15 +46,19 @@ public:
             return;
         }
 
-        unsigned int lines = 0;
+        // md5sum, sha256sum, b3sum and xxhsum files don't name their hash, the extension does
+        for (const auto type : {HashType::MD5, HashType::SHA256, HashType::BLAKE3, HashType::XXH3, HashType::XXH128}) {
+            if (m_FilePath.extension() == fileExtension(type)) m_HashType = type;
+        }
+
         // Reads each line then processes
         while(getline(file, line)) {
             readLine(line);
-            lines++;
         }
+        checkFiles();
 
-        // Print results
-        if (lines == m_Passed) {logResult(LogType::CompletedPerfect, std::to_string(lines));}
+        // Print results. Comment lines (e.g the hash header) aren't counted
+        if (m_Failed == 0) {logResult(LogType::CompletedPerfect, std::to_string(m_Passed));}
         else {
             logResult(LogType::Completed,"Completed with " + std::to_string(m_Passed) + " passes and " + std::to_string(m_Failed) + " fails.");
             for (const auto& s : m_FailedItemsStrings) {
@@ -60,6 +67,16 @@ public:
         }
         finishedProcessing();
     }
+
+    /**
+     * \brief Gets the number of files whose hash matched the SFV, after process()
+     */
+    [[nodiscard]] unsigned int passed() const {return m_Passed;}
+
+    /**
+     * \brief Gets the number of files whose hash didn't match or couldn't be calculated, after process()
+     */
+    [[nodiscard]] unsigned int failed() const {return m_Failed;}
 private:
 
     /**
@@ -67,28 +84,68 @@ private:
      * \param line File line as string
      */
     void readLine(std::string line) {
-        if (line[0] == ';') {return;} // Ignore comments
+        if (!line.empty() && line.back() == '\r') line.pop_back(); // Written on Windows
+        if (line.empty()) return;
+        if (line[0] == ';') { // Comments, except the one naming the hash
+            checkFiles(); // Queued files use the hash they were listed under
+            if (line.rfind(hash_header, 0) == 0 && !hashTypeFromName(line.substr(std::string(hash_header).size()), m_HashType)) {
+                logResult(LogType::Error, "Unknown hash in header : " + line);
+            }
+            return;
+        }
 
-        // Cleans up the line
-        const auto file = line.substr(0, line.find(' '));
-        line.erase(0, file.size()+1);
+        std::string file;
+        std::string original_hash;
+        if (checksumList(m_HashType)) {
+            // md5sum layout, "<hash>  <file>" or "<hash> *<file>" for binary mode. The file name may contain spaces
+            if (line[0] == '#') return;
+            const size_t split = line.find(' ');
+            if (split == std::string::npos || split + 2 > line.size()) {
+                logResult(LogType::Error, "Malformed line : " + line);
+                return;
+            }
+            original_hash = line.substr(0, split);
+            if (original_hash.rfind(checksumPrefix(m_HashType), 0) == 0) original_hash.erase(0, checksumPrefix(m_HashType).size());
+            std::transform(original_hash.begin(), original_hash.end(), original_hash.begin(), [](const unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            file = line.substr(split + 2);
+        } else {
+            // Cleans up the line
+            file = line.substr(0, line.find(' '));
+            line.erase(0, file.size()+1);
 
-        // Pre added for when MD5 support is added
-        if (m_HashType == HashType::MD5) {
-            line.erase(0, 1);
+            // Stores the original hash
+            original_hash = line;
         }
 
         // Makes the file relative path
         std::string full_file_path = m_FilePath.string();
         full_file_path.erase(full_file_path.find(m_FilePath.filename().string()), m_FilePath.filename().string().size());
-
-        // Stores the original hash
-        const std::string original_hash = line;
         full_file_path += file;
 
-        // Stores the new hash
-        const std::string hash = calculateCrc(full_file_path);
+        // Hashed together with the rest of the section, so every disk is read at once
+        m_Queued.push_back(QueuedFile{file, full_file_path, original_hash});
+    }
 
+    /**
+     * \brief Hashes the queued files and compares them, in SFV order
+     */
+    void checkFiles() {
+        if (m_Queued.empty()) return;
+        std::vector<std::string> paths;
+        for (const auto& queued_file : m_Queued) paths.push_back(queued_file.path);
+        calculateFiles(paths, {m_HashType}, [&](const size_t file, std::vector<std::string>& hashes) {
+            checkResult(m_Queued[file].file, m_Queued[file].original_hash, hashes.front());
+        });
+        m_Queued.clear();
+    }
+
+    /**
+     * \brief Compares a new hash with the one in the SFV and logs the result
+     * \param file File as named in the SFV
+     * \param original_hash Hash from the SFV
+     * \param hash New hash
+     */
+    void checkResult(const std::string& file, const std::string& original_hash, const std::string& hash) {
         if (hash == "openError") std::cout << "[Failed to open] " << file << "\n";
 
         // Compares hashes
@@ -98,13 +155,20 @@ private:
             m_Passed++;
         } else {
             // Bad
-            std::string message = file + " - CRC mismatch. Original: " + original_hash + " New: " + hash;
+            std::string message = file + (checksumList(m_HashType) ? " - " + hashName(m_HashType) + " mismatch. Original: " : " - CRC mismatch. Original: ") + original_hash + " New: " + hash;
             m_FailedItemsStrings.emplace_back(message);
             logResult(LogType::Failed, message);
             m_Failed++;
         }
     }
 
+    struct QueuedFile {
+        std::string file;
+        std::string path;
+        std::string original_hash;
+    };
+    std::vector<QueuedFile> m_Queued; // Lines of the current hash type, waiting for checkFiles
+
     unsigned int m_Passed = 0;
     unsigned int m_Failed = 0;
 
@@ -9,6 +9,10 @@
 #define SFV_ARCHIVING_SFV_WRITER_H
 
 #include <sfv/SFVCommon.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <vector>
 
 class SFVWriter final : public SFV {
 public:
@@ -24,6 +28,24 @@ public:
         }
     }
 
+    /**
+     * \brief Sets the hashes to write, one file each. The data is read once for all of them
+     * \param types Hash types, e.g CRC, MD5 and SHA256 for a .sfv, a .md5 and a .sha256. Their file extensions must differ
+     */
+    void setHashTypes(const std::vector<HashType>& types) {
+        for (size_t i = 0; i < types.size(); ++i) {
+            for (size_t j = 0; j < i; ++j) {
+                if (fileExtension(types[i]) == fileExtension(types[j])) {
+                    logResult(LogType::Critical, hashName(types[i]) + " and " + hashName(types[j]) + " would both be written to a " + fileExtension(types[i]) + " file");
+                    b_Error = true;
+                }
+            }
+        }
+        if (types.empty()) return;
+        setHashType(types.front());
+        m_HashTypes = types;
+    }
+
     /**
      * \brief Creates a SFV file based on the target
      */
@@ -31,33 +53,55 @@ public:
         if (!preProcess()) {return;}
 
         // If folder
+        std::vector<std::string> files;
         if (is_directory(m_Path) && !is_empty(m_Path)) {
             for (auto & entry : std::filesystem::recursive_directory_iterator(m_Path ))
             {
                 if (b_Error) break;
                 if (is_regular_file( entry ))
-                    calculateFile(entry.path().string(), m_Path.string() );
+                    files.push_back(entry.path().string());
             }
         }
 
         // If file
-        if (is_regular_file(m_Path)) calculateFile(m_Path.string());
+        if (is_regular_file(m_Path)) files.push_back(m_Path.string());
+
+        // Every disk the files are on is read at once, the lines stay in directory order
+        calculateFiles(files, hashTypes(), [&](const size_t file, std::vector<std::string>& hashes) {
+            if (std::any_of(hashes.begin(), hashes.end(), hashFailed)) {
+                logResult(LogType::Failed, files[file]);
+                b_Error = true;
+            } else {
+                m_SFVLines.emplace_back(SFVLine{files[file], std::move(hashes)});
+                logResult(LogType::Processed, files[file]);
+            }
+        });
 
         if (b_Error || m_SFVLines.empty()) return;
 
-        // Creates file name for the SFV file
-        std::string pathname = m_Path.string();
-        pathname.erase(pathname.find(m_Path.extension().string()), m_Path.extension().string().size());
-        pathname += ".sfv";
+        const std::vector<HashType> types = hashTypes();
+        for (size_t type_index = 0; type_index < types.size(); ++type_index) {
+            const HashType type = types[type_index];
+
+            // Creates file name for the SFV file
+            std::string pathname = m_Path.string();
+            pathname.erase(pathname.find(m_Path.extension().string()), m_Path.extension().string().size());
+            pathname += fileExtension(type);
 
-        if (std::ofstream file(pathname); file.good() || !file.fail())
-        {
-            // Populates the new SFV file with our results
-            for (const auto& [file_str, crc_str] : m_SFVLines) {
-                file << file_str.c_str() << " " << crc_str.c_str() << std::endl;
+            if (std::ofstream file(pathname); file.good() || !file.fail())
+            {
+                // Names the hash for the reader, plain CRC SFV files stay compatible with other tools
+                if (type != HashType::CRC && !checksumList(type)) {
+                    file << hash_header << hashName(type) << std::endl;
+                }
+                // Populates the new SFV file with our results. Checksum lists use the md5sum layout ("<hash>  <file>")
+                for (const auto& [file_str, hashes] : m_SFVLines) {
+                    if (checksumList(type)) file << checksumPrefix(type) << hashes[type_index].c_str() << "  " << file_str.c_str() << std::endl;
+                    else file << file_str.c_str() << " " << hashes[type_index].c_str() << std::endl;
+                }
+                file.close();
+                logResult(LogType::Completed, "File written to " + pathname);
             }
-            file.close();
-            logResult(LogType::Completed, "File written to " + pathname);
         }
 
         finishedProcessing();
@@ -65,26 +109,20 @@ public:
 
 private:
 
-	/**
-     * \brief Calculates the hash for a file then stores in the line list
-     * \param file target file
-     * \param dir Currently Unused
+    /**
+     * \brief Gets the hashes to write
+     * \return setHashTypes() types, else the setHashType() one
      */
-    void calculateFile(const std::string& file, const std::string& dir = "") {
-	    if (const std::string crc = calculateCrc(file); crc == "error") {
-            logResult(LogType::Failed, file);
-            b_Error = true;
-        } else {
-            m_SFVLines.emplace_back(SFVLine{file, crc});
-            logResult(LogType::Processed, file);
-        }
+    [[nodiscard]] std::vector<HashType> hashTypes() const {
+        return m_HashTypes.empty() ? std::vector<HashType>{m_HashType} : m_HashTypes;
     }
 
     struct SFVLine {
         std::string file;
-        std::string crc;
+        std::vector<std::string> hashes; // One per hashTypes() entry
     };
     std::filesystem::path m_Path;
+    std::vector<HashType> m_HashTypes;
     std::vector<SFVLine> m_SFVLines;
     bool b_Error = false;
 };
@@ -0,0 +1,92 @@
+/**
+ *  @file   TuningProfile.h
+ *  @brief  Per host hashing parameters, measured by --calibrate and cached in a profile file
+ ***********************************************/
+
+#ifndef SFVARCHIVING_TUNING_PROFILE_H
+#define SFVARCHIVING_TUNING_PROFILE_H
+#include <cstddef>
+#include <filesystem>
+#include <ostream>
+#include <string>
+
+/**
+ * \brief CRC kernel, prefetch distance and block sizes used by SFV::calculateCrc and SFV::calculateHashes
+ * \note The profile file is plain "key=value" lines. It is ignored if it was calibrated on a different CPU model
+ */
+class TuningProfile {
+public:
+    /**
+     * \brief Built-in defaults, used when there is no profile
+     */
+    TuningProfile() = default;
+
+    /**
+     * \brief Gets the profile of this host
+     * \return Profile loaded from path() on first use, or the defaults. Its CRC kernel is applied on load
+     */
+    static const TuningProfile& get();
+
+    /**
+     * \brief Sets the profile file, must be called before the first get()
+     * \param path Profile file
+     */
+    static void setPath(const std::filesystem::path& path);
+
+    /**
+     * \brief Gets the profile file
+     * \return The setPath() path, else sfvArchiving/profile in $XDG_CACHE_HOME, ~/.cache or %LOCALAPPDATA%
+     */
+    static std::filesystem::path path();
+
+    /**
+     * \brief Micro-benchmarks the candidate settings on the running machine
+     * \param log Progress and results
+     * \return Fastest settings
+     */
+    static TuningProfile calibrate(std::ostream& log);
+
+    /**
+     * \brief Reads a profile file
+     * \param file Profile file
+     * \return If the file exists, parses and was made on this CPU model
+     */
+    bool load(const std::filesystem::path& file);
+
+    /**
+     * \brief Writes the profile file, creating its folder if needed
+     * \param file Profile file
+     * \return If it was written
+     */
+    [[nodiscard]] bool save(const std::filesystem::path& file) const;
+
+    /**
+     * \brief Makes crc32_fast use the profile's kernel and prefetch distance
+     */
+    void apply() const;
+
+    /**
+     * \brief CRC32 kernel name as listed by --crc-kernels, empty for the fastest one for this CPU
+     */
+    [[nodiscard]] const std::string& kernel() const {return m_Kernel;}
+    /**
+     * \brief prefetchAhead of the 16bytes_prefetch kernel
+     */
+    [[nodiscard]] size_t prefetchAhead() const {return m_PrefetchAhead;}
+    /**
+     * \brief Bytes passed to each hash at a time when several hashes share one read of a file
+     */
+    [[nodiscard]] size_t bufferSize() const {return m_BufferSize;}
+    /**
+     * \brief Smallest block handed to a thread, files below twice this size use fewer threads. Zero splits evenly
+     */
+    [[nodiscard]] size_t minBlockSize() const {return m_MinBlockSize;}
+
+private:
+    std::string m_Kernel;
+    size_t m_PrefetchAhead = 256;
+    size_t m_BufferSize = 20*4096;
+    size_t m_MinBlockSize = 0;
+};
+
+#endif //SFVARCHIVING_TUNING_PROFILE_H
@@ -0,0 +1,110 @@
+/**
+ *  @file   UringReader.h
+ *  @brief  Reads files through io_uring, a queue of direct reads into registered buffers
+ ***********************************************/
+
+#ifndef SFVARCHIVING_URING_READER_H
+#define SFVARCHIVING_URING_READER_H
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <system_error>
+
+/**
+ * \brief Streams a range of a file through an io_uring ring
+ * \note Linux only, talks to the kernel with raw syscalls so there is no liburing dependency. \n
+ *       queue_depth reads of block_size bytes are kept in flight with O_DIRECT, each into its own registered buffer,
+ *       and finished blocks are handed out in file order while the later ones are still being read. \n
+ *       Falls back to buffered reads where O_DIRECT can't open the file, and to plain reads if the buffers can't be registered. \n
+ *       A reader can read any number of ranges one after another, keeping its ring and buffers between them
+ */
+class UringReader {
+public:
+    /**
+     * \brief Bytes per read, also the alignment of ranges passed to read() for O_DIRECT
+     */
+    static constexpr size_t block_size = size_t(1) << 20;
+    /**
+     * \brief Reads in flight
+     */
+    static constexpr unsigned int queue_depth = 16;
+
+    /**
+     * \brief Sets up the ring and its buffers
+     * \note Check ok() before use, io_uring may be missing or blocked (e.g by seccomp)
+     */
+    UringReader();
+    ~UringReader();
+    UringReader(const UringReader&) = delete; // Block all copies and moves
+    UringReader(UringReader&&) = delete;
+    UringReader& operator= ( const UringReader & ) = delete;
+    UringReader& operator= ( UringReader && ) = delete;
+
+    /**
+     * \brief Checks if io_uring works on this system, probed once
+     * \return If a ring could be set up
+     */
+    static bool available();
+
+    /**
+     * \brief Checks if the ring was set up, and is still usable
+     * \note A reader stops being ok() if its reads couldn't be waited for. Its ring and buffers are then leaked, as the kernel
+     *       may still write to them
+     */
+    [[nodiscard]] bool ok() const {return m_RingFd >= 0 && !b_Abandoned;}
+
+    /**
+     * \brief Reads part of a file and hands it out block by block, in order
+     * \param file_path Target file
+     * \param offset First byte, a multiple of block_size keeps O_DIRECT
+     * \param length Bytes to read, the range must lie inside the file
+     * \param consume Called with each block, on this thread. The data is only valid during the call. If it throws, the reads
+     *        in flight are waited for before the exception is passed on
+     * \param error Set on failure
+     * \return If every byte was read and consumed
+     */
+    bool read(const std::string& file_path, uint64_t offset, uint64_t length, const std::function<void(const char*, size_t)>& consume, std::error_code& error);
+
+private:
+    /**
+     * \brief Queues a read of one block into its buffer
+     * \param block Block index in the range being read
+     * \param done Bytes of the block already read, after a short read
+     */
+    void queueRead(uint64_t block, size_t done);
+    /**
+     * \brief Submits the queued reads and waits for at least wait_for completions
+     * \return Negative errno on failure
+     */
+    int submitAndWait(unsigned int wait_for);
+
+    int m_RingFd = -1;
+    int m_FileFd = -1;
+    bool b_Registered = false;
+    bool b_Direct = false; // m_FileFd was opened with O_DIRECT
+    bool b_Abandoned = false; // Gave up waiting for reads in flight
+    uint64_t m_Offset = 0; // Range being read
+    uint64_t m_Length = 0;
+    unsigned int m_Queued = 0; // Not submitted yet
+
+    // Shared with the kernel
+    void* m_SqRing = nullptr;
+    void* m_CqRing = nullptr;
+    size_t m_SqRingSize = 0;
+    size_t m_CqRingSize = 0;
+    void* m_Sqes = nullptr;
+    size_t m_SqesSize = 0;
+    unsigned int* m_SqHead = nullptr;
+    unsigned int* m_SqTail = nullptr;
+    unsigned int* m_SqMask = nullptr;
+    unsigned int* m_SqArray = nullptr;
+    unsigned int* m_CqHead = nullptr;
+    unsigned int* m_CqTail = nullptr;
+    unsigned int* m_CqMask = nullptr;
+    void* m_Cqes = nullptr;
+
+    char* m_Buffers = nullptr; // queue_depth * block_size, block b uses buffer b % queue_depth
+};
+
+#endif //SFVARCHIVING_URING_READER_H
@@ -0,0 +1,153 @@
+/**
+ *  @file   CpuFeatures.h
+ *  @brief  Detects the instruction set extensions of the running CPU
+ ***********************************************/
+
+#ifndef SFVARCHIVING_CPU_FEATURES_H
+#define SFVARCHIVING_CPU_FEATURES_H
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SFV_CPU_X86
+#elif defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#define SFV_CPU_X86
+#endif
+
+#ifdef SFV_CPU_X86
+// GCC 12's _mm512_undefined_* helpers read an uninitialised register on purpose, which warns in every inlined AVX-512 intrinsic
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#endif
+#include <immintrin.h>
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+// Kernels are compiled per function for the extensions they use (no global -mavx2 etc.), callers check CpuFeatures first
+#if defined(__GNUC__) || defined(__clang__)
+#define SFV_TARGET(features) __attribute__((target(features)))
+#else
+#define SFV_TARGET(features)
+#endif
+#include <cstring>
+#include <string>
+
+class CpuFeatures {
+public:
+    CpuFeatures(const CpuFeatures&) = delete; // Block all copies and moves
+    CpuFeatures(CpuFeatures&&) = delete;
+    CpuFeatures& operator= ( const CpuFeatures & ) = delete;
+    CpuFeatures& operator= ( CpuFeatures && ) = delete;
+
+    /**
+     * \brief Gets the features of the running CPU
+     * \return Features, detected once on first use
+     */
+    static const CpuFeatures& get() {
+        static const CpuFeatures features;
+        return features;
+    }
+
+    [[nodiscard]] bool sse41() const {return b_Sse41;}
+    [[nodiscard]] bool sse42() const {return b_Sse42;}
+    [[nodiscard]] bool pclmul() const {return b_Pclmul;}
+    /**
+     * \brief AVX2, only true if the OS saves the YMM registers
+     */
+    [[nodiscard]] bool avx2() const {return b_Avx2;}
+    /**
+     * \brief SHA-1 and SHA-256 extensions (SHA-NI)
+     */
+    [[nodiscard]] bool sha() const {return b_Sha;}
+    /**
+     * \brief AVX-512 Foundation + VL, only true if the OS saves the ZMM and opmask registers
+     */
+    [[nodiscard]] bool avx512() const {return b_Avx512;}
+    /**
+     * \brief 512 bit carry-less multiplication, only true if avx512() is
+     */
+    [[nodiscard]] bool vpclmulqdq() const {return b_Vpclmulqdq;}
+    /**
+     * \brief Processor brand string (e.g "Intel(R) Core(TM) i9-10980HK CPU @ 2.40GHz"), "unknown" if the CPU doesn't report one
+     */
+    [[nodiscard]] const std::string& brand() const {return m_Brand;}
+
+private:
+    CpuFeatures() {
+#ifdef SFV_CPU_X86
+        unsigned int regs[4] = {0, 0, 0, 0}; // eax, ebx, ecx, edx
+        cpuid(0, regs);
+        const unsigned int max_leaf = regs[0];
+
+        cpuid(1, regs);
+        b_Pclmul = (regs[2] & (1u << 1)) != 0;
+        b_Sse41  = (regs[2] & (1u << 19)) != 0;
+        b_Sse42  = (regs[2] & (1u << 20)) != 0;
+
+        // Wide registers are only usable if the OS saves them on context switches
+        const bool os_xsave = (regs[2] & (1u << 27)) != 0;
+        const unsigned long long xcr0 = os_xsave ? xgetbv() : 0;
+        const bool os_ymm = (xcr0 & 0x06) == 0x06; // SSE and AVX state
+        const bool os_zmm = (xcr0 & 0xE6) == 0xE6; // SSE, AVX, opmask, ZMM0-15 and ZMM16-31 state
+
+        if (max_leaf >= 7) {
+            cpuid(7, regs);
+            b_Avx2 = os_ymm && (regs[1] & (1u << 5)) != 0;
+            b_Sha = b_Sse41 && (regs[1] & (1u << 29)) != 0;
+            const bool avx512f  = (regs[1] & (1u << 16)) != 0;
+            const bool avx512vl = (regs[1] & (1u << 31)) != 0;
+            b_Avx512 = os_zmm && avx512f && avx512vl;
+            b_Vpclmulqdq = b_Avx512 && (regs[2] & (1u << 10)) != 0;
+        }
+
+        cpuid(0x80000000, regs);
+        if (regs[0] >= 0x80000004) {
+            char brand[49] = {};
+            for (unsigned int leaf = 0; leaf < 3; ++leaf) {
+                cpuid(0x80000002 + leaf, regs);
+                std::memcpy(brand + 16 * leaf, regs, sizeof(regs));
+            }
+            m_Brand = brand;
+            m_Brand.erase(0, m_Brand.find_first_not_of(' '));
+        }
+#endif
+    }
+    ~CpuFeatures() = default;
+
+#ifdef SFV_CPU_X86
+    static void cpuid(const unsigned int leaf, unsigned int regs[4]) {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuidex(info, static_cast<int>(leaf), 0);
+        for (int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned int>(info[i]);
+#else
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    static unsigned long long xgetbv() {
+#ifdef _MSC_VER
+        return _xgetbv(0);
+#else
+        unsigned int eax, edx;
+        __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+    }
+#endif
+
+    bool b_Sse41 = false;
+    bool b_Sse42 = false;
+    bool b_Pclmul = false;
+    bool b_Avx2 = false;
+    bool b_Sha = false;
+    bool b_Avx512 = false;
+    bool b_Vpclmulqdq = false;
+    std::string m_Brand = "unknown";
+};
+
+#endif //SFVARCHIVING_CPU_FEATURES_H
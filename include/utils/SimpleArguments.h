@@ -8,6 +8,9 @@
 #ifndef SFVARCHIVING_SIMPLEARGUMENTS_H
 #define SFVARCHIVING_SIMPLEARGUMENTS_H
 
+#include <algorithm>
+#include <iostream>
+#include <string>
 #include <vector>
 
 class SimpleArguments {
@@ -6,19 +6,46 @@
 #define SFV_READ_WRITE
 
 #include <iostream>
+#include <sstream>
+#include <crc/Crc32.h>
 #include <sfv/SFVReader.h>
 #include <sfv/SFVWriter.h>
+#include <sfv/PreadReader.h>
+#include <sfv/TuningProfile.h>
+#include <sfv/UringReader.h>
 #include <utils/SimpleArguments.h>
 #include <utils/Timer.h>
 
 void print_help() {
     std::cout << "sfv archiver" << "\n";
 #if defined(SFV_READ_WRITE) || defined(SFV_READ_ONLY)
-    std::cout << "--readSFV read SFV file" << "\n";
+    std::cout << "--readSFV read SFV, .md5, .sha256, .blake3, .xxh3 or .xxh128 file" << "\n";
 #endif
 #if defined(SFV_READ_WRITE) || defined(SFV_WRITE_ONLY)
     std::cout << "--writeSFV create a SFV file" << "\n";
 #endif
+    std::cout << "--hash <crc32|crc32c|crc64|md5|sha256|blake3|xxh3|xxh128> hash used when writing (all but the CRCs write checksum lists named after the hash, e.g .sha256), readers follow the SFV header" << "\n";
+    std::cout << "--hash <name>,<name>,... write several hashes from one read of the data, one file each (e.g --hash crc32,md5,sha256)" << "\n";
+    std::cout << "-t <count> thread count (0 = all cores)" << "\n";
+    std::cout << "--io <mmap|uring|pread> how large files are read, uring uses io_uring direct reads, pread a reader thread ahead of the hashing (for FUSE or network mounts). Both fall back to mmap where they can't run" << "\n";
+    std::cout << "--map-policy <hints> kernel hints for mapped files, comma separated from sequential, willneed, populate, hugepage, dontneed and neutral, or none (default " << MapPolicy().names() << ")" << "\n";
+    std::cout << "--scrub leave the page cache as it was: pages read only for hashing are dropped again, pages other programs had cached stay" << "\n";
+    std::cout << "--small-files <bytes> files up to this size are read into a shared buffer and hashed in batches instead of being mapped (default " << SFV::default_small_file_limit << ")" << "\n";
+    std::cout << "-r only print the final results" << "\n";
+    std::cout << "--crc-kernel <name> force a CRC kernel instead of the fastest one for this CPU" << "\n";
+    std::cout << "--crc-kernels list the CRC kernels" << "\n";
+    std::cout << "--calibrate measure the fastest kernel and buffer sizes for this machine and save them to the profile" << "\n";
+    std::cout << "--profile <path> profile file (default " << TuningProfile::path().string() << ")" << "\n";
+}
+
+void print_crc_kernels() {
+    size_t count;
+    const Crc32Kernel* kernels = crc32_kernels(&count);
+    const std::string selected = crc32_selected_kernel();
+    for (size_t i = 0; i < count; ++i) {
+        const bool supported = kernels[i].supported == nullptr || kernels[i].supported();
+        std::cout << (selected == kernels[i].name ? "* " : "  ") << kernels[i].name << (supported ? "" : " (unsupported)") << "\n";
+    }
 }
 
 int main(int argc, char* argv[]) {
@@ -30,6 +57,7 @@ int main(int argc, char* argv[]) {
     SimpleArguments simple_args(argc, argv);
 
     bool log_only_final_results = simple_args.find("-r");
+    const bool scrub = simple_args.find("--scrub");
 
     unsigned int thread_count = 0;
 
@@ -37,12 +65,90 @@ int main(int argc, char* argv[]) {
         thread_count = std::stoi(simple_args.findAfter("-t"));
     }
 
+    unsigned long long int small_file_limit = SFV::default_small_file_limit;
+    if (simple_args.find("--small-files")) {
+        small_file_limit = std::stoull(simple_args.findAfter("--small-files"));
+    }
+
+    // Comma separated, the first one is used when reading
+    std::vector<SFV::HashType> hash_types{SFV::HashType::CRC};
+    if (simple_args.find("--hash")) {
+        hash_types.clear();
+        std::stringstream names(simple_args.findAfter("--hash"));
+        for (std::string name; std::getline(names, name, ',');) {
+            if (!SFV::hashTypeFromName(name, hash_types.emplace_back())) {
+                std::cout << "[Critical Error] Unknown hash : " << name << "\n";
+                return 1;
+            }
+        }
+        if (hash_types.empty()) {
+            std::cout << "[Critical Error] No hash given" << "\n";
+            return 1;
+        }
+    }
+    const SFV::HashType hash_type = hash_types.front();
+
+    SFV::IoEngine io_engine = SFV::IoEngine::Mmap;
+    if (simple_args.find("--io")) {
+        if (const std::string engine = simple_args.findAfter("--io"); engine == "uring") {
+            io_engine = SFV::IoEngine::Uring;
+            if (!UringReader::available()) std::cout << "[Error] io_uring isn't available, reading with mmap" << "\n";
+        } else if (engine == "pread") {
+            io_engine = SFV::IoEngine::Pread;
+            if (!PreadReader::available()) std::cout << "[Error] pread isn't available, reading with mmap" << "\n";
+        } else if (engine != "mmap") {
+            std::cout << "[Critical Error] Unknown IO engine : " << engine << "\n";
+            return 1;
+        }
+    }
+
+    MapPolicy map_policy;
+    if (simple_args.find("--map-policy") && !MapPolicy::fromNames(simple_args.findAfter("--map-policy"), map_policy)) {
+        std::cout << "[Critical Error] Unknown map policy : " << simple_args.findAfter("--map-policy") << "\n";
+        return 1;
+    }
+
+    if (simple_args.find("--profile")) {
+        TuningProfile::setPath(simple_args.findAfter("--profile"));
+    }
+
+    if (simple_args.find("--calibrate")) {
+        const TuningProfile profile = TuningProfile::calibrate(std::cout);
+        if (!profile.save(TuningProfile::path())) {
+            std::cout << "[Critical Error] Can't write profile : " << TuningProfile::path().string() << "\n";
+            return 1;
+        }
+        std::cout << "[Completed] Profile written to " << TuningProfile::path().string() << "\n";
+        return 0;
+    }
+
+    // Loads the calibrated settings, --crc-kernel still overrides the kernel
+    TuningProfile::get();
+
+    if (simple_args.find("--crc-kernels")) {
+        print_crc_kernels();
+        return 0;
+    }
+
+    if (simple_args.find("--crc-kernel")) {
+        if (const std::string kernel = simple_args.findAfter("--crc-kernel"); !crc32_select_kernel(kernel.c_str())) {
+            std::cout << "[Critical Error] Unknown or unsupported CRC kernel : " << kernel << "\n";
+            print_crc_kernels();
+            return 1;
+        }
+    }
+
     if (simple_args.count() == 1) {
-	    if (std::filesystem::path possible_sfv_file = simple_args.getFirst(); std::filesystem::is_regular_file(simple_args.getFirst()) && (possible_sfv_file.extension() == ".sfv")) {
+	    if (std::filesystem::path possible_sfv_file = simple_args.getFirst(); std::filesystem::is_regular_file(simple_args.getFirst()) && (possible_sfv_file.extension() == ".sfv" || possible_sfv_file.extension() == ".md5" || possible_sfv_file.extension() == ".sha256" || possible_sfv_file.extension() == ".blake3" || possible_sfv_file.extension() == ".xxh3" || possible_sfv_file.extension() == ".xxh128")) {
             Timer timer;
             timer.start();
             SFVReader sfv_reader(simple_args.findAfter("--readSFV"), log_only_final_results);
             sfv_reader.setThreadCount(thread_count);
+            sfv_reader.setIoEngine(io_engine);
+            sfv_reader.setMapPolicy(map_policy);
+            sfv_reader.setScrub(scrub);
+            sfv_reader.setSmallFileLimit(small_file_limit);
+            sfv_reader.setHashType(hash_type);
             sfv_reader.process();
             timer.stopAndPrint();
             return 0;
@@ -54,6 +160,11 @@ int main(int argc, char* argv[]) {
         timer.start();
         SFVReader sfv_reader(simple_args.findAfter("--readSFV"), log_only_final_results);
         sfv_reader.setThreadCount(thread_count);
+        sfv_reader.setIoEngine(io_engine);
+        sfv_reader.setMapPolicy(map_policy);
+        sfv_reader.setScrub(scrub);
+        sfv_reader.setSmallFileLimit(small_file_limit);
+        sfv_reader.setHashType(hash_type);
         sfv_reader.process();
         timer.stopAndPrint();
         return 0;
@@ -64,6 +175,11 @@ int main(int argc, char* argv[]) {
         timer.start();
         SFVWriter sfv_writer(simple_args.findAfter("--writeSFV"), log_only_final_results);
         sfv_writer.setThreadCount(thread_count);
+        sfv_writer.setIoEngine(io_engine);
+        sfv_writer.setMapPolicy(map_policy);
+        sfv_writer.setScrub(scrub);
+        sfv_writer.setSmallFileLimit(small_file_limit);
+        sfv_writer.setHashTypes(hash_types);
         sfv_writer.process();
         timer.stopAndPrint();
         return 0;
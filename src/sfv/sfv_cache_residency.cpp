@@ -0,0 +1,86 @@
+/**
+ *  @file   sfv_cache_residency.cpp
+ *  @brief  Page cache snapshots with mincore, and dropping the pages a read added
+ ***********************************************/
+
+#include <sfv/CacheResidency.h>
+#include <algorithm>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#define SFV_HAS_MINCORE
+#endif
+
+#ifdef SFV_HAS_MINCORE
+namespace {
+    size_t pageSize() {
+        static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        return page_size;
+    }
+
+    /**
+     * \brief Bytes mapped per mincore call, keeps the address space and the byte per page result small
+     */
+    constexpr uint64_t record_chunk = uint64_t(1) << 30;
+}
+
+void CacheResidency::record(const int fd, const uint64_t offset, const uint64_t length) {
+    const uint64_t page_size = pageSize();
+    m_FirstPage = offset / page_size;
+    const uint64_t end_page = (offset + length + page_size - 1) / page_size;
+    m_Resident.assign(end_page - m_FirstPage, false);
+
+    // Everything counts as new where the kernel can't tell, so the scrub still drops its own pages
+    std::vector<unsigned char> chunk_resident;
+    for (uint64_t page = m_FirstPage; page < end_page;) {
+        const uint64_t chunk_pages = std::min(record_chunk / page_size, end_page - page);
+        const auto chunk_length = static_cast<size_t>(chunk_pages * page_size);
+        void* mapping = mmap(nullptr, chunk_length, PROT_READ, MAP_SHARED, fd, static_cast<off_t>(page * page_size));
+        if (mapping != MAP_FAILED) {
+            chunk_resident.assign(chunk_pages, 0);
+#if defined(__APPLE__)
+            const int result = mincore(mapping, chunk_length, reinterpret_cast<char*>(chunk_resident.data()));
+#else
+            const int result = mincore(mapping, chunk_length, chunk_resident.data());
+#endif
+            munmap(mapping, chunk_length);
+            if (result == 0) {
+                for (uint64_t i = 0; i < chunk_pages; ++i) m_Resident[page - m_FirstPage + i] = (chunk_resident[i] & 1) != 0;
+            }
+        }
+        page += chunk_pages;
+    }
+}
+
+void CacheResidency::dropNew(const int fd, const uint64_t offset, const uint64_t length) const {
+#ifdef POSIX_FADV_DONTNEED
+    const uint64_t page_size = pageSize();
+    // Every page the part touches. A page shared with the next part may need reading again, which only costs time
+    uint64_t page = std::max(offset / page_size, m_FirstPage);
+    const uint64_t end_page = std::min((offset + length + page_size - 1) / page_size, m_FirstPage + m_Resident.size());
+    // One call per run of pages that weren't cached
+    while (page < end_page) {
+        if (m_Resident[page - m_FirstPage]) {
+            ++page;
+            continue;
+        }
+        const uint64_t first = page;
+        while (page < end_page && !m_Resident[page - m_FirstPage]) ++page;
+        posix_fadvise(fd, static_cast<off_t>(first * page_size), static_cast<off_t>((page - first) * page_size), POSIX_FADV_DONTNEED);
+    }
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+#else // No mincore, nothing is recorded or dropped
+
+void CacheResidency::record(int, uint64_t, uint64_t) {}
+
+void CacheResidency::dropNew(int, uint64_t, uint64_t) const {}
+
+#endif
@@ -38,6 +38,30 @@ void SFV::logResult(const LogType log, const std::string &message) const {
     std::cout << full_message;
 }
 
+std::string SFV::hashName(const HashType type) {
+    switch (type) {
+        case HashType::CRC: return "crc32";
+        case HashType::CRC32C: return "crc32c";
+        case HashType::CRC64: return "crc64";
+        case HashType::MD5: return "md5";
+        case HashType::SHA256: return "sha256";
+        case HashType::BLAKE3: return "blake3";
+        case HashType::XXH3: return "xxh3";
+        case HashType::XXH128: return "xxh128";
+    }
+    return "unknown";
+}
+
+bool SFV::hashTypeFromName(const std::string &name, HashType &type) {
+    for (const auto candidate : {HashType::CRC, HashType::CRC32C, HashType::CRC64, HashType::MD5, HashType::SHA256, HashType::BLAKE3, HashType::XXH3, HashType::XXH128}) {
+        if (name == hashName(candidate)) {
+            type = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
 uint32_t SFV::toHex(const uint64_t num, char *s, const bool lower_alpha)
 {
     uint64_t x = num;
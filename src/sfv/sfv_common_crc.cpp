@@ -6,16 +6,126 @@
  ***********************************************/
 
 #include <sfv/SFVCommon.h>
+#include <sfv/CacheResidency.h>
+#include <sfv/DeviceGroups.h>
+#include <sfv/MappedWindow.h>
+#include <sfv/PreadReader.h>
+#include <sfv/TuningProfile.h>
+#include <sfv/UringReader.h>
+#include <algorithm>
+#include <atomic>
+#include <barrier>
+#include <cstdio>
 #include <filesystem>
-#include <sstream>
-#include <crc/Crc32.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <thread>
 #include <future>
 #include <mio/mio.hpp>
+#include <stdexcept>
 
-std::string SFV::calculateCrc(const std::string &file_path) const
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#define SFV_HAS_POSIX_IO
+#endif
+
+namespace {
+    // Batched files are opened, read and closed with a syscall each. The size comes from DeviceGroups' stat, so there is
+    // no fstat, stdio buffer or read to find the end
+#ifdef SFV_HAS_POSIX_IO
+    using FileHandle = int;
+    constexpr FileHandle no_file = -1;
+
+    FileHandle openFile(const std::string& file_path) {
+        return open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+
+    void closeFile(const FileHandle file) {
+        close(file);
+    }
+
+    int descriptor(const FileHandle file) {
+        return file;
+    }
+
+    /**
+     * \brief Reads the next length bytes of a file, fewer only at its end
+     * \return Bytes read, -1 on errors
+     */
+    long long int readFile(const FileHandle file, char* buffer, const size_t length) {
+        size_t filled = 0;
+        while (filled < length) {
+            const ssize_t got = read(file, buffer + filled, length - filled);
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) return -1;
+            if (got == 0) break;
+            filled += static_cast<size_t>(got);
+        }
+        return static_cast<long long int>(filled);
+    }
+#else
+    using FileHandle = std::FILE*;
+    const FileHandle no_file = nullptr;
+
+    FileHandle openFile(const std::string& file_path) {
+        return std::fopen(file_path.c_str(), "rb");
+    }
+
+    void closeFile(const FileHandle file) {
+        std::fclose(file);
+    }
+
+    int descriptor(const FileHandle) {
+        return -1; // CacheResidency doesn't record off POSIX
+    }
+
+    long long int readFile(const FileHandle file, char* buffer, const size_t length) {
+        const size_t got = std::fread(buffer, 1, length, file);
+        return std::ferror(file) != 0 ? -1 : static_cast<long long int>(got);
+    }
+#endif
+
+    // Setting up a ring allocates and registers queue_depth blocks of buffers, which costs more than reading a small file.
+    // Readers go back to an idle list after each range and the next file's threads take them from there, until
+    // calculateFiles is done with its list and frees them
+    std::mutex idle_readers_mutex;
+    std::vector<std::unique_ptr<UringReader>> idle_readers;
+
+    std::unique_ptr<UringReader> takeReader() {
+        {
+            const std::lock_guard lock(idle_readers_mutex);
+            if (!idle_readers.empty()) {
+                std::unique_ptr<UringReader> reader = std::move(idle_readers.back());
+                idle_readers.pop_back();
+                return reader;
+            }
+        }
+        return std::make_unique<UringReader>();
+    }
+
+    void returnReader(std::unique_ptr<UringReader> reader) {
+        if (!reader->ok()) return; // Never set up, or its ring was given up with reads in flight
+        const std::lock_guard lock(idle_readers_mutex);
+        idle_readers.push_back(std::move(reader));
+    }
+
+    void releaseReaders() {
+        std::vector<std::unique_ptr<UringReader>> released;
+        {
+            const std::lock_guard lock(idle_readers_mutex);
+            released.swap(idle_readers);
+        }
+    }
+}
+
+std::string SFV::calculateCrc(const std::string &file_path, unsigned int threads) const
 {
-    unsigned int crc{ 0x0 };
+    if (threads == 0) threads = threadCount();
+    Hasher hasher(m_HashType);
     if (!std::filesystem::exists(file_path) || !std::filesystem::is_regular_file(file_path)) {
         logResult(LogType::Critical, file_path + "File doesn't exist or is not a regular file");
         return "openError";
@@ -27,96 +137,430 @@ std::string SFV::calculateCrc(const std::string &file_path) const
         return "sizeError";
     }
 
-    if (m_Threads == 1) { // NON MT
-        // Calculate chunks
-        unsigned int total_chunks = static_cast<unsigned>(file_size) / buffer_size;
-        unsigned int last_chunk_size = file_size % buffer_size;
-        last_chunk_size != 0 ? ++total_chunks : (last_chunk_size = buffer_size);
+    if (m_IoEngine != IoEngine::Mmap && calculateCrcStreamed(file_path, file_size, threads, hasher)) return digestString(hasher);
 
-        for (unsigned int chunk = 0; chunk < total_chunks; ++chunk)
-        {
-            unsigned int this_chunk_size;
-            if (chunk == total_chunks - 1) { this_chunk_size = last_chunk_size;}
-            else { this_chunk_size = buffer_size;}
-            const unsigned int offset = chunk * buffer_size;
-
-            std::error_code error; mio::mmap_source mmap;
-            mmap.map(file_path, offset, this_chunk_size, error);
-            if (error) { throw std::exception("mmap failed to map"); }
-            crc = crc32_16bytes_prefetch( mmap.data(), this_chunk_size, crc );
-        }
+    // MD5, SHA-256 and XXH3 can't merge the hashes of separate blocks, so they stream the file on this thread
+    if (threads == 1 || !Hasher::combinable(m_HashType)) { // NON MT
+        // Large windows, the kernel sees long runs and mapping costs a syscall pair per window
+        MappedWindow window(file_path, file_size, MappedWindow::default_window_size, mapPolicy());
+        std::error_code error;
+        while (window.next(error)) hasher.update(window.data(), window.size());
+        if (error) { throw std::runtime_error("mmap failed to map"); }
     } else { // MT
-        unsigned int numThreads = m_Threads;
-        if (m_Threads == 0) {
-            numThreads = std::thread::hardware_concurrency();
+        hasher = calculateCrcChunked(file_path, file_size, threads);
+    }
+
+    return digestString(hasher);
+}
+
+bool SFV::calculateCrcStreamed(const std::string &file_path, const unsigned long long file_size, const unsigned int threads, Hasher &hasher) const
+{
+    if (m_IoEngine == IoEngine::Uring ? !UringReader::available() : !PreadReader::available()) return false;
+
+    // Whole io_uring blocks per thread, so every range but the last stays aligned for O_DIRECT
+    const unsigned long long int readers = Hasher::combinable(m_HashType) ? threads : 1;
+    const unsigned long long int thread_blocks = ((file_size + readers - 1) / readers + UringReader::block_size - 1) / UringReader::block_size;
+    const unsigned long long int range_size = std::max<unsigned long long>(1, thread_blocks) * UringReader::block_size;
+    const auto readRange = [&](const unsigned long long int offset, Hasher* range_hasher) {
+        return readStreamed(file_path, offset, std::min(range_size, file_size - offset), [&](const char* data, const size_t length) { range_hasher->update(data, length); });
+    };
+
+    std::vector<Hasher> pieces;
+    for (unsigned long long int offset = 0; offset < file_size || pieces.empty(); offset += range_size) pieces.emplace_back(m_HashType, offset);
+    std::vector<std::future<bool>> ranges;
+    for (size_t i = 1; i < pieces.size(); ++i) ranges.push_back(std::async(std::launch::async, readRange, i * range_size, &pieces[i]));
+    bool read = readRange(0, &pieces[0]);
+    for (auto& range : ranges) read = range.get() && read;
+    if (!read) return false;
+
+    hasher = pieces[0];
+    for (size_t i = 1; i < pieces.size(); ++i) hasher.combine(pieces[i], std::min(range_size, file_size - i * range_size));
+    return true;
+}
+
+bool SFV::readStreamed(const std::string &file_path, const unsigned long long int offset, const unsigned long long int length, const std::function<void(const char*, size_t)> &consume) const
+{
+    std::error_code error;
+    if (m_IoEngine == IoEngine::Pread) return PreadReader::read(file_path, offset, length, consume, error, b_Scrub);
+    std::unique_ptr<UringReader> reader = takeReader();
+    const bool read = reader->ok() && reader->read(file_path, offset, length, consume, error);
+    returnReader(std::move(reader));
+    return read;
+}
+
+Hasher SFV::calculateCrcChunked(const std::string &file_path, const unsigned long long int file_size, const unsigned int threads) const
+{
+    const MapPolicy policy = mapPolicy();
+    // Each chunk is mapped only while it is hashed
+    return hashChunked(m_HashType, file_size, threads, TuningProfile::get().minBlockSize(), [&](const unsigned long long int offset, const unsigned long long int length) {
+        std::error_code error; mio::mmap_source mmap;
+        mmap.map(file_path, static_cast<size_t>(offset), static_cast<size_t>(length), error);
+        if (error) { throw std::runtime_error("mmap failed to map"); }
+        // Scrubs record the read-ahead past the chunk too, the next chunk may not have been taken yet
+        CacheResidency residency;
+        const unsigned long long int recorded = std::min(length + CacheResidency::read_ahead_slack, file_size - offset);
+        if (policy.cache_neutral) residency.record(mmap.file_handle(), offset, recorded);
+        policy.prepare(mmap);
+
+        Hasher piece(m_HashType, offset);
+        piece.update(mmap.data(), mmap.size());
+        policy.release(mmap, offset, &residency);
+        if (policy.cache_neutral) residency.dropNew(mmap.file_handle(), offset + mmap.size(), recorded - mmap.size());
+        mmap.unmap();
+        return piece;
+    });
+}
+
+Hasher SFV::hashChunked(const HashType type, const unsigned long long int size, const unsigned int threads, const unsigned long long int min_block_size,
+                        const std::function<Hasher(unsigned long long int, unsigned long long int)> &hash_chunk)
+{
+    // Even shares up to max_chunk_size, and no smaller than min_block_size. Large chunks are whole folios, so scrubs can drop
+    // their pages
+    unsigned long long int chunk_size = std::min<unsigned long long>(std::max<unsigned long long>((size + threads - 1) / threads, min_block_size), max_chunk_size);
+    const unsigned long long int alignment = chunk_size >= CacheResidency::drop_alignment ? CacheResidency::drop_alignment : Hasher::split_alignment;
+    chunk_size = std::max(alignment, (chunk_size + alignment - 1) / alignment * alignment);
+    const unsigned long long int chunks = (size + chunk_size - 1) / chunk_size;
+    const auto chunkLength = [&](const unsigned long long int chunk) { return std::min(chunk_size, size - chunk * chunk_size); };
+
+    std::atomic<unsigned long long int> next_chunk{0};
+    // Chunks finish out of order, a finished chunk waits here until every chunk before it is combined
+    std::mutex combine_mutex;
+    std::map<unsigned long long int, Hasher> finished;
+    unsigned long long int combined = 0;
+    Hasher whole(type);
+    const auto worker = [&] {
+        for (unsigned long long int chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+            Hasher piece = hash_chunk(chunk * chunk_size, chunkLength(chunk));
+
+            const std::lock_guard lock(combine_mutex);
+            finished.emplace(chunk, std::move(piece));
+            for (auto next = finished.find(combined); next != finished.end(); next = finished.find(combined)) {
+                if (combined == 0) whole = next->second;
+                else whole.combine(next->second, chunkLength(combined));
+                finished.erase(next);
+                ++combined;
+            }
         }
-        const unsigned int default_blocksize = static_cast<unsigned>(file_size + numThreads - 1) / numThreads;
-
-        if (file_size > file_limit) {
-            // if (default_blocksize > file_limit) { default_blocksize = file_limit; } // Might work :/ UPDATE TODO it doesn't work
-            // Calculate our crc
-            crc = asyncChunkCrcMmap(file_path, 0, file_size, default_blocksize);
-        } else {
-            std::error_code error; mio::mmap_source mmap;
-            mmap.map(file_path, 0, mio::map_entire_file, error);
-            if (error) { throw std::exception("mmap failed to map"); }
-
-            // Calculate our crc
-            crc = asyncChunkCrc(mmap.data(), static_cast<unsigned>(file_size), default_blocksize);
+    };
+
+    std::vector<std::future<void>> helpers;
+    for (unsigned long long int i = 1; i < std::min<unsigned long long>(threads, chunks); ++i) helpers.push_back(std::async(std::launch::async, worker));
+    worker();
+    for (auto& helper : helpers) helper.get();
+    return whole;
+}
+
+std::vector<std::string> SFV::calculateHashes(const std::string &file_path, const std::vector<HashType> &types, unsigned int threads) const
+{
+    if (threads == 0) threads = threadCount();
+    if (!std::filesystem::exists(file_path) || !std::filesystem::is_regular_file(file_path)) {
+        logResult(LogType::Critical, file_path + "File doesn't exist or is not a regular file");
+        return std::vector<std::string>(types.size(), "openError");
+    }
+    std::error_code file_error_code;
+    const unsigned long long int file_size = std::filesystem::file_size(file_path, file_error_code);
+    if (file_error_code) {
+        logResult(LogType::Critical, "Can't get file size of " + file_path);
+        return std::vector<std::string>(types.size(), "sizeError");
+    }
+
+    std::vector<Hasher> hashers;
+    for (const HashType type : types) hashers.emplace_back(type);
+    const auto digests = [&] {
+        std::vector<std::string> results;
+        for (const Hasher& hasher : hashers) results.push_back(digestString(hasher));
+        return results;
+    };
+
+    // Every stage hashes its share of the types over the same slice of the data, slices small enough to stay in cache
+    // for the next type
+    const size_t slice_size = TuningProfile::get().bufferSize();
+    const size_t stages = std::max<size_t>(1, std::min<size_t>(threads, types.size()));
+
+    // Streaming readers hand their blocks out on this thread, the stages hash each block side by side and the reader fills
+    // the next ones meanwhile. Files they can't read are mapped instead
+    if (m_IoEngine != IoEngine::Mmap && (m_IoEngine == IoEngine::Uring ? UringReader::available() : PreadReader::available())) {
+        // The stage threads live for the whole file. They meet this one at the barrier when a block is handed out, and again
+        // once it is hashed, before the reader reuses its buffer
+        const char* block_data = nullptr;
+        size_t block_length = 0;
+        bool blocks_done = false;
+        std::barrier block_sync(static_cast<std::ptrdiff_t>(stages));
+        const auto hashShare = [&](const size_t first) {
+            for (size_t slice = 0; slice < block_length; slice += slice_size) {
+                for (size_t i = first; i < hashers.size(); i += stages) hashers[i].update(block_data + slice, std::min(slice_size, block_length - slice));
+            }
+        };
+        const auto block_stage = [&](const size_t first) {
+            for (block_sync.arrive_and_wait(); !blocks_done; block_sync.arrive_and_wait()) {
+                hashShare(first);
+                block_sync.arrive_and_wait();
+            }
+        };
+        const auto hashBlock = [&](const char* data, const size_t length) {
+            block_data = data;
+            block_length = length;
+            block_sync.arrive_and_wait();
+            hashShare(0);
+            block_sync.arrive_and_wait();
+        };
+
+        std::vector<std::future<void>> stage_threads;
+        for (size_t first = 1; first < stages; ++first) stage_threads.push_back(std::async(std::launch::async, block_stage, first));
+        const auto stopStages = [&] {
+            blocks_done = true;
+            block_sync.arrive_and_wait();
+            for (auto& stage_thread : stage_threads) stage_thread.get();
+        };
+        bool streamed;
+        try {
+            streamed = readStreamed(file_path, 0, file_size, hashBlock);
+        } catch (...) {
+            stopStages();
+            throw;
         }
+        stopStages();
+        if (streamed) return digests();
+        for (size_t i = 0; i < types.size(); ++i) hashers[i] = Hasher(types[i]);
     }
 
-    // Convert unsigned int to hex string logic
-    char *hex = new char[8];
-    toHex(crc,hex,false);
-    std::string str_hex{hex, 8};
-    delete[] hex;
-    return str_hex;
+    // The last stage to finish a slice of the mapped window moves all of them to the next one
+    MappedWindow window(file_path, file_size, MappedWindow::default_window_size, mapPolicy());
+    std::error_code error;
+    bool mapped = false;
+    size_t slice = 0;
+    const auto nextSlice = [&]() noexcept {
+        slice += slice_size;
+        if (slice >= window.size()) {
+            mapped = window.next(error);
+            slice = 0;
+        }
+    };
+    std::barrier slice_done(static_cast<std::ptrdiff_t>(stages), nextSlice);
+    const auto stage = [&](const size_t first) {
+        while (mapped) {
+            const size_t length = std::min(slice_size, window.size() - slice);
+            for (size_t i = first; i < hashers.size(); i += stages) hashers[i].update(window.data() + slice, length);
+            slice_done.arrive_and_wait();
+        }
+    };
+
+    mapped = window.next(error);
+    std::vector<std::future<void>> stage_threads;
+    for (size_t first = 1; first < stages; ++first) stage_threads.push_back(std::async(std::launch::async, stage, first));
+    stage(0);
+    for (auto& stage_thread : stage_threads) stage_thread.get();
+
+    if (error) {
+        logResult(LogType::Critical, "Can't map " + file_path);
+        return std::vector<std::string>(types.size(), "readError");
+    }
+    return digests();
 }
 
-unsigned int SFV::asyncChunkCrc(const char *data, unsigned int numBytes, unsigned int maxBlockSize)  {
-    std::stringstream str_strm(data);
-    // last block ?
-    if (numBytes <= maxBlockSize)
-        return crc32_16bytes(data, numBytes, 0); // we're done
-
-    // compute CRC of the remaining bytes in a separate thread
-    auto data_left  = data + maxBlockSize;
-    auto bytes_left =          numBytes - maxBlockSize;
-    auto remainder = std::async(std::launch::async, asyncChunkCrc, data_left, bytes_left, maxBlockSize);
-
-    // compute CRC of the current block
-    const auto current_crc   = crc32_16bytes(data, maxBlockSize, 0);
-    // get CRC of the remainder
-    const auto remainder_crc = remainder.get();
-    // and merge both
-    return crc32_combine(current_crc, remainder_crc, bytes_left);
+void SFV::calculateFiles(const std::vector<std::string> &file_paths, const std::vector<HashType> &types, const std::function<void(size_t, std::vector<std::string>&)> &done) const
+{
+    const std::vector<DeviceGroups::Group> groups = DeviceGroups::split(file_paths);
+    // Spinning disks read one stream, solid state ones share the thread count, each at least one thread
+    const auto solid_state = static_cast<unsigned int>(std::count_if(groups.begin(), groups.end(), [](const DeviceGroups::Group& group) { return !group.rotational; }));
+    const unsigned int solid_state_threads = std::max(1u, threadCount() / std::max(1u, solid_state));
+
+    // Groups finish files out of order, a finished file waits here until every file before it is done
+    std::mutex done_mutex;
+    std::map<size_t, std::vector<std::string>> finished;
+    size_t reported = 0;
+    const auto finish = [&](const size_t file, std::vector<std::string>&& hashes) {
+        const std::lock_guard lock(done_mutex);
+        finished.emplace(file, std::move(hashes));
+        for (auto next = finished.find(reported); next != finished.end(); next = finished.find(reported)) {
+            done(reported, next->second);
+            finished.erase(next);
+            ++reported;
+        }
+    };
+
+    const auto hashGroup = [&](const DeviceGroups::Group& group) {
+        const unsigned int threads = group.rotational ? 1 : solid_state_threads;
+        std::vector<size_t> batch;
+        std::vector<std::string> batch_paths;
+        std::vector<unsigned long long int> batch_sizes;
+        unsigned long long int batch_bytes = 0;
+        BatchBuffer batch_buffer; // Reused by every batch of the group, the groups run side by side
+        const auto hashBatch = [&] {
+            if (batch.empty()) return;
+            std::vector<std::vector<std::string>> hashes = calculateCrcs(batch_paths, batch_sizes, types, batch_buffer);
+            for (size_t i = 0; i < batch.size(); ++i) finish(batch[i], std::move(hashes[i]));
+            batch.clear();
+            batch_paths.clear();
+            batch_sizes.clear();
+            batch_bytes = 0;
+        };
+
+        for (size_t i = 0; i < group.files.size(); ++i) {
+            // Small files are batched. Large ones are read one at a time, a round of them would seek between all of them for each piece.
+            // Files that can't be found go to calculateCrc, which logs why
+            const size_t file = group.files[i];
+            const uint64_t size = group.sizes[i];
+            if (size != DeviceGroups::unknown_size && batched(size)) {
+                batch.push_back(file);
+                batch_paths.push_back(file_paths[file]);
+                batch_sizes.push_back(size);
+                batch_bytes += std::min<unsigned long long>(size, m_SmallFileLimit);
+                if (batch.size() == small_file_batch * threads || batch_bytes >= small_file_batch_bytes) hashBatch();
+                continue;
+            }
+            finish(file, types.size() == 1 ? std::vector<std::string>{calculateCrc(file_paths[file], threads)} : calculateHashes(file_paths[file], types, threads));
+        }
+        hashBatch();
+    };
+
+    // A thread per device, the first group runs on this one
+    std::vector<std::future<void>> group_threads;
+    for (size_t i = 1; i < groups.size(); ++i) group_threads.push_back(std::async(std::launch::async, hashGroup, std::cref(groups[i])));
+    if (!groups.empty()) hashGroup(groups.front());
+    for (auto& group_thread : group_threads) group_thread.get();
+    // Each idle reader holds queue_depth * block_size bytes of buffers and a ring
+    releaseReaders();
 }
 
-unsigned SFV::asyncChunkCrcMmap(const std::string& file_path, const unsigned long long offset, const unsigned long long num_bytes,
-	unsigned max_block_size)
+std::vector<std::vector<std::string>> SFV::calculateCrcs(const std::vector<std::string> &file_paths, const std::vector<unsigned long long int> &file_sizes,
+                                                         const std::vector<HashType> &types, BatchBuffer &buffer) const
 {
-    std::error_code error; mio::mmap_source mmap;
-    mmap.map(file_path, static_cast<unsigned>(offset), max_block_size, error);
-    if (error) { throw std::exception("mmap failed to map"); }
-
-    std::stringstream str_data(mmap.data());
-    // last block ?
-    if (num_bytes <= max_block_size)
-        return crc32_16bytes(mmap.data(), static_cast<unsigned>(num_bytes), 0); // we're done
-
-    // compute CRC of the remaining bytes in a separate thread
-    auto bytes_left =          num_bytes - max_block_size;
-    auto remainder = std::async(std::launch::async, asyncChunkCrcMmap, file_path, (offset + max_block_size), bytes_left, max_block_size);
-
-    // compute CRC of the current block
-    const auto current_crc   = crc32_16bytes(mmap.data(), max_block_size, 0);
-    // get CRC of the remainder
-    const auto remainder_crc = remainder.get();
-    // and merge both
-    return crc32_combine(current_crc, remainder_crc, static_cast<unsigned>(bytes_left));
+    std::vector<std::vector<std::string>> results(file_paths.size(), std::vector<std::string>(types.size()));
+    // Files are read into back to back pieces of the buffer, each the size of its file up to the limit
+    std::vector<size_t> offsets(file_paths.size() + 1);
+    for (size_t i = 0; i < file_paths.size(); ++i) offsets[i + 1] = offsets[i] + static_cast<size_t>(std::min(m_SmallFileLimit, file_sizes[i]));
+    if (buffer.size < offsets.back()) {
+        buffer.data.reset(); // Freed before the larger one is allocated
+        buffer.data.reset(new char[offsets.back()]);
+        buffer.size = offsets.back();
+    }
+    std::vector<char*> buffers(file_paths.size());
+    for (size_t i = 0; i < file_paths.size(); ++i) buffers[i] = buffer.data.get() + offsets[i];
+
+    // small_file_batch files per thread, the first group runs on this one
+    std::vector<std::future<void>> groups;
+    for (size_t first = small_file_batch; first < file_paths.size(); first += small_file_batch) {
+        groups.push_back(std::async(std::launch::async, &SFV::calculateCrcGroup, this, file_paths.data() + first, file_sizes.data() + first,
+                                    std::min(small_file_batch, file_paths.size() - first), std::cref(types), buffers.data() + first, results.data() + first));
+    }
+    calculateCrcGroup(file_paths.data(), file_sizes.data(), std::min(small_file_batch, file_paths.size()), types, buffers.data(), results.data());
+    for (auto& group : groups) group.get();
+    return results;
 }
 
+void SFV::calculateCrcGroup(const std::string* file_paths, const unsigned long long int* file_sizes, const size_t count, const std::vector<HashType>& types,
+                            char* const* buffers, std::vector<std::string>* results) const
+{
+    std::vector<FileHandle> files(count);
+    // hashers[type][file]
+    std::vector<std::vector<Hasher>> hashers;
+    for (const HashType type : types) hashers.emplace_back(count, Hasher(type));
+    for (size_t i = 0; i < count; ++i) {
+        files[i] = openFile(file_paths[i]);
+        if (files[i] == no_file) {
+            logResult(LogType::Critical, "Can't open " + file_paths[i]);
+            results[i].assign(types.size(), "openError");
+        }
+    }
+
+    // Every round reads the next piece of each open file, small files are done after one
+    std::vector<size_t> open(count);
+    std::iota(open.begin(), open.end(), 0);
+    std::erase_if(open, [&](const size_t i) { return files[i] == no_file; });
+    std::vector<unsigned long long int> positions(count);
+    std::vector<CacheResidency> residencies(count); // Scrubs only, whole file before the first read
+    std::vector<unsigned long long int> dropped(count); // Scrubs drop behind the reads in whole folios
+    if (b_Scrub) {
+        for (const size_t i : open) residencies[i].record(descriptor(files[i]), 0, file_sizes[i]);
+    }
+    while (!open.empty()) {
+        std::vector<size_t> wanted(count);
+        std::vector<size_t> lengths(count);
+        for (const size_t i : open) {
+            // Up to the size stat found, a file that has grown since is hashed as it was
+            wanted[i] = static_cast<size_t>(std::min(m_SmallFileLimit, file_sizes[i] - positions[i]));
+            const long long int got = wanted[i] == 0 ? 0 : readFile(files[i], buffers[i], wanted[i]);
+            if (got < 0) {
+                logResult(LogType::Critical, "Can't read " + file_paths[i]);
+                results[i].assign(types.size(), "readError");
+                wanted[i] = 1; // Ends the file
+                continue;
+            }
+            lengths[i] = static_cast<size_t>(got);
+            positions[i] += lengths[i];
+        }
 
+        // Lanes advance together, so similar sizes waste the least
+        std::vector<size_t> order;
+        for (const size_t i : open) if (lengths[i] != 0) order.push_back(i);
+        std::sort(order.begin(), order.end(), [&](const size_t a, const size_t b) { return lengths[a] < lengths[b]; });
+        std::vector<const void*> sorted_data;
+        std::vector<size_t> sorted_lengths;
+        for (const size_t i : order) {
+            sorted_data.push_back(buffers[i]);
+            sorted_lengths.push_back(lengths[i]);
+        }
+        // The pieces are still in cache for the next type
+        for (auto& type_hashers : hashers) {
+            std::vector<Hasher> sorted_hashers;
+            for (const size_t i : order) sorted_hashers.push_back(type_hashers[i]);
+            Hasher::updateMulti(sorted_hashers.data(), sorted_data.data(), sorted_lengths.data(), sorted_hashers.size());
+            for (size_t i = 0; i < order.size(); ++i) type_hashers[order[i]] = sorted_hashers[i];
+        }
+
+        // A short read, or the size stat found, is the end of the file
+        const auto finished = [&](const size_t i) { return lengths[i] < wanted[i] || positions[i] == file_sizes[i]; };
 
+        // The pieces are in the buffer, the pages they came from can go. The last piece takes the rest of the file
+        if (b_Scrub) {
+            for (const size_t i : open) {
+                const unsigned long long int drop_to = finished(i) ? positions[i] + CacheResidency::drop_alignment : positions[i] / CacheResidency::drop_alignment * CacheResidency::drop_alignment;
+                if (drop_to > dropped[i]) {
+                    residencies[i].dropNew(descriptor(files[i]), dropped[i], drop_to - dropped[i]);
+                    dropped[i] = drop_to;
+                }
+            }
+        }
 
+        std::erase_if(open, [&](const size_t i) {
+            if (!finished(i)) return false;
+            closeFile(files[i]);
+            if (results[i].front().empty()) {
+                for (size_t t = 0; t < types.size(); ++t) results[i][t] = digestString(hashers[t][i]);
+            }
+            return true;
+        });
+    }
+}
+
+unsigned int SFV::threadCount() const
+{
+    if (m_Threads != 0) return m_Threads;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string SFV::digestString(const Hasher &hasher)
+{
+    if (checksumList(hasher.type())) {
+        // Lower case, as written by md5sum and sha256sum
+        constexpr char hex_digits[] = "0123456789abcdef";
+        uint8_t digest[Hasher::max_digest_size];
+        hasher.digest(digest);
+        std::string str_hex(hasher.digits(), '0');
+        for (unsigned int i = 0; i < hasher.digits() / 2; ++i) {
+            str_hex[2 * i] = hex_digits[digest[i] >> 4];
+            str_hex[2 * i + 1] = hex_digits[digest[i] & 0xF];
+        }
+        return str_hex;
+    }
+
+    // Convert to hex string logic, 8 characters per 32 bits
+    const uint64_t crc = hasher.finalize();
+    std::string str_hex(hasher.digits(), '0');
+    for (unsigned int i = 0; i < hasher.digits() / 8; ++i) {
+        const unsigned int shift = 32 * (hasher.digits() / 8 - 1 - i);
+        toHex((crc >> shift) & 0xFFFFFFFF, str_hex.data() + 8 * i, false);
+    }
+    return str_hex;
+}
@@ -0,0 +1,59 @@
+/**
+ *  @file   sfv_device_groups.cpp
+ *  @brief  st_dev grouping and rotational disk detection of DeviceGroups
+ ***********************************************/
+
+#include <sfv/DeviceGroups.h>
+#include <filesystem>
+#include <fstream>
+#include <map>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#define SFV_HAS_STAT
+#endif
+#ifdef __linux__
+#include <sys/sysmacros.h>
+#endif
+
+std::vector<DeviceGroups::Group> DeviceGroups::split(const std::vector<std::string> &file_paths) {
+    std::vector<Group> groups;
+    std::map<uint64_t, size_t> group_of_device;
+    for (size_t i = 0; i < file_paths.size(); ++i) {
+        uint64_t device = groups.empty() ? 0 : groups.front().device;
+        uint64_t size = unknown_size;
+#ifdef SFV_HAS_STAT
+        if (struct stat status{}; stat(file_paths[i].c_str(), &status) == 0 && S_ISREG(status.st_mode)) {
+            device = static_cast<uint64_t>(status.st_dev);
+            size = static_cast<uint64_t>(status.st_size);
+        }
+#else
+        std::error_code error;
+        if (const auto file_size = std::filesystem::file_size(file_paths[i], error); !error) size = file_size;
+#endif
+        const auto [group, added] = group_of_device.emplace(device, groups.size());
+        if (added) groups.push_back(Group{device, rotational(device), {}, {}});
+        groups[group->second].files.push_back(i);
+        groups[group->second].sizes.push_back(size);
+    }
+    return groups;
+}
+
+bool DeviceGroups::rotational(const uint64_t device) {
+#ifdef __linux__
+    // Partitions have no queue of their own, it's the parent disk's. Device mapper and md report their own
+    std::error_code error;
+    const std::filesystem::path block = std::filesystem::canonical("/sys/dev/block/" + std::to_string(major(device)) + ":" + std::to_string(minor(device)), error);
+    if (error) return false; // Not a block device
+    for (const auto& queue : {block / "queue" / "rotational", block.parent_path() / "queue" / "rotational"}) {
+        if (std::ifstream file(queue); file.is_open()) {
+            int value = 0;
+            return file >> value && value != 0;
+        }
+    }
+    return false;
+#else
+    (void)device;
+    return false;
+#endif
+}
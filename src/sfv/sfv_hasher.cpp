@@ -0,0 +1,149 @@
+/**
+ *  @file   sfv_hasher.cpp
+ *  @brief  Binds the hash types to their kernels
+ ***********************************************/
+
+#include <sfv/Hasher.h>
+#include <crc/Crc32.h>
+#include <crc/Crc32c.h>
+#include <crc/Crc64.h>
+#include <algorithm>
+
+namespace {
+    /**
+     * \brief Adapts a 32 bit multi-buffer kernel to the 64 bit state
+     */
+    template <void (*Multi)(const void* const*, const size_t*, uint32_t*, size_t)>
+    void multi32(const void* const* data, const size_t* lengths, uint64_t* crcs, const size_t count) {
+        constexpr size_t chunk = 16;
+        uint32_t crcs32[chunk];
+        for (size_t first = 0; first < count; first += chunk) {
+            const size_t n = std::min(chunk, count - first);
+            for (size_t i = 0; i < n; ++i) crcs32[i] = static_cast<uint32_t>(crcs[first + i]);
+            Multi(data + first, lengths + first, crcs32, n);
+            for (size_t i = 0; i < n; ++i) crcs[first + i] = crcs32[i];
+        }
+    }
+
+    /**
+     * \brief Writes the 8 bytes of value, most significant first
+     */
+    void writeBigEndian(const uint64_t value, uint8_t* bytes) {
+        for (int i = 0; i < 8; ++i) bytes[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+    }
+}
+
+Hasher::Hasher(const HashType type, const uint64_t offset) : m_Type(type), m_Functions(crcFunctions(type)) {
+    reset(offset);
+}
+
+bool Hasher::combinable(const HashType type) {
+    return type == HashType::CRC || type == HashType::CRC32C || type == HashType::CRC64 || type == HashType::BLAKE3;
+}
+
+void Hasher::reset(const uint64_t offset) {
+    m_Value = 0;
+    if (m_Type == HashType::MD5) md5_init(&m_Md5);
+    else if (m_Type == HashType::SHA256) sha256_init(&m_Sha256);
+    else if (m_Type == HashType::BLAKE3) blake3_init(&m_Blake3, offset);
+    else if (m_Type == HashType::XXH3 || m_Type == HashType::XXH128) xxh3_init(&m_Xxh3);
+}
+
+void Hasher::updateDigest(const void* data, const size_t length) {
+    if (m_Type == HashType::MD5) md5_update(&m_Md5, data, length);
+    else if (m_Type == HashType::SHA256) sha256_update(&m_Sha256, data, length);
+    else if (m_Type == HashType::BLAKE3) blake3_update(&m_Blake3, data, length);
+    else xxh3_update(&m_Xxh3, data, length);
+}
+
+void Hasher::digest(uint8_t* digest) const {
+    switch (m_Type) {
+        case HashType::MD5:
+            md5_final(&m_Md5, digest);
+            return;
+        case HashType::SHA256:
+            sha256_final(&m_Sha256, digest);
+            return;
+        case HashType::BLAKE3:
+            blake3_final(&m_Blake3, digest);
+            return;
+        case HashType::XXH3:
+            // Big endian, the canonical form printed by xxhsum
+            writeBigEndian(xxh3_64_final(&m_Xxh3), digest);
+            return;
+        case HashType::XXH128: {
+            uint64_t low, high;
+            xxh3_128_final(&m_Xxh3, &low, &high);
+            writeBigEndian(high, digest);
+            writeBigEndian(low, digest + 8);
+            return;
+        }
+        default:
+            for (unsigned int i = 0; i < digits() / 2; ++i) {
+                digest[i] = static_cast<uint8_t>(m_Value >> (8 * (digits() / 2 - 1 - i)));
+            }
+    }
+}
+
+Hasher::CrcFunctions Hasher::crcFunctions(const HashType type) {
+    switch (type) {
+        case HashType::CRC32C:
+            return {
+                [](const void* data, size_t length, uint64_t previous) -> uint64_t { return crc32c_fast(data, length, static_cast<uint32_t>(previous)); },
+                [](uint64_t crc_a, uint64_t crc_b, size_t length_b) -> uint64_t { return crc32c_combine(static_cast<uint32_t>(crc_a), static_cast<uint32_t>(crc_b), length_b); },
+                multi32<crc32c_multi>,
+                8};
+        case HashType::CRC64:
+            return {crc64_fast, crc64_combine, crc64_multi, 16};
+        case HashType::MD5:
+            return {nullptr, nullptr, nullptr, 32};
+        case HashType::SHA256:
+        case HashType::BLAKE3:
+            return {nullptr, nullptr, nullptr, 64};
+        case HashType::XXH3:
+            return {nullptr, nullptr, nullptr, 16};
+        case HashType::XXH128:
+            return {nullptr, nullptr, nullptr, 32};
+        default:
+            return {
+                [](const void* data, size_t length, uint64_t previous) -> uint64_t { return crc32_fast(data, length, static_cast<uint32_t>(previous)); },
+                [](uint64_t crc_a, uint64_t crc_b, size_t length_b) -> uint64_t { return crc32_combine(static_cast<uint32_t>(crc_a), static_cast<uint32_t>(crc_b), length_b); },
+                multi32<crc32_multi>,
+                8};
+    }
+}
+
+void Hasher::updateMulti(Hasher* hashers, const void* const* data, const size_t* lengths, const size_t count) {
+    if (count == 0) return;
+    constexpr size_t chunk = 16;
+    // More streams than lanes lets the multi-buffer hashes refill lanes as streams finish
+    const auto multiStates = [&]<typename State>(State Hasher::* member, void (*multi)(State* const*, const void* const*, const size_t*, size_t)) {
+        constexpr size_t state_chunk = 64;
+        State* states[state_chunk];
+        for (size_t first = 0; first < count; first += state_chunk) {
+            const size_t n = std::min(state_chunk, count - first);
+            for (size_t i = 0; i < n; ++i) states[i] = &(hashers[first + i].*member);
+            multi(states, data + first, lengths + first, n);
+        }
+    };
+    if (hashers[0].m_Type == HashType::MD5) {
+        multiStates(&Hasher::m_Md5, md5_multi);
+        return;
+    }
+    if (hashers[0].m_Type == HashType::SHA256) {
+        multiStates(&Hasher::m_Sha256, sha256_multi);
+        return;
+    }
+    // BLAKE3's lanes work inside one stream, on its chunks, and XXH3 fills a whole register from one stream
+    if (hashers[0].m_Type == HashType::BLAKE3 || hashers[0].m_Type == HashType::XXH3 || hashers[0].m_Type == HashType::XXH128) {
+        for (size_t i = 0; i < count; ++i) hashers[i].update(data[i], lengths[i]);
+        return;
+    }
+    uint64_t values[chunk];
+    for (size_t first = 0; first < count; first += chunk) {
+        const size_t n = std::min(chunk, count - first);
+        for (size_t i = 0; i < n; ++i) values[i] = hashers[first + i].m_Value;
+        hashers[0].m_Functions.multi(data + first, lengths + first, values, n);
+        for (size_t i = 0; i < n; ++i) hashers[first + i].m_Value = values[i];
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ *  @file   sfv_map_policy.cpp
+ *  @brief  Applies the MapPolicy hints to mio mappings
+ ***********************************************/
+
+#include <sfv/MapPolicy.h>
+#include <sstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#define SFV_HAS_MADVISE
+#endif
+// Kernels before 5.14 reject it, which leaves the pages to fault in on access as usual
+#if defined(__linux__) && !defined(MADV_POPULATE_READ)
+#define MADV_POPULATE_READ 22
+#endif
+
+namespace {
+    /**
+     * \brief Hint names as used by fromNames, in names() order
+     */
+    constexpr std::pair<const char*, bool MapPolicy::*> hint_names[] = {
+        {"sequential", &MapPolicy::sequential},
+        {"willneed", &MapPolicy::will_need},
+        {"populate", &MapPolicy::populate},
+        {"hugepage", &MapPolicy::huge_pages},
+        {"dontneed", &MapPolicy::drop_behind},
+        {"neutral", &MapPolicy::cache_neutral},
+    };
+
+#ifdef SFV_HAS_MADVISE
+    /**
+     * \brief Whole pages of the mapping, madvise needs a page aligned start
+     */
+    void adviseMapping(const mio::mmap_source& mmap, const int advice) {
+        madvise(const_cast<char*>(mmap.data() - mmap.mapping_offset()), mmap.mapped_length(), advice);
+    }
+#endif
+}
+
+bool MapPolicy::fromNames(const std::string &names, MapPolicy &policy) {
+    MapPolicy named;
+    for (const auto& [name, hint] : hint_names) named.*hint = false;
+    std::stringstream list(names);
+    for (std::string name; std::getline(list, name, ',');) {
+        if (name == "none") continue;
+        bool found = false;
+        for (const auto& [hint_name, hint] : hint_names) {
+            if (name == hint_name) named.*hint = found = true;
+        }
+        if (!found) return false;
+    }
+    policy = named;
+    return true;
+}
+
+std::string MapPolicy::names() const {
+    std::string list;
+    for (const auto& [name, hint] : hint_names) {
+        if (!(this->*hint)) continue;
+        if (!list.empty()) list += ',';
+        list += name;
+    }
+    return list.empty() ? "none" : list;
+}
+
+void MapPolicy::prepare(const mio::mmap_source &mmap) const {
+#ifdef SFV_HAS_MADVISE
+    if (!mmap.is_mapped()) return;
+    if (sequential) adviseMapping(mmap, MADV_SEQUENTIAL);
+#ifdef MADV_HUGEPAGE
+    // Before populating, so the pages are faulted in as huge pages
+    if (huge_pages) adviseMapping(mmap, MADV_HUGEPAGE);
+#endif
+    if (will_need) adviseMapping(mmap, MADV_WILLNEED);
+#ifdef MADV_POPULATE_READ
+    if (populate) adviseMapping(mmap, MADV_POPULATE_READ);
+#endif
+#else
+    (void)mmap;
+#endif
+}
+
+void MapPolicy::release(const mio::mmap_source &mmap, const uint64_t offset, const CacheResidency* residency) const {
+#ifdef SFV_HAS_MADVISE
+    if (!(drop_behind || cache_neutral) || !mmap.is_mapped()) return;
+    // Mapped pages can't leave the page cache, this drops this process's page tables first
+    adviseMapping(mmap, MADV_DONTNEED);
+#ifdef POSIX_FADV_DONTNEED
+    if (drop_behind) posix_fadvise(mmap.file_handle(), static_cast<off_t>(offset), static_cast<off_t>(mmap.size()), POSIX_FADV_DONTNEED);
+#endif
+    if (cache_neutral && !drop_behind && residency != nullptr) residency->dropNew(mmap.file_handle(), offset, mmap.size());
+#else
+    (void)mmap;
+    (void)offset;
+    (void)residency;
+#endif
+}
@@ -0,0 +1,29 @@
+/**
+ *  @file   sfv_mapped_window.cpp
+ *  @brief  Maps the windows of MappedWindow
+ ***********************************************/
+
+#include <sfv/MappedWindow.h>
+#include <algorithm>
+#include <limits>
+
+MappedWindow::MappedWindow(const std::string &file_path, const uint64_t file_size, const uint64_t window_size, const MapPolicy &policy)
+    : m_FilePath(file_path), m_FileSize(file_size),
+      // A window must fit in size_t on 32 bit builds
+      m_WindowSize(std::clamp<uint64_t>(window_size, 1, std::numeric_limits<size_t>::max() / 2)), m_Policy(policy) {}
+
+bool MappedWindow::next(std::error_code &error) {
+    if (m_Map.is_mapped()) {
+        m_Policy.release(m_Map, m_Offset, &m_Residency);
+        m_Offset += m_Map.size();
+        m_Map.unmap();
+    }
+    if (m_Offset >= m_FileSize) return false;
+
+    m_Map.map(m_FilePath, static_cast<size_t>(m_Offset), static_cast<size_t>(std::min(m_WindowSize, m_FileSize - m_Offset)), error);
+    if (error) return false;
+    // The whole file at once, before read-ahead of the first window reaches the next
+    if (m_Policy.cache_neutral && m_Offset == 0) m_Residency.record(m_Map.file_handle(), 0, m_FileSize);
+    m_Policy.prepare(m_Map);
+    return true;
+}
@@ -0,0 +1,157 @@
+/**
+ *  @file   sfv_pread_reader.cpp
+ *  @brief  Reader thread and buffer ring of PreadReader
+ ***********************************************/
+
+#include <sfv/PreadReader.h>
+#include <sfv/CacheResidency.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <future>
+#include <memory>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define SFV_HAS_PREAD
+#endif
+
+#ifdef SFV_HAS_PREAD
+namespace {
+    /**
+     * \brief Page aligned buffers, the kernel copies whole pages into them
+     */
+    constexpr size_t buffer_alignment = 4096;
+
+    struct FreeBuffer {
+        void operator()(char* buffer) const {std::free(buffer);}
+    };
+}
+
+bool PreadReader::available() {
+    return true;
+}
+
+bool PreadReader::read(const std::string &file_path, const uint64_t offset, const uint64_t length, const std::function<void(const char*, size_t)> &consume, std::error_code &error, const bool cache_neutral) {
+    error.clear();
+    if (length == 0) return true;
+
+    const int fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        error = std::error_code(errno, std::generic_category());
+        return false;
+    }
+#ifdef POSIX_FADV_SEQUENTIAL
+    // Larger read-ahead on the range, the kernel's readahead keeps the disk busy between our reads too. Cache neutral reads
+    // turn it off instead, it would read past the range into pages the next range already dropped. The reader thread
+    // running ahead is read-ahead enough
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), cache_neutral ? POSIX_FADV_RANDOM : POSIX_FADV_SEQUENTIAL);
+#endif
+
+    const std::unique_ptr<char, FreeBuffer> buffers(static_cast<char*>(std::aligned_alloc(buffer_alignment, buffer_count * block_size)));
+    if (!buffers) {
+        close(fd);
+        error = std::make_error_code(std::errc::not_enough_memory);
+        return false;
+    }
+    const uint64_t blocks = (length + block_size - 1) / block_size;
+    const auto blockLength = [&](const uint64_t block) { return static_cast<size_t>(std::min<uint64_t>(block_size, length - block * block_size)); };
+
+    // Single producer, single consumer. A block's buffer is reused once the hashing thread has moved past it
+    std::atomic<uint64_t> produced{0};
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<bool> cancelled{false}; // Hashing ended early, the reader thread stops waiting for buffers
+    std::array<int, buffer_count> errors{}; // errno of each buffer's read, written before produced moves past it
+    // Before the first read, widened to whole folios. The ones shared with the ranges either side are dropped by both.
+    // Read-ahead marks left by other readers still start read-ahead past the end, so that much more goes at the end
+    CacheResidency residency;
+    constexpr uint64_t alignment = CacheResidency::drop_alignment;
+    uint64_t dropped = offset / alignment * alignment;
+    const uint64_t drop_end = (offset + length + CacheResidency::read_ahead_slack + alignment - 1) / alignment * alignment;
+    if (cache_neutral) residency.record(fd, dropped, drop_end - dropped);
+
+    auto reader = std::async(std::launch::async, [&] {
+        for (uint64_t block = 0; block < blocks; ++block) {
+            for (uint64_t done = consumed.load(std::memory_order_acquire); block - done >= buffer_count; done = consumed.load(std::memory_order_acquire)) {
+                if (cancelled.load()) return;
+                consumed.wait(done, std::memory_order_acquire);
+            }
+            if (cancelled.load()) return;
+
+            const size_t slot = block % buffer_count;
+            char* buffer = buffers.get() + slot * block_size;
+            size_t filled = 0;
+            errors[slot] = 0;
+            while (filled < blockLength(block)) {
+                const ssize_t got = pread(fd, buffer + filled, blockLength(block) - filled, static_cast<off_t>(offset + block * block_size + filled));
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) {
+                    errors[slot] = got < 0 ? errno : EIO; // Zero is the file shrinking
+                    break;
+                }
+                filled += static_cast<size_t>(got);
+            }
+
+            produced.store(block + 1, std::memory_order_release);
+            produced.notify_one();
+            if (errors[slot] != 0) return;
+        }
+    });
+
+    // However the hashing ends, including consume throwing, the reader thread is stopped and joined before the buffers
+    // and the file go. It would otherwise wait for a free buffer forever, and the future's destructor for it
+    struct StopReader {
+        std::atomic<bool>& cancelled;
+        std::atomic<uint64_t>& consumed;
+        std::future<void>& reader;
+        int fd;
+        ~StopReader() {
+            cancelled.store(true);
+            consumed.fetch_add(1, std::memory_order_release); // Wakes a wait on the old count
+            consumed.notify_one();
+            reader.wait();
+            close(fd);
+        }
+    } stop_reader{cancelled, consumed, reader, fd};
+
+    for (uint64_t block = 0; block < blocks; ++block) {
+        for (uint64_t ready = produced.load(std::memory_order_acquire); ready <= block; ready = produced.load(std::memory_order_acquire)) {
+            produced.wait(ready, std::memory_order_acquire);
+        }
+
+        const size_t slot = block % buffer_count;
+        if (errors[slot] != 0) {
+            error = std::error_code(errors[slot], std::generic_category());
+            break;
+        }
+        consume(buffers.get() + slot * block_size, blockLength(block));
+        if (cache_neutral) {
+            // Behind the hashing in whole folios, the last block takes the rest
+            const uint64_t drop_to = block + 1 == blocks ? drop_end : (offset + block * block_size + blockLength(block)) / alignment * alignment;
+            if (drop_to > dropped) {
+                residency.dropNew(fd, dropped, drop_to - dropped);
+                dropped = drop_to;
+            }
+        }
+        consumed.store(block + 1, std::memory_order_release);
+        consumed.notify_one();
+    }
+
+    return !error;
+}
+
+#else // No POSIX file IO, calculateCrc maps the file instead
+
+bool PreadReader::available() {
+    return false;
+}
+
+bool PreadReader::read(const std::string&, uint64_t, uint64_t, const std::function<void(const char*, size_t)>&, std::error_code &error, bool) {
+    error = std::make_error_code(std::errc::function_not_supported);
+    return false;
+}
+
+#endif
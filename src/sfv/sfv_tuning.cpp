@@ -0,0 +1,231 @@
+/**
+ *  @file   sfv_tuning.cpp
+ *  @brief  Calibrates, saves and loads the tuning profile
+ ***********************************************/
+
+#include <sfv/TuningProfile.h>
+#include <sfv/SFVCommon.h>
+#include <sfv/Hasher.h>
+#include <sfv/MappedWindow.h>
+#include <crc/Crc32.h>
+#include <utils/CpuFeatures.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    // 2: buffer_size is the slice of the multi-hash stages, it was the mapped chunk of single threaded hashing
+    constexpr int profile_version = 2;
+
+    std::filesystem::path& customPath() {
+        static std::filesystem::path path;
+        return path;
+    }
+
+    /**
+     * \brief Average seconds per call of task, repeated for at least 50 ms
+     */
+    template <typename Task>
+    double timePerCall(Task&& task) {
+        using Clock = std::chrono::steady_clock;
+        task(); // Warm up caches and page tables
+        unsigned int calls = 0;
+        const auto start = Clock::now();
+        double seconds;
+        do {
+            task();
+            ++calls;
+            seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        } while (seconds < 0.05);
+        return seconds / calls;
+    }
+
+    void fillRandom(char* data, const size_t length) {
+        std::mt19937_64 random(42);
+        for (size_t i = 0; i + 8 <= length; i += 8) {
+            const uint64_t value = random();
+            std::memcpy(data + i, &value, 8);
+        }
+    }
+}
+
+const TuningProfile& TuningProfile::get() {
+    static const TuningProfile profile = [] {
+        TuningProfile loaded;
+        if (!loaded.load(path())) loaded = TuningProfile();
+        loaded.apply();
+        return loaded;
+    }();
+    return profile;
+}
+
+void TuningProfile::setPath(const std::filesystem::path& path) {
+    customPath() = path;
+}
+
+std::filesystem::path TuningProfile::path() {
+    if (!customPath().empty()) return customPath();
+    std::filesystem::path folder;
+    if (const char* xdg = std::getenv("XDG_CACHE_HOME"); xdg != nullptr && *xdg != '\0') folder = xdg;
+    else if (const char* home = std::getenv("HOME"); home != nullptr && *home != '\0') folder = std::filesystem::path(home) / ".cache";
+    else if (const char* local = std::getenv("LOCALAPPDATA"); local != nullptr && *local != '\0') folder = local;
+    else folder = std::filesystem::temp_directory_path();
+    return folder / "sfvArchiving" / "profile";
+}
+
+bool TuningProfile::load(const std::filesystem::path& file) {
+    std::ifstream stream(file);
+    if (!stream.is_open()) return false;
+
+    int version = 0;
+    std::string cpu;
+    std::string line;
+    try {
+        while (std::getline(stream, line)) {
+            if (line.empty() || line[0] == '#') continue;
+            const size_t split = line.find('=');
+            if (split == std::string::npos) return false;
+            const std::string key = line.substr(0, split);
+            const std::string value = line.substr(split + 1);
+            if (key == "version") version = std::stoi(value);
+            else if (key == "cpu") cpu = value;
+            else if (key == "kernel") m_Kernel = value;
+            else if (key == "prefetch_ahead") m_PrefetchAhead = std::stoull(value);
+            else if (key == "buffer_size") m_BufferSize = std::stoull(value);
+            else if (key == "min_block_size") m_MinBlockSize = std::stoull(value);
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    // A profile shared between machines (e.g a network home folder) only fits the CPU it was made on
+    return version == profile_version && cpu == CpuFeatures::get().brand() && m_BufferSize >= 4096;
+}
+
+bool TuningProfile::save(const std::filesystem::path& file) const {
+    std::error_code error;
+    if (file.has_parent_path()) std::filesystem::create_directories(file.parent_path(), error);
+
+    std::ofstream stream(file);
+    if (!stream.is_open()) return false;
+    stream << "# sfvArchiving tuning profile, written by --calibrate" << "\n";
+    stream << "version=" << profile_version << "\n";
+    stream << "cpu=" << CpuFeatures::get().brand() << "\n";
+    stream << "kernel=" << m_Kernel << "\n";
+    stream << "prefetch_ahead=" << m_PrefetchAhead << "\n";
+    stream << "buffer_size=" << m_BufferSize << "\n";
+    stream << "min_block_size=" << m_MinBlockSize << "\n";
+    return stream.good();
+}
+
+void TuningProfile::apply() const {
+    crc32_set_prefetch_ahead(m_PrefetchAhead);
+    // A kernel the CPU can't run (e.g after a microcode or VM change) keeps the default
+    if (!m_Kernel.empty()) crc32_select_kernel(m_Kernel.c_str());
+}
+
+TuningProfile TuningProfile::calibrate(std::ostream& log) {
+    TuningProfile profile;
+    constexpr size_t data_size = size_t(64) << 20;
+    const std::unique_ptr<char[]> data(new char[data_size]);
+    fillRandom(data.get(), data_size);
+
+    // Kernel and prefetch distance, on a buffer larger than L2 like the mapped file chunks
+    constexpr size_t kernel_size = size_t(8) << 20;
+    double best_kernel = 0;
+    double best_prefetch = 0;
+    size_t count;
+    const Crc32Kernel* kernels = crc32_kernels(&count);
+    for (size_t i = 0; i < count; ++i) {
+        if (kernels[i].supported != nullptr && !kernels[i].supported()) continue;
+        const std::string name = kernels[i].name;
+        double speed;
+        if (name == "16bytes_prefetch") {
+            for (const size_t ahead : {64, 128, 256, 512, 1024, 2048}) {
+                const double prefetch_speed = kernel_size / timePerCall([&] { crc32_16bytes_prefetch(data.get(), kernel_size, 0, ahead); }) / 1e9;
+                log << "[Calibrating] kernel " << name << "/" << ahead << " : " << prefetch_speed << " GB/s" << "\n";
+                if (prefetch_speed > best_prefetch) {
+                    best_prefetch = prefetch_speed;
+                    profile.m_PrefetchAhead = ahead;
+                }
+            }
+            speed = best_prefetch;
+        } else {
+            // The slow reference kernels only get a small sample
+            const size_t size = (name == "bitwise" || name == "halfbyte" || name.rfind("1byte", 0) == 0) ? kernel_size / 16 : kernel_size;
+            speed = size / timePerCall([&] { kernels[i].function(data.get(), size, 0); }) / 1e9;
+            log << "[Calibrating] kernel " << name << " : " << speed << " GB/s" << "\n";
+        }
+        if (speed > best_kernel) {
+            best_kernel = speed;
+            profile.m_Kernel = name;
+        }
+    }
+    profile.apply();
+
+    // Slice size of a multi-hash pass, through the page cache like SFV::calculateHashes. Each slice is hashed twice, the
+    // second time is only fast while the slice is still in cache
+    const std::filesystem::path temp_file = std::filesystem::temp_directory_path() / ("sfv_calibrate_" + std::to_string(std::random_device()()) + ".bin");
+    {
+        std::ofstream stream(temp_file, std::ios::binary);
+        stream.write(data.get(), data_size);
+    }
+    double best_buffer = 0;
+    for (const size_t buffer_size : {size_t(16) << 10, size_t(64) << 10, size_t(20*4096), size_t(256) << 10, size_t(1) << 20, size_t(4) << 20, size_t(16) << 20}) {
+        bool failed = false;
+        const double speed = data_size / timePerCall([&] {
+            Hasher crc(HashType::CRC);
+            Hasher xxh3(HashType::XXH3);
+            MappedWindow window(temp_file.string(), data_size);
+            std::error_code error;
+            while (window.next(error)) {
+                for (size_t offset = 0; offset < window.size(); offset += buffer_size) {
+                    const size_t length = std::min(buffer_size, window.size() - offset);
+                    crc.update(window.data() + offset, length);
+                    xxh3.update(window.data() + offset, length);
+                }
+            }
+            failed = static_cast<bool>(error);
+        }) / 1e9;
+        if (failed) break;
+        log << "[Calibrating] buffer " << buffer_size << " : " << speed << " GB/s" << "\n";
+        if (speed > best_buffer) {
+            best_buffer = speed;
+            profile.m_BufferSize = buffer_size;
+        }
+    }
+    std::error_code error;
+    std::filesystem::remove(temp_file, error);
+
+    // Smallest block worth a thread, summed over small, medium and large files. Hashed in memory by the chunk scheduler of
+    // SFV::calculateCrcChunked, so only the file mapping is left out
+    const unsigned int threads = std::max(1u, std::thread::hardware_concurrency());
+    double best_block = 0;
+    for (const size_t min_block_size : {size_t(0), size_t(256) << 10, size_t(1) << 20, size_t(4) << 20, size_t(16) << 20}) {
+        double seconds = 0;
+        for (const size_t file_size : {size_t(1) << 20, size_t(8) << 20, data_size}) {
+            seconds += timePerCall([&] {
+                SFV::hashChunked(HashType::CRC, file_size, threads, min_block_size, [&](const unsigned long long int offset, const unsigned long long int length) {
+                    Hasher piece(HashType::CRC, offset);
+                    piece.update(data.get() + offset, static_cast<size_t>(length));
+                    return piece;
+                });
+            });
+        }
+        log << "[Calibrating] min block " << min_block_size << " : " << seconds * 1e3 << " ms" << "\n";
+        if (best_block == 0 || seconds < best_block) {
+            best_block = seconds;
+            profile.m_MinBlockSize = min_block_size;
+        }
+    }
+
+    log << "[Calibrated] kernel " << profile.m_Kernel << ", prefetch " << profile.m_PrefetchAhead << ", buffer " << profile.m_BufferSize
+        << ", min block " << profile.m_MinBlockSize << "\n";
+    return profile;
+}
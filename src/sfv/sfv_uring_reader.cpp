@@ -0,0 +1,272 @@
+/**
+ *  @file   sfv_uring_reader.cpp
+ *  @brief  io_uring ring setup and the read loop of UringReader
+ ***********************************************/
+
+#include <sfv/UringReader.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define SFV_HAS_URING
+#endif
+
+#ifdef SFV_HAS_URING
+namespace {
+    /**
+     * \brief O_DIRECT offset, length and buffer alignment, the largest logical block size in use
+     */
+    constexpr size_t direct_alignment = 4096;
+
+    int uringSetup(const unsigned int entries, io_uring_params* params) {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+    int uringEnter(const int fd, const unsigned int to_submit, const unsigned int min_complete, const unsigned int flags) {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+    int uringRegister(const int fd, const unsigned int opcode, const void* arg, const unsigned int count) {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+    }
+
+    // Ring indices are shared with the kernel
+    unsigned int loadAcquire(unsigned int* index) {
+        return std::atomic_ref<unsigned int>(*index).load(std::memory_order_acquire);
+    }
+    void storeRelease(unsigned int* index, const unsigned int value) {
+        std::atomic_ref<unsigned int>(*index).store(value, std::memory_order_release);
+    }
+
+    void* mapRing(const int fd, const size_t size, const off_t offset) {
+        void* ring = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+        return ring == MAP_FAILED ? nullptr : ring;
+    }
+}
+
+UringReader::UringReader() {
+    io_uring_params params{};
+    const int fd = uringSetup(queue_depth, &params);
+    if (fd < 0) return;
+
+    m_SqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    m_CqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) m_SqRingSize = m_CqRingSize = std::max(m_SqRingSize, m_CqRingSize);
+    m_SqRing = mapRing(fd, m_SqRingSize, IORING_OFF_SQ_RING);
+    m_CqRing = single_mmap ? m_SqRing : mapRing(fd, m_CqRingSize, IORING_OFF_CQ_RING);
+    m_SqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_Sqes = mapRing(fd, m_SqesSize, IORING_OFF_SQES);
+    m_Buffers = static_cast<char*>(std::aligned_alloc(direct_alignment, queue_depth * block_size));
+    if (m_SqRing == nullptr || m_CqRing == nullptr || m_Sqes == nullptr || m_Buffers == nullptr) {
+        close(fd); // The destructor unmaps the rest
+        return;
+    }
+
+    auto* sq = static_cast<char*>(m_SqRing);
+    auto* cq = static_cast<char*>(m_CqRing);
+    m_SqHead = reinterpret_cast<unsigned int*>(sq + params.sq_off.head);
+    m_SqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    m_SqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    m_SqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    m_CqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    m_CqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    m_CqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    m_Cqes = cq + params.cq_off.cqes;
+
+    // Fixed buffers skip pinning the pages on every read. Registering counts against RLIMIT_MEMLOCK on older kernels,
+    // plain reads still work without it
+    std::array<iovec, queue_depth> buffers{};
+    for (unsigned int i = 0; i < queue_depth; ++i) buffers[i] = iovec{m_Buffers + i * block_size, block_size};
+    b_Registered = uringRegister(fd, IORING_REGISTER_BUFFERS, buffers.data(), queue_depth) == 0;
+    m_RingFd = fd;
+}
+
+UringReader::~UringReader() {
+    if (b_Abandoned) return; // Reads may still be in flight into m_Buffers
+    if (m_FileFd >= 0) close(m_FileFd);
+    if (m_RingFd >= 0) close(m_RingFd); // Also unregisters the buffers
+    if (m_Sqes != nullptr) munmap(m_Sqes, m_SqesSize);
+    if (m_CqRing != nullptr && m_CqRing != m_SqRing) munmap(m_CqRing, m_CqRingSize);
+    if (m_SqRing != nullptr) munmap(m_SqRing, m_SqRingSize);
+    std::free(m_Buffers);
+}
+
+bool UringReader::available() {
+    static const bool works = [] {
+        io_uring_params params{};
+        const int fd = uringSetup(1, &params);
+        if (fd < 0) return false;
+        close(fd);
+        return true;
+    }();
+    return works;
+}
+
+bool UringReader::read(const std::string &file_path, const uint64_t offset, const uint64_t length, const std::function<void(const char*, size_t)> &consume, std::error_code &error) {
+    error.clear();
+    if (!ok()) {
+        error = std::make_error_code(std::errc::function_not_supported);
+        return false;
+    }
+    if (length == 0) return true;
+
+    // Some file systems refuse O_DIRECT, they are read through the page cache instead
+    b_Direct = offset % direct_alignment == 0;
+    m_FileFd = b_Direct ? open(file_path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT) : -1;
+    if (m_FileFd < 0) {
+        b_Direct = false;
+        m_FileFd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (m_FileFd < 0) {
+        error = std::error_code(errno, std::generic_category());
+        return false;
+    }
+    m_Offset = offset;
+    m_Length = length;
+
+    const uint64_t blocks = (length + block_size - 1) / block_size;
+    const auto blockLength = [&](const uint64_t block) { return static_cast<size_t>(std::min<uint64_t>(block_size, length - block * block_size)); };
+    std::array<size_t, queue_depth> filled{}; // Bytes read into each buffer
+    unsigned int in_flight = 0;
+    int result = 0;
+
+    // Takes every finished read off the completion ring. Short reads (e.g a signal) read the rest of their block
+    const auto reap = [&] {
+        unsigned int head = *m_CqHead;
+        const unsigned int tail = loadAcquire(m_CqTail);
+        for (; head != tail; ++head) {
+            const io_uring_cqe& cqe = static_cast<const io_uring_cqe*>(m_Cqes)[head & *m_CqMask];
+            --in_flight;
+            if (result < 0) continue;
+            const auto block = static_cast<uint64_t>(cqe.user_data);
+            size_t& done = filled[block % queue_depth];
+            if (cqe.res <= 0) {
+                result = cqe.res < 0 ? cqe.res : -EIO; // Zero is the file shrinking
+                continue;
+            }
+            done += static_cast<size_t>(cqe.res);
+            if (done >= blockLength(block)) continue;
+            if (b_Direct && done % direct_alignment != 0) {
+                result = -EIO;
+                continue;
+            }
+            queueRead(block, done);
+            ++in_flight;
+        }
+        storeRelease(m_CqHead, head);
+    };
+
+    // The buffers can't be reused while the kernel still writes to them. If the ring stops answering the reads may still
+    // land, so the ring, its buffers and the file are given up rather than freed. Returns the negative errno of that
+    const auto drain = [&] {
+        while (in_flight > 0) {
+            if (const int entered = submitAndWait(1); entered < 0) {
+                b_Abandoned = true;
+                return entered;
+            }
+            reap();
+        }
+        close(m_FileFd);
+        m_FileFd = -1;
+        return 0;
+    };
+
+    uint64_t next_read = 0;
+    for (; next_read < std::min<uint64_t>(blocks, queue_depth); ++next_read, ++in_flight) queueRead(next_read, 0);
+    for (uint64_t block = 0; block < blocks && result >= 0; ++block) {
+        const size_t slot = block % queue_depth;
+        while (result >= 0 && filled[slot] < blockLength(block)) {
+            if (const int entered = submitAndWait(1); entered < 0) result = entered;
+            else reap();
+        }
+        if (result < 0) break;
+
+        // Later blocks keep reading while this one is hashed. If consume throws, they are waited for before the exception
+        // leaves, the caller may free the reader and its buffers next
+        try {
+            consume(m_Buffers + slot * block_size, blockLength(block));
+        } catch (...) {
+            result = -ECANCELED;
+            drain();
+            throw;
+        }
+        filled[slot] = 0;
+        if (next_read < blocks) {
+            queueRead(next_read++, 0);
+            ++in_flight;
+            submitAndWait(0);
+        }
+    }
+
+    if (const int drained = drain(); drained < 0) {
+        error = std::error_code(-(result < 0 ? result : drained), std::generic_category());
+        return false;
+    }
+    if (result < 0) error = std::error_code(-result, std::generic_category());
+    return result >= 0;
+}
+
+void UringReader::queueRead(const uint64_t block, const size_t done) {
+    const unsigned int tail = *m_SqTail;
+    const unsigned int index = tail & *m_SqMask;
+    io_uring_sqe& sqe = static_cast<io_uring_sqe*>(m_Sqes)[index];
+    std::memset(&sqe, 0, sizeof(sqe));
+
+    const size_t slot = block % queue_depth;
+    size_t read_length = static_cast<size_t>(std::min<uint64_t>(block_size, m_Length - block * block_size)) - done;
+    // O_DIRECT reads whole sectors, the end of the file comes back as a short read
+    if (b_Direct) read_length = std::min((read_length + direct_alignment - 1) / direct_alignment * direct_alignment, block_size - done);
+    sqe.opcode = b_Registered ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe.fd = m_FileFd;
+    sqe.off = m_Offset + block * block_size + done;
+    sqe.addr = reinterpret_cast<uint64_t>(m_Buffers + slot * block_size + done);
+    sqe.len = static_cast<uint32_t>(read_length);
+    sqe.buf_index = static_cast<uint16_t>(slot);
+    sqe.user_data = block;
+
+    m_SqArray[index] = index;
+    storeRelease(m_SqTail, tail + 1);
+    ++m_Queued;
+}
+
+int UringReader::submitAndWait(const unsigned int wait_for) {
+    for (;;) {
+        const int submitted = uringEnter(m_RingFd, m_Queued, wait_for, wait_for > 0 ? IORING_ENTER_GETEVENTS : 0);
+        if (submitted >= 0) {
+            m_Queued -= static_cast<unsigned int>(submitted);
+            return submitted;
+        }
+        if (errno != EINTR) return -errno;
+    }
+}
+
+#else // No io_uring, every reader reports !ok()
+
+UringReader::UringReader() = default;
+UringReader::~UringReader() = default;
+
+bool UringReader::available() {
+    return false;
+}
+
+bool UringReader::read(const std::string&, uint64_t, uint64_t, const std::function<void(const char*, size_t)>&, std::error_code &error) {
+    error = std::make_error_code(std::errc::function_not_supported);
+    return false;
+}
+
+void UringReader::queueRead(uint64_t, size_t) {}
+
+int UringReader::submitAndWait(unsigned int) {
+    return -1;
+}
+
+#endif
@@ -0,0 +1,68 @@
+/**
+ *  @file   TestSupport.h
+ *  @brief  Checks shared by the test programs, failures are counted and reported by finish()
+ ***********************************************/
+
+#ifndef SFVARCHIVING_TEST_SUPPORT_H
+#define SFVARCHIVING_TEST_SUPPORT_H
+
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace test {
+    inline int failures = 0;
+
+    inline void check(const std::string& test, const std::string& result, const std::string& expected) {
+        if (result == expected) return;
+        std::cout << "[Failed] " << test << " : " << result << " expected " << expected << "\n";
+        ++failures;
+    }
+
+    inline void check(const std::string& test, const bool passed) {
+        if (passed) return;
+        std::cout << "[Failed] " << test << "\n";
+        ++failures;
+    }
+
+    inline std::string toHex(const uint8_t* digest, const size_t length) {
+        std::ostringstream stream;
+        for (size_t i = 0; i < length; ++i) stream << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(digest[i]);
+        return stream.str();
+    }
+
+    inline std::string toHex(const uint64_t value, const int digits = 16) {
+        std::ostringstream stream;
+        stream << std::hex << std::setw(digits) << std::setfill('0') << value;
+        return stream.str();
+    }
+
+    /**
+     * \brief Pseudo random bytes, the same on every run
+     */
+    inline std::string randomData(const size_t length, const uint64_t seed = 1) {
+        std::mt19937_64 generator(seed);
+        std::string data(length, '\0');
+        for (char& byte : data) byte = static_cast<char>(generator());
+        return data;
+    }
+
+    /**
+     * \brief Prints the summary
+     * \param passed What passing means, e.g "Every kernel matches the known answers"
+     * \return Exit code of the test program
+     */
+    inline int finish(const std::string& passed) {
+        if (failures != 0) {
+            std::cout << "[Failed] " << failures << " checks" << "\n";
+            return 1;
+        }
+        std::cout << "[Passed] " << passed << "\n";
+        return 0;
+    }
+}
+
+#endif //SFVARCHIVING_TEST_SUPPORT_H
@@ -0,0 +1,245 @@
+/**
+ *  @file   test_crc.cpp
+ *  @brief  Checks every CRC kernel the CPU supports against the bitwise reference, run by ctest
+ ***********************************************/
+
+// Every kernel gets the check value of its CRC, then input at several misalignments with every length from 0 to
+// 4 KiB + 15 bytes, which reaches the tails and the 64, 256 and 1024 byte loops of the folding kernels, and a few MiB
+// for their long loops. Each length is also hashed in two calls, the second continuing from the first CRC.
+// The *_multi functions must match the single buffer kernels, and crc32_combine and its variants must give the
+// CRC of the concatenated data.
+// Each CrcEngine instantiation is checked against its catalogue check value and its own bitwise reference
+
+#include <string>
+#include <vector>
+#include <crc/Crc32.h>
+#include <crc/Crc32c.h>
+#include <crc/Crc64.h>
+#include <crc/CrcEngine.h>
+#include "TestSupport.h"
+
+namespace {
+    using test::check;
+
+    const size_t short_lengths = 4096 + 16;
+    const size_t offsets[] = {0, 1, 7, 13};
+    const size_t long_lengths[] = {(1 << 20) + 5, (3 << 20) + 11};
+
+    const std::string& input() {
+        static const std::string data = test::randomData((4 << 20) + 64);
+        return data;
+    }
+
+    /**
+     * \brief CRC of every prefix of the input at each offset up to short_lengths, then of the long lengths
+     * \param reference Function updating a CRC one byte at a time
+     */
+    template<typename Crc>
+    std::vector<std::vector<Crc>> referenceCrcs(Crc (*reference)(const void*, size_t, Crc)) {
+        std::vector<std::vector<Crc>> references;
+        for (const size_t offset : offsets) {
+            const char* data = input().data() + offset;
+            std::vector<Crc> crcs(short_lengths, 0);
+            for (size_t length = 1; length < short_lengths; ++length) crcs[length] = reference(data + length - 1, 1, crcs[length - 1]);
+            for (const size_t length : long_lengths) crcs.push_back(reference(data, length, 0));
+            references.push_back(std::move(crcs));
+        }
+        return references;
+    }
+
+    template<typename Crc>
+    void testKernel(const std::string& name, Crc (*kernel)(const void*, size_t, Crc), const std::vector<std::vector<Crc>>& references,
+                    const int digits) {
+        for (size_t o = 0; o < references.size(); ++o) {
+            const char* data = input().data() + offsets[o];
+            const std::vector<Crc>& expected = references[o];
+            for (size_t i = 0; i < expected.size(); ++i) {
+                const size_t length = i < short_lengths ? i : long_lengths[i - short_lengths];
+                const size_t split = length / 3;
+                const Crc whole = kernel(data, length, 0);
+                const Crc pieces = kernel(data + split, length - split, kernel(data, split, 0));
+                if (whole == expected[i] && pieces == expected[i]) continue;
+                const std::string test = name + " offset " + std::to_string(offsets[o]) + " length " + std::to_string(length);
+                check(test, test::toHex(whole, digits), test::toHex(expected[i], digits));
+                check(test + " in two calls", test::toHex(pieces, digits), test::toHex(expected[i], digits));
+                break;
+            }
+        }
+    }
+
+    void testCrc32(const std::string& name, uint32_t (*kernel)(const void*, size_t, uint32_t)) {
+        // The bitwise reference is slow, its CRCs are shared by every kernel
+        static const auto references = referenceCrcs<uint32_t>(crc32_bitwise);
+        check(name + " check value", test::toHex(kernel("123456789", 9, 0), 8), "cbf43926");
+        testKernel<uint32_t>(name, kernel, references, 8);
+    }
+
+    void testCrc32c(const std::string& name, uint32_t (*kernel)(const void*, size_t, uint32_t)) {
+        static const auto references = referenceCrcs<uint32_t>(crc32c_bitwise);
+        check(name + " check value", test::toHex(kernel("123456789", 9, 0), 8), "e3069283");
+        testKernel<uint32_t>(name, kernel, references, 8);
+    }
+
+    void testCrc64(const std::string& name, uint64_t (*kernel)(const void*, size_t, uint64_t)) {
+        static const auto references = referenceCrcs<uint64_t>(crc64_bitwise);
+        check(name + " check value", test::toHex(kernel("123456789", 9, 0)), "995dc9bbdf1939fa");
+        testKernel<uint64_t>(name, kernel, references, 16);
+    }
+
+    /**
+     * \brief Check value of the catalogue, then the slicing tables and combine against the bitwise reference
+     */
+    template<typename Engine>
+    void testEngine(const std::string& name, const typename Engine::value_type check_value, const int digits) {
+        using Crc = typename Engine::value_type;
+        check(name + " check value", test::toHex(Engine::update("123456789", 9), digits), test::toHex(check_value, digits));
+        check(name + " bitwise check value", test::toHex(Engine::bitwise("123456789", 9), digits), test::toHex(check_value, digits));
+
+        const char* data = input().data() + 3;
+        for (size_t length = 0; length < 300; ++length) {
+            const Crc expected = Engine::bitwise(data, length);
+            const size_t split = length / 3;
+            const Crc crc_a = Engine::update(data, split);
+            const Crc crc_b = Engine::update(data + split, length - split);
+            if (Engine::update(data, length) == expected && Engine::update(data + split, length - split, crc_a) == expected &&
+                Engine::combine(crc_a, crc_b, length - split) == expected) continue;
+            check(name + " length " + std::to_string(length), false);
+            break;
+        }
+    }
+
+    /**
+     * \brief Hashes buffers of mixed lengths at once, lanes run over the common length of each group and the tails on their own
+     * \param single Reference, the single buffer kernel
+     */
+    template<typename Crc>
+    void testMulti(const std::string& name, void (*multi)(const void* const*, const size_t*, Crc*, size_t),
+                   Crc (*single)(const void*, size_t, Crc), const int digits) {
+        const char* data = input().data();
+        std::vector<const void*> buffers;
+        std::vector<size_t> lengths;
+        std::vector<Crc> previous;
+        for (size_t i = 0; i < 41; ++i) {
+            // Equal lengths keep all four lanes busy, mixed ones leave tails, a few reach the single buffer folding sizes
+            buffers.push_back(data + i * 3);
+            lengths.push_back(i < 8 ? 200 : i % 7 == 0 ? 4000 + i : (i * 157) % 1500);
+            previous.push_back(i % 2 == 0 ? 0 : single(data + 9000, i, 0));
+        }
+        for (const size_t count : {size_t(1), size_t(4), size_t(5), buffers.size()}) {
+            std::vector<Crc> crcs(previous.begin(), previous.begin() + static_cast<std::ptrdiff_t>(count));
+            multi(buffers.data(), lengths.data(), crcs.data(), count);
+            for (size_t i = 0; i < count; ++i) {
+                check(name + " buffer " + std::to_string(i + 1) + " of " + std::to_string(count) + ", length " + std::to_string(lengths[i]),
+                      test::toHex(crcs[i], digits), test::toHex(single(buffers[i], lengths[i], previous[i]), digits));
+            }
+        }
+    }
+
+    void testCombine() {
+        const char* data = input().data();
+        const size_t total = (1 << 20) + 5;
+        const uint32_t expected = crc32_fast(data, total);
+        for (const size_t split : {size_t(0), size_t(1), size_t(15), size_t(16), size_t(17), size_t(255), size_t(1024), total / 2, total - 1, total}) {
+            const uint32_t crc_a = crc32_fast(data, split);
+            const uint32_t crc_b = crc32_fast(data + split, total - split);
+            const std::string test = "crc32_combine split at " + std::to_string(split);
+            check(test, test::toHex(crc32_combine(crc_a, crc_b, total - split), 8), test::toHex(expected, 8));
+            check(test + " with crc32_combine_op", test::toHex(crc32_combine_op(crc_a, crc_b, crc32_combine_gen(total - split)), 8), test::toHex(expected, 8));
+        }
+
+        // Runs of equal lengths share an operator inside crc32_combine_batch
+        std::vector<size_t> lengths(100, 4096);
+        lengths.insert(lengths.end(), {1, 0, 777});
+        lengths.insert(lengths.end(), 50, 8192);
+        lengths.push_back(3);
+        std::vector<uint32_t> crcs;
+        size_t done = 0;
+        for (const size_t length : lengths) {
+            crcs.push_back(crc32_fast(data + done, length));
+            done += length;
+        }
+        check("crc32_combine_batch", test::toHex(crc32_combine_batch(crcs.data(), lengths.data(), crcs.size()), 8), test::toHex(crc32_fast(data, done), 8));
+        check("crc32_combine_batch of one block", test::toHex(crc32_combine_batch(crcs.data(), lengths.data(), 1), 8), test::toHex(crcs[0], 8));
+
+        for (const size_t split : {size_t(0), size_t(7), total / 3, total}) {
+            check("crc32c_combine split at " + std::to_string(split),
+                  test::toHex(crc32c_combine(crc32c_fast(data, split), crc32c_fast(data + split, total - split), total - split), 8),
+                  test::toHex(crc32c_fast(data, total), 8));
+        }
+
+        for (const size_t split : {size_t(0), size_t(7), total / 3, total}) {
+            const uint64_t crc_a = crc64_fast(data, split);
+            const uint64_t crc_b = crc64_fast(data + split, total - split);
+            const std::string expected64 = test::toHex(crc64_fast(data, total));
+            check("crc64_combine split at " + std::to_string(split), test::toHex(crc64_combine(crc_a, crc_b, total - split)), expected64);
+            check("Crc64XzEngine::combine split at " + std::to_string(split), test::toHex(Crc64XzEngine::combine(crc_a, crc_b, total - split)), expected64);
+        }
+
+        // Lengths too long to hash, appending n then m bytes must equal appending n + m bytes
+        const uint32_t crc = 0x12345678;
+        for (const auto& [n, m] : {std::pair<size_t, size_t>(size_t(1) << 40, 3), {(size_t(1) << 33) + 12345, (size_t(1) << 40) + 99}, {0xFFFFFFFF, 0xFFFFFFFF}}) {
+            check("crc32_combine of " + std::to_string(n) + " then " + std::to_string(m) + " bytes",
+                  test::toHex(crc32_combine(crc32_combine(crc, 0, n), 0, m), 8), test::toHex(crc32_combine(crc, 0, n + m), 8));
+        }
+    }
+}
+
+int main() {
+    // Kernels the CPU lacks are skipped, the list shows what was covered
+    std::vector<std::string> tested;
+    const auto run32 = [&](const std::string& name, uint32_t (*kernel)(const void*, size_t, uint32_t)) {
+        testCrc32(name, kernel);
+        tested.push_back(name);
+    };
+    const auto run32c = [&](const std::string& name, uint32_t (*kernel)(const void*, size_t, uint32_t)) {
+        testCrc32c(name, kernel);
+        tested.push_back(name);
+    };
+    const auto run64 = [&](const std::string& name, uint64_t (*kernel)(const void*, size_t, uint64_t)) {
+        testCrc64(name, kernel);
+        tested.push_back(name);
+    };
+    // The default dispatch first, before any kernel is forced
+    run32("crc32_fast", crc32_fast);
+    const std::string default_kernel = crc32_selected_kernel();
+    size_t count;
+    const Crc32Kernel* kernels = crc32_kernels(&count);
+    for (size_t i = 0; i < count; ++i) {
+        const std::string name = kernels[i].name;
+        if (kernels[i].supported != nullptr && !kernels[i].supported()) {
+            check("crc32_select_kernel(\"" + name + "\") on a CPU without it", !crc32_select_kernel(name.c_str()));
+            continue;
+        }
+        run32("crc32_" + name, kernels[i].function);
+        check("crc32_select_kernel(\"" + name + "\")", crc32_select_kernel(name.c_str()) && crc32_selected_kernel() == name);
+        check("crc32_fast with " + name + " selected", test::toHex(crc32_fast("123456789", 9), 8), "cbf43926");
+        testMulti<uint32_t>("crc32_multi with " + name + " selected", crc32_multi, kernels[i].function, 8);
+    }
+    check("crc32_select_kernel of an unknown name", !crc32_select_kernel("none"));
+    crc32_select_kernel(default_kernel.c_str());
+    run32c("crc32c_fast", crc32c_fast);
+    run32c("crc32c_8bytes", crc32c_8bytes);
+#ifdef CRC32C_USE_SSE42
+    if (crc32c_sse42_supported()) run32c("crc32c_sse42", crc32c_sse42);
+#endif
+    run64("crc64_fast", crc64_fast);
+    run64("crc64_8bytes", crc64_8bytes);
+#ifdef CRC64_USE_PCLMUL
+    if (crc64_pclmul_supported()) run64("crc64_pclmul", crc64_pclmul);
+#endif
+    testMulti<uint32_t>("crc32_multi", crc32_multi, crc32_fast, 8);
+    testMulti<uint32_t>("crc32c_multi", crc32c_multi, crc32c_fast, 8);
+    testMulti<uint64_t>("crc64_multi", crc64_multi, crc64_fast, 16);
+    testCombine();
+    testEngine<Crc32Engine>("CrcEngine CRC-32", 0xCBF43926, 8);
+    testEngine<CrcEngine<uint32_t, 32, 0x04C11DB7, true, 0xFFFFFFFF, 1>>("CrcEngine CRC-32 bytewise", 0xCBF43926, 8);
+    testEngine<Crc32cEngine>("CrcEngine CRC-32C", 0xE3069283, 8);
+    testEngine<Crc64XzEngine>("CrcEngine CRC-64/XZ", 0x995DC9BBDF1939FA, 16);
+    testEngine<Crc64NvmeEngine>("CrcEngine CRC-64/NVME", 0xAE8B14860A799888, 16);
+    testEngine<CrcEngine<uint32_t, 32, 0x04C11DB7, false>>("CrcEngine CRC-32/BZIP2", 0xFC891918, 8);
+    testEngine<CrcEngine<uint16_t, 16, 0x1021, false>>("CrcEngine CRC-16/GENIBUS", 0xD64E, 4);
+    testEngine<CrcEngine<uint16_t, 16, 0x8005, true, 0>>("CrcEngine CRC-16/ARC", 0xBB3D, 4);
+    testEngine<CrcEngine<uint8_t, 8, 0x07, false, 0>>("CrcEngine CRC-8/SMBUS", 0xF4, 2);
+    for (const std::string& kernel : tested) std::cout << "[Tested] " << kernel << "\n";
+    return test::finish("Every CRC kernel matches the bitwise reference");
+}
@@ -0,0 +1,274 @@
+/**
+ *  @file   test_hashes.cpp
+ *  @brief  Known-answer tests of the digest hashes, run by ctest
+ ***********************************************/
+
+// Every hash is checked against published values:
+// - MD5, the test suite of RFC 1321
+// - SHA-256, the examples of FIPS 180-4 (NIST CSRC) and the million 'a' message
+// - BLAKE3, the official test_vectors.json, whose input byte i is i % 251
+// - XXH3 and XXH128, the reference xxhash library over the same input
+// BLAKE3 and XXH3 are also fed in pieces, BLAKE3 in two states merged by blake3_combine() too.
+// The *_multi functions are also checked against single stream hashing of the same data, split across calls.
+// The default dispatch is tested first, then every kernel the CPU supports is forced in turn
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <hash/Blake3.h>
+#include <hash/Md5.h>
+#include <hash/Sha256.h>
+#include <hash/Xxh3.h>
+#include "TestSupport.h"
+
+namespace {
+    using test::check;
+
+    struct Vector {
+        std::string input;
+        const char* digest;
+    };
+
+    /**
+     * \brief Input of the long vectors, byte i is i % 251
+     */
+    std::string pattern(const size_t length) {
+        std::string data(length, '\0');
+        for (size_t i = 0; i < length; ++i) data[i] = static_cast<char>(i % 251);
+        return data;
+    }
+
+    /**
+     * \brief Lengths for the *_multi checks, around the 64 byte blocks and long enough to keep every lane busy
+     */
+    std::vector<size_t> multiLengths() {
+        std::vector<size_t> lengths;
+        for (size_t i = 0; i < 40; ++i) lengths.push_back((i * 997) % 4099 + (i % 3 == 0 ? 55 + i % 10 : 0));
+        return lengths;
+    }
+
+    std::string md5(const std::string& data) {
+        Md5State state;
+        md5_init(&state);
+        md5_update(&state, data.data(), data.size());
+        uint8_t digest[16];
+        md5_final(&state, digest);
+        return test::toHex(digest, sizeof(digest));
+    }
+
+    void testMd5(const std::string& kernel) {
+        const std::vector<Vector> vectors = {
+            {"", "d41d8cd98f00b204e9800998ecf8427e"},
+            {"a", "0cc175b9c0f1b6a831c399e269772661"},
+            {"abc", "900150983cd24fb0d6963f7d28e17f72"},
+            {"message digest", "f96b697d7cb7938d525a2f31aaf161d0"},
+            {"abcdefghijklmnopqrstuvwxyz", "c3fcd3d76192e4007dfb496cca67e13b"},
+            {"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789", "d174ab98d277d9f5a5611c2c9f419d9f"},
+            {"12345678901234567890123456789012345678901234567890123456789012345678901234567890", "57edf4a22be3c955ac49da2e2107b67a"},
+        };
+        for (const Vector& vector : vectors) check(kernel + " \"" + vector.input + "\"", md5(vector.input), vector.digest);
+
+        // Every vector at once, then longer streams in two calls so the second starts inside a block
+        std::vector<Md5State> states(vectors.size());
+        std::vector<Md5State*> state_pointers;
+        std::vector<const void*> data;
+        std::vector<size_t> lengths;
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            md5_init(&states[i]);
+            state_pointers.push_back(&states[i]);
+            data.push_back(vectors[i].input.data());
+            lengths.push_back(vectors[i].input.size());
+        }
+        md5_multi(state_pointers.data(), data.data(), lengths.data(), vectors.size());
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            uint8_t digest[16];
+            md5_final(&states[i], digest);
+            check(kernel + " multi \"" + vectors[i].input + "\"", test::toHex(digest, sizeof(digest)), vectors[i].digest);
+        }
+
+        const std::vector<size_t> stream_lengths = multiLengths();
+        const std::string input = pattern(5000);
+        states.assign(stream_lengths.size(), Md5State{});
+        state_pointers.clear();
+        for (auto& state : states) {
+            md5_init(&state);
+            state_pointers.push_back(&state);
+        }
+        for (const bool second : {false, true}) {
+            data.clear();
+            lengths.clear();
+            for (const size_t length : stream_lengths) {
+                const size_t split = length / 3;
+                data.push_back(input.data() + (second ? split : 0));
+                lengths.push_back(second ? length - split : split);
+            }
+            md5_multi(state_pointers.data(), data.data(), lengths.data(), states.size());
+        }
+        for (size_t i = 0; i < states.size(); ++i) {
+            uint8_t digest[16];
+            md5_final(&states[i], digest);
+            check(kernel + " multi length " + std::to_string(stream_lengths[i]), test::toHex(digest, sizeof(digest)), md5(input.substr(0, stream_lengths[i])));
+        }
+    }
+
+    std::string sha256(const std::string& data) {
+        Sha256State state;
+        sha256_init(&state);
+        sha256_update(&state, data.data(), data.size());
+        uint8_t digest[32];
+        sha256_final(&state, digest);
+        return test::toHex(digest, sizeof(digest));
+    }
+
+    void testSha256(const std::string& kernel) {
+        const std::vector<Vector> vectors = {
+            {"", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+            {"abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+            {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+            {"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+             "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"},
+            {std::string(1000000, 'a'), "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+        };
+        for (const Vector& vector : vectors) check(kernel + " \"" + vector.input.substr(0, 16) + "\" (" + std::to_string(vector.input.size()) + " bytes)", sha256(vector.input), vector.digest);
+
+        const std::vector<size_t> stream_lengths = multiLengths();
+        const std::string input = pattern(5000);
+        std::vector<Sha256State> states(stream_lengths.size());
+        std::vector<Sha256State*> state_pointers;
+        for (auto& state : states) {
+            sha256_init(&state);
+            state_pointers.push_back(&state);
+        }
+        for (const bool second : {false, true}) {
+            std::vector<const void*> data;
+            std::vector<size_t> lengths;
+            for (const size_t length : stream_lengths) {
+                const size_t split = length / 3;
+                data.push_back(input.data() + (second ? split : 0));
+                lengths.push_back(second ? length - split : split);
+            }
+            sha256_multi(state_pointers.data(), data.data(), lengths.data(), states.size());
+        }
+        for (size_t i = 0; i < states.size(); ++i) {
+            uint8_t digest[32];
+            sha256_final(&states[i], digest);
+            check(kernel + " multi length " + std::to_string(stream_lengths[i]), test::toHex(digest, sizeof(digest)), sha256(input.substr(0, stream_lengths[i])));
+        }
+    }
+
+    std::string blake3(const Blake3State& state) {
+        uint8_t digest[32];
+        blake3_final(&state, digest);
+        return test::toHex(digest, sizeof(digest));
+    }
+
+    void testBlake3(const std::string& kernel) {
+        const std::vector<std::pair<size_t, const char*>> vectors = {
+            {0, "af1349b9f5f9a1a6a0404dea36dcc9499bcb25c9adc112b7cc9a93cae41f3262"},
+            {1, "2d3adedff11b61f14c886e35afa036736dcd87a74d27b5c1510225d0f592e213"},
+            {1023, "10108970eeda3eb932baac1428c7a2163b0e924c9a9e25b35bba72b28f70bd11"},
+            {1024, "42214739f095a406f3fc83deb889744ac00df831c10daa55189b5d121c855af7"},
+            {1025, "d00278ae47eb27b34faecf67b4fe263f82d5412916c1ffd97c8cb7fb814b8444"},
+            {2048, "e776b6028c7cd22a4d0ba182a8bf62205d2ef576467e838ed6f2529b85fba24a"},
+            {2049, "5f4d72f40d7a5f82b15ca2b2e44b1de3c2ef86c426c95c1af0b6879522563030"},
+            {3072, "b98cb0ff3623be03326b373de6b9095218513e64f1ee2edd2525c7ad1e5cffd2"},
+            {3073, "7124b49501012f81cc7f11ca069ec9226cecb8a2c850cfe644e327d22d3e1cd3"},
+            {4096, "015094013f57a5277b59d8475c0501042c0b642e531b0a1c8f58d2163229e969"},
+            {4097, "9b4052b38f1c5fc8b1f9ff7ac7b27cd242487b3d890d15c96a1c25b8aa0fb995"},
+            {5120, "9cadc15fed8b5d854562b26a9536d9707cadeda9b143978f319ab34230535833"},
+            {5121, "628bd2cb2004694adaab7bbd778a25df25c47b9d4155a55f8fbd79f2fe154cff"},
+            {8192, "aae792484c8efe4f19e2ca7d371d8c467ffb10748d8a5a1ae579948f718a2a63"},
+            {8193, "bab6c09cb8ce8cf459261398d2e7aef35700bf488116ceb94a36d0f5f1b7bc3b"},
+            {16384, "f875d6646de28985646f34ee13be9a576fd515f76b5b0a26bb324735041ddde4"},
+            {31744, "62b6960e1a44bcc1eb1a611a8d6235b6b4b78f32e7abc4fb4c6cdcce94895c47"},
+            {102400, "bc3e3d41a1146b069abffad3c0d44860cf664390afce4d9661f7902e7943e085"},
+        };
+        const std::string input = pattern(102400);
+        for (const auto& [length, digest] : vectors) {
+            const std::string name = kernel + " length " + std::to_string(length);
+            Blake3State state;
+            blake3_init(&state);
+            blake3_update(&state, input.data(), length);
+            check(name, blake3(state), digest);
+
+            blake3_init(&state);
+            for (size_t done = 0; done < length; done += 333) blake3_update(&state, input.data() + done, std::min<size_t>(333, length - done));
+            check(name + " in pieces", blake3(state), digest);
+
+            // The second state starts at a chunk boundary in the first half, its bytes follow the first state's
+            if (length <= Blake3ChunkSize) continue;
+            const size_t split = (length - 1) / Blake3ChunkSize / 2 * Blake3ChunkSize + Blake3ChunkSize;
+            Blake3State next;
+            blake3_init(&state);
+            blake3_update(&state, input.data(), split);
+            blake3_init(&next, split);
+            blake3_update(&next, input.data() + split, length - split);
+            blake3_combine(&state, &next);
+            check(name + " combined at " + std::to_string(split), blake3(state), digest);
+        }
+    }
+
+    std::string xxh3(const Xxh3State& state) {
+        uint64_t low;
+        uint64_t high;
+        xxh3_128_final(&state, &low, &high);
+        return test::toHex(xxh3_64_final(&state)) + " " + test::toHex(high) + test::toHex(low);
+    }
+
+    void testXxh3(const std::string& kernel) {
+        // XXH3 then XXH128 (high and low halves), the lengths cover each short input path and the stripe loop
+        const std::vector<std::pair<size_t, const char*>> vectors = {
+            {0, "2d06800538d394c2 99aa06d3014798d86001c324468d497f"},
+            {1, "c44bdff4074eecdb a6cd5e9392000f6ac44bdff4074eecdb"},
+            {3, "5f4299fc161c9cbb e3b55f57945a17cf5f4299fc161c9cbb"},
+            {240, "375a384d957fe865 65b5be86da5540e7c92b68e16f83bbb6"},
+            {241, "02e8cd95421c6d02 1da1cb61bcb8a2a102e8cd95421c6d02"},
+            {1024, "e5d78bafa45b2aa5 d0ac1f7b93bf57b9e5d78bafa45b2aa5"},
+            {102400, "1428e17f1cac2837 ecd387d36185351b1428e17f1cac2837"},
+        };
+        const std::string input = pattern(102400);
+        Xxh3State state;
+        xxh3_init(&state);
+        xxh3_update(&state, "abc", 3);
+        check(kernel + " \"abc\"", test::toHex(xxh3_64_final(&state)), "78af5f94892f3950");
+        for (const auto& [length, digest] : vectors) {
+            const std::string name = kernel + " length " + std::to_string(length);
+            xxh3_init(&state);
+            xxh3_update(&state, input.data(), length);
+            check(name, xxh3(state), digest);
+
+            xxh3_init(&state);
+            for (size_t done = 0; done < length; done += 100) xxh3_update(&state, input.data() + done, std::min<size_t>(100, length - done));
+            check(name + " in pieces", xxh3(state), digest);
+        }
+    }
+}
+
+int main() {
+    // Kernels the CPU lacks are skipped, the list shows what was covered
+    std::vector<std::string> tested;
+    const auto run = [&](const std::string& kernel, void (*test)(const std::string&)) {
+        test(kernel);
+        tested.push_back(kernel);
+    };
+    // The default dispatch first, before any kernel is forced
+    run("md5 default, " + std::to_string(md5_lanes()) + " lanes", testMd5);
+    run(std::string("sha256 default, ") + sha256_kernel(), testSha256);
+    run("blake3 default, " + std::to_string(blake3_lanes()) + " lanes", testBlake3);
+    run(std::string("xxh3 default, ") + xxh3_kernel(), testXxh3);
+    for (const size_t lanes : {1, 4, 8, 16}) {
+        if (md5_select_lanes(lanes)) run("md5 " + std::to_string(lanes) + " lanes", testMd5);
+    }
+    for (const char* kernel : {"portable", "shani"}) {
+        if (sha256_select_kernel(kernel)) run(std::string("sha256 ") + kernel, testSha256);
+    }
+    for (const size_t lanes : {1, 4, 8, 16}) {
+        if (blake3_select_lanes(lanes)) run("blake3 " + std::to_string(lanes) + " lanes", testBlake3);
+    }
+    for (const char* kernel : {"portable", "sse2", "avx2", "avx512"}) {
+        if (xxh3_select_kernel(kernel)) run(std::string("xxh3 ") + kernel, testXxh3);
+    }
+    for (const std::string& kernel : tested) std::cout << "[Tested] " << kernel << "\n";
+    return test::finish("Every hash matches the known answers");
+}
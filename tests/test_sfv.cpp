@@ -0,0 +1,556 @@
+/**
+ *  @file   test_sfv.cpp
+ *  @brief  Checks the hashing paths of the SFV classes against single pass hashing, run by ctest
+ ***********************************************/
+
+// Hasher is fed the same data in one call, in odd sized pieces and in pieces merged by combine().
+// SFVWriter and SFVReader run over a temporary tree of files around the small file limit, the hashes they write
+// must match Hasher and the reader must pass the tree, then fail the files changed afterwards. Writing several
+// hashes in one pass, with one and with several threads, must give the same hashes, and so must each IO engine
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sfv/CacheResidency.h>
+#include <sfv/DeviceGroups.h>
+#include <sfv/Hasher.h>
+#include <sfv/MappedWindow.h>
+#include <sfv/PreadReader.h>
+#include <sfv/SFVReader.h>
+#include <sfv/SFVWriter.h>
+#include <sfv/UringReader.h>
+#include "TestSupport.h"
+#ifdef __unix__
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    using test::check;
+
+    struct TypeCase {
+        HashType type;
+        const char* name;
+        const char* check_value; // Digest of "123456789"
+    };
+
+    const std::vector<TypeCase> type_cases = {
+        {HashType::CRC, "crc32", "cbf43926"},
+        {HashType::CRC32C, "crc32c", "e3069283"},
+        {HashType::CRC64, "crc64", "995dc9bbdf1939fa"},
+        {HashType::MD5, "md5", "25f9e794323b453885f5181f1b624d0b"},
+        {HashType::SHA256, "sha256", "15e2b0d3c33891ebb0f1ef609ec419420c20e320ce94c65fbc8c3312448eb225"},
+        {HashType::BLAKE3, "blake3", "b7d65b48420d1033cb2595293263b6f72eabee20d55e699d0df1973b3c9deed1"},
+        {HashType::XXH3, "xxh3", "72dcb18b67a17dff"},
+        {HashType::XXH128, "xxh128", "33119477ede5dcd5e9716427681d5860"},
+    };
+
+    std::string digest(const Hasher& hasher) {
+        uint8_t bytes[Hasher::max_digest_size];
+        hasher.digest(bytes);
+        return test::toHex(bytes, hasher.digits() / 2);
+    }
+
+    bool throwsLogicError(const std::function<void()>& call) {
+        try {
+            call();
+        } catch (const std::logic_error&) {
+            return true;
+        }
+        return false;
+    }
+
+    void testHasher(const TypeCase& type_case) {
+        const std::string name = std::string("Hasher ") + type_case.name;
+        Hasher hasher(type_case.type);
+        hasher.update("123456789", 9);
+        check(name + " check value", digest(hasher), type_case.check_value);
+        hasher.reset();
+        check(name + " reset", digest(hasher), digest(Hasher(type_case.type)));
+
+        const std::string data = test::randomData(100000);
+        hasher.update(std::as_bytes(std::span(data)));
+        const std::string expected = digest(hasher);
+
+        Hasher pieces(type_case.type);
+        for (size_t done = 0; done < data.size(); done += 333) pieces.update(data.data() + done, std::min<size_t>(333, data.size() - done));
+        check(name + " in pieces", digest(pieces), expected);
+
+        // finalize() is only for CRCs and combine() only for combinable() types of the same kind
+        const bool crc = type_case.type == HashType::CRC || type_case.type == HashType::CRC32C || type_case.type == HashType::CRC64;
+        if (crc) check(name + " finalize", test::toHex(pieces.finalize(), static_cast<int>(pieces.digits())), expected);
+        else check(name + " finalize rejected", throwsLogicError([&] {(void)pieces.finalize();}));
+        const Hasher other(type_case.type == HashType::CRC ? HashType::CRC64 : HashType::CRC);
+        check(name + " combine with another type rejected", throwsLogicError([&] {pieces.combine(other, 0);}));
+        check(name + " combine" + (Hasher::combinable(type_case.type) ? " allowed" : " rejected"),
+              throwsLogicError([&] {pieces.combine(Hasher(type_case.type), 0);}) != Hasher::combinable(type_case.type));
+
+        if (!Hasher::combinable(type_case.type)) return;
+        for (const size_t split : {size_t(0), size_t(1), size_t(4096), size_t(65537), size_t(99328), data.size()}) {
+            // BLAKE3 only splits between chunks
+            if (type_case.type == HashType::BLAKE3 && split % Hasher::split_alignment != 0 && split != data.size()) continue;
+            Hasher first(type_case.type);
+            Hasher second(type_case.type, split);
+            first.update(data.data(), split);
+            second.update(data.data() + split, data.size() - split);
+            first.combine(second, data.size() - split);
+            check(name + " combined at " + std::to_string(split), digest(first), expected);
+        }
+    }
+
+    void testUpdateMulti(const TypeCase& type_case) {
+        const std::string name = std::string("Hasher::updateMulti ") + type_case.name;
+        const std::string data = test::randomData(8000);
+        std::vector<Hasher> hashers;
+        std::vector<Hasher> expected;
+        std::vector<const void*> buffers;
+        std::vector<size_t> lengths;
+        for (size_t i = 0; i < 37; ++i) {
+            // Lengths around the lane paths, every hasher already holds some data
+            const size_t length = i % 9 == 8 ? 5000 + i : (i * 173) % 1100;
+            hashers.emplace_back(type_case.type);
+            hashers.back().update(data.data() + 7000, i);
+            expected.push_back(hashers.back());
+            expected.back().update(data.data() + i, length);
+            buffers.push_back(data.data() + i);
+            lengths.push_back(length);
+        }
+        for (const size_t count : {size_t(1), size_t(3), hashers.size()}) {
+            std::vector<Hasher> batch(hashers.begin(), hashers.begin() + static_cast<std::ptrdiff_t>(count));
+            Hasher::updateMulti(batch.data(), buffers.data(), lengths.data(), count);
+            for (size_t i = 0; i < count; ++i) {
+                check(name + " " + std::to_string(i + 1) + " of " + std::to_string(count), digest(batch[i]), digest(expected[i]));
+            }
+        }
+    }
+
+    std::string lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) {return static_cast<char>(std::tolower(c));});
+        return text;
+    }
+
+    /**
+     * \brief Temporary folder of test files, deleted when it goes out of scope
+     * \note The SFV stores paths relative to the working directory, so it changes to the folder's parent
+     */
+    class TestTree {
+    public:
+        explicit TestTree(const std::string& name) : m_Root(std::filesystem::temp_directory_path() / ("sfv_test_" + name)) {
+            std::filesystem::remove_all(m_Root);
+            std::filesystem::create_directories(m_Root / name / "nested");
+            m_Previous = std::filesystem::current_path();
+            std::filesystem::current_path(m_Root);
+        }
+        TestTree(const TestTree&) = delete;
+        TestTree& operator=(const TestTree&) = delete;
+        ~TestTree() {
+            std::filesystem::current_path(m_Previous);
+            std::filesystem::remove_all(m_Root);
+        }
+
+        void write(const std::string& path, const std::string& data) {
+            std::ofstream(path, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+            m_Files[path] = data;
+        }
+
+        [[nodiscard]] const std::map<std::string, std::string>& files() const {return m_Files;}
+
+    private:
+        std::filesystem::path m_Root;
+        std::filesystem::path m_Previous;
+        std::map<std::string, std::string> m_Files;
+    };
+
+    /**
+     * \brief Writes files of sizes around the small file limit and the batch size, plus an empty file and a large one
+     */
+    void writeFiles(TestTree& tree, const std::string& folder, const std::string& data) {
+        for (size_t i = 0; i < 40; ++i) {
+            const size_t size = (i * 7919) % 70000 + (i % 4 == 0 ? 65536 - 20 : 0);
+            tree.write(folder + (i % 3 == 0 ? "/nested/file" : "/file") + std::to_string(i), data.substr(i, size));
+        }
+        tree.write(folder + "/empty", "");
+        tree.write(folder + "/large", data.substr(3, (2 << 20) + 5));
+    }
+
+    /**
+     * \brief Reads the hashes written for a type, by file
+     */
+    std::map<std::string, std::string> readManifest(const std::string& folder, const HashType type) {
+        // Checksum lists use the md5sum layout, "<hash>  <file>", xxhsum puts a prefix in front of XXH3 hashes
+        const bool md5sum = SFV::checksumList(type);
+        const size_t prefix = SFV::checksumPrefix(type).size();
+        std::ifstream sfv(folder + SFV::fileExtension(type));
+        std::map<std::string, std::string> written;
+        for (std::string line; std::getline(sfv, line); ) {
+            if (line.empty() || line[0] == ';') continue;
+            const size_t space = line.find(' ');
+            if (md5sum) written[line.substr(space + 2)] = lowercase(line.substr(prefix, space - prefix));
+            else written[line.substr(0, space)] = lowercase(line.substr(space + 1));
+        }
+        return written;
+    }
+
+    void checkManifest(const std::string& name, const TestTree& tree, const std::string& folder, const HashType type) {
+        std::map<std::string, std::string> written = readManifest(folder, type);
+        check(name + " lines", written.size() == tree.files().size());
+        for (const auto& [path, contents] : tree.files()) {
+            Hasher hasher(type);
+            hasher.update(contents.data(), contents.size());
+            check(name + " " + path, written.contains(path) ? written[path] : "missing", digest(hasher));
+        }
+    }
+
+    void testRoundTrip(const TypeCase& type_case) {
+        const std::string name = std::string("SFV round trip ") + type_case.name;
+        const std::string folder = std::string("tree_") + type_case.name;
+        TestTree tree(folder);
+        const std::string data = test::randomData(3 << 20);
+        writeFiles(tree, folder, data);
+
+        SFVWriter writer(folder, true);
+        writer.setHashType(type_case.type);
+        writer.process();
+        checkManifest(name, tree, folder, type_case.type);
+
+        const std::string manifest = folder + SFV::fileExtension(type_case.type);
+        SFVReader reader(manifest, true);
+        reader.process();
+        check(name + " reader passes", reader.passed() == tree.files().size() && reader.failed() == 0);
+
+        tree.write(folder + "/file1", "changed");
+        tree.write(folder + "/large", data.substr(4, (2 << 20) + 5));
+        SFVReader changed(manifest, true);
+        changed.process();
+        check(name + " reader fails changed files", changed.passed() == tree.files().size() - 2 && changed.failed() == 2);
+    }
+
+    void testMappedWindow() {
+        TestTree tree("tree_window");
+        const std::string data = test::randomData((1 << 20) + 5);
+        tree.write("tree_window/data", data);
+        tree.write("tree_window/empty", "");
+        // Window sizes that split the file on and off page boundaries, and one larger than the file
+        for (const uint64_t window_size : {uint64_t(4096), uint64_t(65536 + 7), uint64_t(1) << 30}) {
+            const std::string name = "MappedWindow " + std::to_string(window_size);
+            MappedWindow window("tree_window/data", data.size(), window_size);
+            std::error_code error;
+            std::string walked;
+            bool offsets = true;
+            while (window.next(error)) {
+                offsets = offsets && window.offset() == walked.size() && window.size() == std::min<uint64_t>(window_size, data.size() - walked.size());
+                walked.append(window.data(), window.size());
+            }
+            check(name + " offsets", offsets);
+            check(name + " data", !error && walked == data);
+        }
+        MappedWindow empty("tree_window/empty", 0);
+        std::error_code error;
+        check("MappedWindow empty file", !empty.next(error) && !error);
+    }
+
+    using ReadRange = std::function<bool(uint64_t offset, uint64_t length, const std::function<void(const char*, size_t)>& consume, std::error_code& error)>;
+
+    /**
+     * \brief Reads ranges of a file around the reader's block size and compares them with the file
+     */
+    void testReader(const std::string& name, const size_t block_size, const ReadRange& read) {
+        TestTree tree("tree_reader");
+        const std::string data = test::randomData(5 * block_size + 3);
+        tree.write("tree_reader/data", data);
+        // Aligned ranges keep O_DIRECT, the others and the short end of the file are read buffered or in sectors
+        const std::vector<std::pair<uint64_t, uint64_t>> ranges = {
+            {0, data.size()}, {block_size, 3 * block_size}, {1, 1}, {4093, 2 * block_size + 11}, {data.size() - 7, 7},
+        };
+        for (const auto& [offset, length] : ranges) {
+            std::string result;
+            std::error_code error;
+            const bool done = read(offset, length, [&](const char* block, const size_t size) {result.append(block, size);}, error);
+            check(name + " " + std::to_string(offset) + "+" + std::to_string(length), done && !error && result == data.substr(offset, length));
+        }
+    }
+
+    void testUringReader() {
+        if (!UringReader::available()) {
+            std::cout << "[Skipped] UringReader, io_uring isn't available\n";
+            return;
+        }
+        testReader("UringReader", UringReader::block_size, [](const uint64_t offset, const uint64_t length, const auto& consume, std::error_code& error) {
+            UringReader reader;
+            return reader.ok() && reader.read("tree_reader/data", offset, length, consume, error);
+        });
+
+        // A consumer that throws leaves the reader usable, its reads are done before the exception leaves
+        TestTree tree("tree_uring_throw");
+        const std::string data = test::randomData(UringReader::block_size * UringReader::queue_depth * 2 + 5);
+        tree.write("tree_uring_throw/data", data);
+        UringReader reader;
+        std::error_code error;
+        bool threw = false;
+        try {
+            (void)reader.read("tree_uring_throw/data", 0, data.size(), [](const char*, size_t) {throw std::runtime_error("consume");}, error);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        std::string read;
+        const bool done = reader.read("tree_uring_throw/data", 0, data.size(), [&](const char* block, const size_t size) {read.append(block, size);}, error);
+        check("UringReader after a throwing consumer", threw && reader.ok() && done && read == data);
+    }
+
+    void testPreadReader() {
+        if (!PreadReader::available()) {
+            std::cout << "[Skipped] PreadReader, POSIX file IO isn't available\n";
+            return;
+        }
+        testReader("PreadReader", PreadReader::block_size, [](const uint64_t offset, const uint64_t length, const auto& consume, std::error_code& error) {
+            return PreadReader::read("tree_reader/data", offset, length, consume, error);
+        });
+
+        // A consumer that throws while the reader thread waits for a free buffer
+        TestTree tree("tree_pread_throw");
+        const std::string data = test::randomData(PreadReader::block_size * (PreadReader::buffer_count + 2) + 5);
+        tree.write("tree_pread_throw/data", data);
+        std::error_code error;
+        bool threw = false;
+        try {
+            (void)PreadReader::read("tree_pread_throw/data", 0, data.size(), [](const char*, size_t) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50)); // Lets the reader thread fill every buffer
+                throw std::runtime_error("consume");
+            }, error);
+        } catch (const std::runtime_error&) {
+            threw = true;
+        }
+        check("PreadReader stops after a throwing consumer", threw);
+    }
+
+    /**
+     * \brief Writes a tree with an IO engine and checks the hashes, large files are read by the engine
+     */
+    void testIoEngine(const SFV::IoEngine engine, const std::string& engine_name, const MapPolicy& policy = MapPolicy()) {
+        const std::string folder = "tree_" + engine_name;
+        TestTree tree(folder);
+        writeFiles(tree, folder, test::randomData(3 << 20));
+        tree.write(folder + "/larger", test::randomData((9 << 20) + 1234, 2));
+        for (const HashType type : {HashType::CRC, HashType::BLAKE3, HashType::MD5}) {
+            for (const unsigned int threads : {1u, 4u}) {
+                SFVWriter writer(folder, true);
+                writer.setHashType(type);
+                writer.setThreadCount(threads);
+                writer.setIoEngine(engine);
+                writer.setMapPolicy(policy);
+                writer.process();
+                checkManifest(engine_name + " " + std::to_string(threads) + " threads " + SFV::hashName(type), tree, folder, type);
+            }
+        }
+    }
+
+    void testMapPolicy() {
+        MapPolicy policy;
+        check("MapPolicy default", policy.names(), "sequential");
+        check("MapPolicy names", MapPolicy::fromNames("populate,dontneed,willneed,hugepage,sequential", policy));
+        check("MapPolicy every hint", policy.sequential && policy.will_need && policy.populate && policy.huge_pages && policy.drop_behind);
+        MapPolicy read_back;
+        check("MapPolicy round trip", MapPolicy::fromNames(policy.names(), read_back) && read_back.names() == policy.names());
+        check("MapPolicy none", MapPolicy::fromNames("none", read_back) && !read_back.sequential && !read_back.drop_behind);
+        check("MapPolicy unknown hint", !MapPolicy::fromNames("sequential,fast", read_back));
+
+        // Hints only change how the pages are read, never the hashes
+        testIoEngine(SFV::IoEngine::Mmap, "mmap");
+        testIoEngine(SFV::IoEngine::Mmap, "mmap_hints", policy);
+    }
+
+    /**
+     * \brief Gets which pages of a file are in the page cache
+     * \return One entry per page, empty if it can't be checked
+     */
+    std::vector<bool> residentPages(const std::string& path) {
+        std::vector<bool> resident;
+#ifdef __unix__
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return resident;
+        const size_t size = std::filesystem::file_size(path);
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        void* map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+            if (mincore(map, size, pages.data()) == 0) {
+                for (const unsigned char page : pages) resident.push_back((page & 1) != 0);
+            }
+            munmap(map, size);
+        }
+        close(fd);
+#endif
+        return resident;
+    }
+
+    /**
+     * \brief Evicts a file from the page cache, then reads part of it back in
+     * \return If the file left the cache, which tmpfs and some other file systems don't allow
+     */
+    bool evictAndWarm(const std::string& path, const uint64_t warm_offset, const uint64_t warm_length) {
+#ifdef __unix__
+        const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        const std::vector<bool> evicted = residentPages(path);
+        std::vector<char> buffer(warm_length);
+        const bool warmed = pread(fd, buffer.data(), warm_length, static_cast<off_t>(warm_offset)) == static_cast<ssize_t>(warm_length);
+        close(fd);
+        return warmed && !evicted.empty() && std::find(evicted.begin(), evicted.end(), true) == evicted.end();
+#else
+        return false;
+#endif
+    }
+
+    void testScrub(const SFV::IoEngine engine, const std::string& engine_name) {
+        const std::string folder = "tree_scrub_" + engine_name;
+        TestTree tree(folder);
+        const std::string path = folder + "/data";
+        tree.write(path, test::randomData(12 << 20));
+        // The cached part starts and ends on folio boundaries, so the kernel can drop around it
+        const uint64_t warm_offset = CacheResidency::drop_alignment * 2;
+        const uint64_t warm_length = CacheResidency::drop_alignment;
+        if (!evictAndWarm(path, warm_offset, warm_length)) {
+            std::cout << "[Skipped] Scrub " << engine_name << ", the page cache can't be dropped here\n";
+            return;
+        }
+
+        SFVWriter writer(folder, true);
+        writer.setIoEngine(engine);
+        writer.setScrub(true);
+        writer.process();
+        checkManifest("Scrub " + engine_name, tree, folder, HashType::CRC);
+
+        const std::vector<bool> resident = residentPages(path);
+        const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t kept = 0;
+        size_t left = 0;
+        for (size_t page = 0; page < resident.size(); ++page) {
+            const bool warm = page * page_size >= warm_offset && page * page_size < warm_offset + warm_length;
+            if (warm) kept += resident[page];
+            else left += resident[page];
+        }
+        check("Scrub " + engine_name + " keeps cached pages", kept == warm_length / page_size);
+        check("Scrub " + engine_name + " drops pages it read, " + std::to_string(left) + " left", left == 0);
+    }
+
+    void testHashChunked() {
+        const std::string data = test::randomData((5 << 20) + 333, 4);
+        for (const HashType type : {HashType::CRC, HashType::CRC32C, HashType::BLAKE3}) {
+            Hasher single(type);
+            single.update(data.data(), data.size());
+            // Even shares, shares held up by min_block_size, more threads than chunks, and empty data
+            for (const auto& [threads, min_block_size] : std::vector<std::pair<unsigned int, unsigned long long int>>{{1, 0}, {3, 0}, {4, 1 << 20}, {64, 4096}}) {
+                const std::string name = "hashChunked " + SFV::hashName(type) + " " + std::to_string(threads) + " threads " + std::to_string(min_block_size);
+                const Hasher chunked = SFV::hashChunked(type, data.size(), threads, min_block_size, [&](const unsigned long long int offset, const unsigned long long int length) {
+                    Hasher piece(type, offset);
+                    piece.update(data.data() + offset, length);
+                    return piece;
+                });
+                check(name, digest(chunked), digest(single));
+            }
+            const Hasher empty = SFV::hashChunked(type, 0, 4, 0, [&](const unsigned long long int offset, unsigned long long int) {return Hasher(type, offset);});
+            check("hashChunked " + SFV::hashName(type) + " empty", digest(empty), digest(Hasher(type)));
+        }
+    }
+
+    void testChunked() {
+        const std::string folder = "tree_chunked";
+        TestTree tree(folder);
+        // Past two chunks of SFV::max_chunk_size (64 MiB), and not a multiple of any chunk alignment
+        const std::string block = test::randomData((1 << 20) + 7, 3);
+        std::string data;
+        while (data.size() < (size_t(131) << 20)) data += block;
+        tree.write(folder + "/huge", data);
+        for (const HashType type : {HashType::CRC, HashType::CRC64, HashType::BLAKE3}) {
+            for (const unsigned int threads : {2u, 3u, 16u}) {
+                SFVWriter writer(folder, true);
+                writer.setHashType(type);
+                writer.setThreadCount(threads);
+                writer.process();
+                checkManifest("Chunked " + std::to_string(threads) + " threads " + SFV::hashName(type), tree, folder, type);
+            }
+        }
+    }
+
+    void testDeviceGroups() {
+        TestTree tree("tree_devices");
+        tree.write("tree_devices/first", "first");
+        tree.write("tree_devices/second", "second");
+        std::vector<std::string> paths = {"tree_devices/first", "tree_devices/missing", "tree_devices/second"};
+        // /dev/shm is a tmpfs on most Linux hosts, so a file there is on another device
+        const std::filesystem::path other = "/dev/shm/sfv_test_device";
+        const bool other_device = std::filesystem::is_directory(other.parent_path()) && std::ofstream(other).good();
+        if (other_device) paths.insert(paths.begin() + 1, other.string());
+
+        const std::vector<DeviceGroups::Group> groups = DeviceGroups::split(paths);
+        std::vector<size_t> grouped;
+        bool ordered = true;
+        for (const auto& group : groups) {
+            ordered = ordered && std::is_sorted(group.files.begin(), group.files.end());
+            grouped.insert(grouped.end(), group.files.begin(), group.files.end());
+        }
+        std::sort(grouped.begin(), grouped.end());
+        check("DeviceGroups every file once", grouped.size() == paths.size() && std::adjacent_find(grouped.begin(), grouped.end()) == grouped.end());
+        check("DeviceGroups keeps file order", ordered);
+        check("DeviceGroups missing file with the first", !groups.empty() && groups[0].files.front() == 0
+                                                          && std::ranges::find(groups[0].files, paths.size() - 2) != groups[0].files.end());
+        if (other_device) {
+            check("DeviceGroups splits devices", groups.size() == 2 && groups[1].files == std::vector<size_t>{1});
+            std::filesystem::remove(other);
+        }
+    }
+
+    void testMultiDigest() {
+        const std::string folder = "tree_multi";
+        TestTree tree(folder);
+        writeFiles(tree, folder, test::randomData(3 << 20));
+        const std::vector<HashType> types = {HashType::CRC, HashType::MD5, HashType::SHA256, HashType::BLAKE3, HashType::XXH128};
+        // Streaming readers hand their blocks to the same stage threads as the mapped windows
+        const std::vector<std::pair<SFV::IoEngine, std::string>> engines = {{SFV::IoEngine::Mmap, "mmap"}, {SFV::IoEngine::Uring, "uring"}, {SFV::IoEngine::Pread, "pread"}};
+        for (const auto& [engine, engine_name] : engines) {
+            for (const unsigned int threads : {1u, 4u}) {
+                SFVWriter writer(folder, true);
+                writer.setHashTypes(types);
+                writer.setThreadCount(threads);
+                writer.setIoEngine(engine);
+                writer.process();
+                for (const HashType type : types) {
+                    checkManifest("Multi-digest " + engine_name + " " + std::to_string(threads) + " threads " + SFV::hashName(type), tree, folder, type);
+                }
+            }
+        }
+    }
+}
+
+int main() {
+    for (const TypeCase& type_case : type_cases) {
+        testHasher(type_case);
+        testUpdateMulti(type_case);
+        testRoundTrip(type_case);
+    }
+    testMappedWindow();
+    testMultiDigest();
+    testUringReader();
+    testIoEngine(SFV::IoEngine::Uring, "uring");
+    testPreadReader();
+    testIoEngine(SFV::IoEngine::Pread, "pread");
+    testMapPolicy();
+    testScrub(SFV::IoEngine::Mmap, "mmap");
+    testScrub(SFV::IoEngine::Pread, "pread");
+    testHashChunked();
+    testChunked();
+    testDeviceGroups();
+    return test::finish("Every hashing path matches single pass hashing");
+}